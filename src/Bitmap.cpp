@@ -0,0 +1,97 @@
+#include "Bitmap.hpp"
+#include "Utils.hpp"
+
+#include <algorithm>
+
+namespace gitcpp {
+
+    namespace {
+
+        constexpr std::uint64_t ONES = ~std::uint64_t(0);
+        constexpr std::uint64_t MAX_RUN = 0xffffffffu;      // 32 bits
+        constexpr std::uint64_t MAX_LITERALS = 0x7fffffffu; // 31 bits
+
+        std::uint64_t marker(bool runBit, std::uint64_t run, std::uint64_t literals) {
+            return (runBit ? 1 : 0) | run << 1 | literals << 33;
+        }
+
+        bool markerRunBit(std::uint64_t marker) { return marker & 1; }
+        std::uint64_t markerRun(std::uint64_t marker) { return marker >> 1 & MAX_RUN; }
+        std::uint64_t markerLiterals(std::uint64_t marker) { return marker >> 33; }
+
+    } // namespace
+
+    void Bitmap::set(std::size_t pos) {
+        if (pos / 64 >= words_.size()) words_.resize(pos / 64 + 1, 0);
+        words_[pos / 64] |= std::uint64_t(1) << (pos % 64);
+    }
+
+    Bitmap& Bitmap::operator|=(const Bitmap& other) {
+        if (other.words_.size() > words_.size()) words_.resize(other.words_.size(), 0);
+        for (std::size_t w = 0; w < other.words_.size(); ++w) words_[w] |= other.words_[w];
+        return *this;
+    }
+
+    std::size_t Bitmap::count() const {
+        std::size_t bits = 0;
+        for (std::uint64_t word : words_) bits += static_cast<std::size_t>(__builtin_popcountll(word));
+        return bits;
+    }
+
+    std::vector<std::uint64_t> Bitmap::encode() const {
+        std::vector<std::uint64_t> out;
+        std::size_t w = 0;
+        while (w < words_.size()) {
+            // A run of clean words, then the dirty words up to the next run
+            bool runBit = words_[w] == ONES;
+            std::uint64_t run = 0;
+            while (w < words_.size() && run < MAX_RUN && words_[w] == (runBit ? ONES : 0)) {
+                ++run;
+                ++w;
+            }
+            std::size_t start = w;
+            while (w < words_.size() && w - start < MAX_LITERALS && words_[w] != 0 && words_[w] != ONES) ++w;
+            out.push_back(marker(runBit, run, w - start));
+            out.insert(out.end(), words_.begin() + static_cast<std::ptrdiff_t>(start),
+                       words_.begin() + static_cast<std::ptrdiff_t>(w));
+        }
+        return out;
+    }
+
+    void Bitmap::orEncoded(const std::vector<std::uint64_t>& ewah) {
+        std::size_t w = 0;
+        for (std::size_t i = 0; i < ewah.size();) {
+            std::uint64_t run = markerRun(ewah[i]);
+            std::uint64_t literals = markerLiterals(ewah[i]);
+            if (literals > ewah.size() - i - 1) throw error("Corrupt bitmap");
+            if (markerRunBit(ewah[i])) {
+                if (words_.size() < w + run) words_.resize(w + run, 0);
+                std::fill(words_.begin() + static_cast<std::ptrdiff_t>(w),
+                          words_.begin() + static_cast<std::ptrdiff_t>(w + run), ONES);
+            }
+            w += run;
+            if (literals > 0 && words_.size() < w + literals) words_.resize(w + literals, 0);
+            for (std::uint64_t k = 0; k < literals; ++k) words_[w++] |= ewah[i + 1 + k];
+            i += 1 + literals;
+        }
+    }
+
+    bool Bitmap::testEncoded(const std::vector<std::uint64_t>& ewah, std::size_t pos) {
+        std::size_t target = pos / 64;
+        std::size_t w = 0;
+        for (std::size_t i = 0; i < ewah.size();) {
+            std::uint64_t run = markerRun(ewah[i]);
+            std::uint64_t literals = markerLiterals(ewah[i]);
+            if (target < w + run) return markerRunBit(ewah[i]);
+            w += run;
+            if (target < w + literals) {
+                if (i + 1 + (target - w) >= ewah.size()) throw error("Corrupt bitmap");
+                return ewah[i + 1 + (target - w)] >> (pos % 64) & 1;
+            }
+            w += literals;
+            i += 1 + literals;
+        }
+        return false;
+    }
+
+} // namespace gitcpp
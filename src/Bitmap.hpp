@@ -0,0 +1,52 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace gitcpp {
+
+    /// Plain bitmap over positions [0, 64 * words), growing as bits are
+    /// set, with EWAH (enhanced word-aligned hybrid) compression for
+    /// storage.
+    ///
+    /// An EWAH stream is a sequence of 64-bit words. Each marker word holds
+    /// a run bit (bit 0), the number of words in a run of all-zero or
+    /// all-one words (bits 1-32) and the number of literal words that
+    /// follow the marker (bits 33-63). Reachability bitmaps are mostly long
+    /// runs, so they compress to a small fraction of their plain size.
+    class Bitmap {
+    public:
+        void set(std::size_t pos);
+        bool test(std::size_t pos) const {
+            return pos / 64 < words_.size() && (words_[pos / 64] >> (pos % 64) & 1);
+        }
+
+        Bitmap& operator|=(const Bitmap& other);
+
+        /// Number of set bits.
+        std::size_t count() const;
+
+        /// Call `f(pos)` for every set bit, in ascending order.
+        template <class F>
+        void forEach(F&& f) const {
+            for (std::size_t w = 0; w < words_.size(); ++w) {
+                for (std::uint64_t word = words_[w]; word; word &= word - 1) {
+                    f(w * 64 + static_cast<std::size_t>(__builtin_ctzll(word)));
+                }
+            }
+        }
+
+        std::vector<std::uint64_t> encode() const;
+
+        /// Or an EWAH stream into this bitmap (throws on a malformed
+        /// stream).
+        void orEncoded(const std::vector<std::uint64_t>& ewah);
+
+        /// Whether bit `pos` is set in an EWAH stream, without decoding it.
+        static bool testEncoded(const std::vector<std::uint64_t>& ewah, std::size_t pos);
+
+    private:
+        std::vector<std::uint64_t> words_;
+    };
+
+} // namespace gitcpp
@@ -0,0 +1,344 @@
+#include "BitmapIndex.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace fs = std::filesystem;
+
+namespace gitcpp {
+
+    namespace {
+
+        constexpr unsigned char BITMAP_MAGIC[4] = {'G', 'C', 'B', 'M'};
+        constexpr std::uint32_t BITMAP_VERSION = 1;
+        constexpr std::size_t HEADER = 20;
+        constexpr std::size_t RAW_ID = 20;
+        constexpr std::size_t FANOUT = 256 * 4;
+
+        // Entry: commit position, offset and length of its EWAH words
+        constexpr std::size_t ENTRY = 4 + 8 + 4;
+
+        std::vector<std::string> parentsOf(const CommitGraph& graph, const ObjectStore& store, const std::string& id) {
+            std::vector<std::string> parents;
+            std::uint32_t pos = graph.find(id);
+            if (pos != CommitGraph::NOT_FOUND) {
+                for (std::uint32_t parent : graph.parents(pos)) parents.push_back(graph.id(parent));
+            } else if (auto commit = store.commit(id)) {
+                parents = commit->parents;
+            }
+            return parents;
+        }
+
+        // Fan-out and id-sorted positions of `ids`, whose positions start at `base`
+        void putLookup(std::vector<unsigned char>& out, const std::vector<std::string>& ids, std::uint32_t base) {
+            std::vector<std::uint32_t> order(ids.size());
+            std::iota(order.begin(), order.end(), 0);
+            std::sort(order.begin(), order.end(), [&](std::uint32_t a, std::uint32_t b) { return ids[a] < ids[b]; });
+            std::uint32_t fanout[256] = {};
+            for (const std::string& id : ids) {
+                unsigned char raw[RAW_ID];
+                fromHex(id, raw);
+                ++fanout[raw[0]];
+            }
+            std::uint32_t running = 0;
+            for (std::uint32_t bucket : fanout) {
+                running += bucket;
+                putBE32(out, running);
+            }
+            for (std::uint32_t i : order) putBE32(out, base + i);
+        }
+
+    } // namespace
+
+    BitmapIndex::BitmapIndex(const Repository& repo) {
+        if (!fs::is_regular_file(repo.BITMAP)) return;
+        map_ = MappedFile(repo.BITMAP);
+        const unsigned char* data = map_.data();
+        std::size_t size = map_.size();
+        if (size < HEADER + 2 * FANOUT + RAW_ID || std::memcmp(data, BITMAP_MAGIC, 4) != 0 ||
+            getBE32(data + 4) != BITMAP_VERSION || !trailerMatches(data, size)) {
+            throw error("Corrupt bitmap: " + repo.BITMAP.string());
+        }
+        std::uint32_t commits = getBE32(data + 8);
+        std::uint32_t objects = getBE32(data + 12);
+        std::uint32_t bitmaps = getBE32(data + 16);
+        std::size_t total = std::size_t(commits) + objects;
+        std::size_t fixed = HEADER + total * RAW_ID + 2 * FANOUT + total * 4 + std::size_t(bitmaps) * ENTRY + RAW_ID;
+        if (fixed > size || (size - fixed) % 8 != 0) {
+            throw error("Corrupt bitmap: " + repo.BITMAP.string());
+        }
+        ids_ = data + HEADER;
+        commitLookup_ = ids_ + total * RAW_ID;
+        objectLookup_ = commitLookup_ + FANOUT + std::size_t(commits) * 4;
+        entries_ = objectLookup_ + FANOUT + std::size_t(objects) * 4;
+        words_ = entries_ + std::size_t(bitmaps) * ENTRY;
+        wordCount_ = (size - fixed) / 8;
+        if (getBE32(commitLookup_ + 255 * 4) != commits || getBE32(objectLookup_ + 255 * 4) != objects) {
+            throw error("Corrupt bitmap: " + repo.BITMAP.string());
+        }
+        commitCount_ = commits;
+        objectCount_ = objects;
+        bitmapCount_ = bitmaps;
+    }
+
+    std::uint32_t BitmapIndex::find(const unsigned char* lookup, std::uint32_t base, std::uint32_t count,
+                                    const std::string& id) const {
+        if (count == 0 || !isObjectId(id)) return NOT_FOUND;
+        unsigned char raw[RAW_ID];
+        fromHex(id, raw);
+        const unsigned char* positions = lookup + FANOUT;
+        std::uint32_t lo = raw[0] == 0 ? 0 : getBE32(lookup + (raw[0] - 1) * 4);
+        std::uint32_t hi = getBE32(lookup + raw[0] * 4);
+        while (lo < hi) {
+            std::uint32_t mid = lo + (hi - lo) / 2;
+            std::uint32_t pos = getBE32(positions + std::size_t(mid) * 4);
+            if (pos - base >= count) throw error("Corrupt bitmap lookup");
+            int cmp = std::memcmp(ids_ + std::size_t(pos) * RAW_ID, raw, RAW_ID);
+            if (cmp == 0) return pos;
+            if (cmp < 0) lo = mid + 1; else hi = mid;
+        }
+        return NOT_FOUND;
+    }
+
+    std::uint32_t BitmapIndex::findCommit(const std::string& id) const {
+        return find(commitLookup_, 0, commitCount_, id);
+    }
+
+    std::uint32_t BitmapIndex::findObject(const std::string& id) const {
+        return find(objectLookup_, commitCount_, objectCount_, id);
+    }
+
+    std::string BitmapIndex::id(std::uint32_t pos) const {
+        if (std::size_t(pos) >= std::size_t(commitCount_) + objectCount_) throw error("Bitmap position out of range");
+        return toHex(ids_ + std::size_t(pos) * RAW_ID, RAW_ID);
+    }
+
+    bool BitmapIndex::encoded(std::uint32_t pos, std::vector<std::uint64_t>& words) const {
+        std::uint32_t lo = 0, hi = bitmapCount_;
+        while (lo < hi) {
+            std::uint32_t mid = lo + (hi - lo) / 2;
+            const unsigned char* entry = entries_ + std::size_t(mid) * ENTRY;
+            std::uint32_t entryPos = getBE32(entry);
+            if (entryPos < pos) {
+                lo = mid + 1;
+            } else if (entryPos > pos) {
+                hi = mid;
+            } else {
+                std::uint64_t offset = getBE64(entry + 4);
+                std::uint32_t count = getBE32(entry + 12);
+                if (offset > wordCount_ || count > wordCount_ - offset) throw error("Corrupt bitmap entry");
+                words.resize(count);
+                for (std::uint32_t i = 0; i < count; ++i) words[i] = getBE64(words_ + (offset + i) * 8);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool BitmapIndex::orBitmap(std::uint32_t pos, Bitmap& into) const {
+        std::vector<std::uint64_t> words;
+        if (!encoded(pos, words)) return false;
+        into.orEncoded(words);
+        return true;
+    }
+
+    bool BitmapIndex::isAncestor(const CommitGraph& graph, const ObjectStore& store,
+                                 const std::string& ancestor, const std::string& descendant) const {
+        if (ancestor == descendant) return true;
+        std::uint32_t target = findCommit(ancestor);
+        std::unordered_set<std::string> seen = {descendant};
+        std::vector<std::string> stack = {descendant};
+        std::vector<std::uint64_t> words;
+        while (!stack.empty()) {
+            std::string commit = std::move(stack.back());
+            stack.pop_back();
+            if (commit == ancestor) return true;
+            std::uint32_t pos = findCommit(commit);
+            if (pos != NOT_FOUND) {
+                // Indexed history only reaches indexed commits
+                if (target == NOT_FOUND) continue;
+                if (encoded(pos, words)) {
+                    if (Bitmap::testEncoded(words, target)) return true;
+                    continue;
+                }
+            }
+            for (std::string& parent : parentsOf(graph, store, commit)) {
+                if (seen.insert(parent).second) stack.push_back(std::move(parent));
+            }
+        }
+        return false;
+    }
+
+    std::size_t BitmapIndex::write(const Repository& repo, const ObjectStore& store) {
+        CommitGraph graph(repo);
+        std::vector<std::string> heads;
+        for (const std::string& branch : plainFilenamesIn(repo.HEADS)) {
+            heads.push_back(readContentsAsString(repo.HEADS / branch));
+        }
+
+        // Commits reachable from the heads, parents before children,
+        // without recursion (histories are deep)
+        struct Frame {
+            std::string id;
+            std::vector<std::string> parents;
+            std::size_t next = 0;
+        };
+        std::unordered_map<std::string, std::uint32_t> commitPos;
+        std::vector<std::string> commits;
+        std::vector<std::string> roots;                 // tree of each commit
+        std::vector<std::vector<std::uint32_t>> parents;
+        std::vector<Frame> stack;
+        auto push = [&](const std::string& id) {
+            std::uint32_t pos = graph.find(id);
+            if (pos == CommitGraph::NOT_FOUND && !store.commit(id)) return;
+            stack.push_back(Frame{id, parentsOf(graph, store, id), 0});
+        };
+        for (const std::string& head : heads) {
+            if (!commitPos.count(head)) push(head);
+            while (!stack.empty()) {
+                Frame& frame = stack.back();
+                if (frame.next < frame.parents.size()) {
+                    std::string parent = frame.parents[frame.next++];
+                    if (!commitPos.count(parent)) push(parent);
+                    continue;
+                }
+                std::uint32_t pos = static_cast<std::uint32_t>(commits.size());
+                std::vector<std::uint32_t> known;
+                for (const std::string& parent : frame.parents) {
+                    auto it = commitPos.find(parent);
+                    if (it != commitPos.end()) known.push_back(it->second);
+                }
+                std::uint32_t graphPos = graph.find(frame.id);
+                roots.push_back(graphPos != CommitGraph::NOT_FOUND ? graph.tree(graphPos) : store.commit(frame.id)->tree);
+                parents.push_back(std::move(known));
+                commitPos.emplace(frame.id, pos);
+                commits.push_back(std::move(frame.id));
+                stack.pop_back();
+            }
+        }
+        auto commitCount = static_cast<std::uint32_t>(commits.size());
+
+        // Bitmaps go on branch heads and on every commit SPACING commits
+        // from the selected commits below it, along its longest path
+        std::vector<char> selected(commits.size(), 0);
+        std::vector<std::uint32_t> distance(commits.size(), 0);
+        for (const std::string& head : heads) {
+            auto it = commitPos.find(head);
+            if (it != commitPos.end()) selected[it->second] = 1;
+        }
+        for (std::uint32_t c = 0; c < commitCount; ++c) {
+            std::uint32_t d = 1;
+            for (std::uint32_t p : parents[c]) d = std::max(d, distance[p] + 1);
+            if (d >= SPACING) selected[c] = 1;
+            distance[c] = selected[c] ? 0 : d;
+        }
+
+        // Trees and blobs, in the order the commits first reach them
+        std::unordered_map<std::string, std::uint32_t> objectPos;
+        std::vector<std::string> objects;
+        std::vector<std::vector<std::uint32_t>> children;
+        std::vector<std::uint32_t> rootPos(commits.size(), NOT_FOUND);
+        auto assign = [&](const std::string& id) {
+            auto [it, added] = objectPos.emplace(id, commitCount + static_cast<std::uint32_t>(objects.size()));
+            if (added) {
+                objects.push_back(id);
+                children.emplace_back();
+            }
+            return std::make_pair(it->second, added);
+        };
+        std::vector<std::uint32_t> treeStack;
+        for (std::uint32_t c = 0; c < commitCount; ++c) {
+            if (roots[c].empty()) continue;
+            auto [root, added] = assign(roots[c]);
+            rootPos[c] = root;
+            if (added) treeStack.push_back(root);
+            while (!treeStack.empty()) {
+                std::uint32_t k = treeStack.back() - commitCount;
+                treeStack.pop_back();
+                auto tree = store.tree(objects[k]);
+                if (!tree) continue;
+                for (const TreeEntry& entry : tree->entries) {
+                    auto [child, fresh] = assign(entry.id);
+                    children[k].push_back(child);
+                    if (fresh && entry.isTree) treeStack.push_back(child);
+                }
+            }
+        }
+
+        // Each selected commit's bitmap is the bitmaps of the nearest
+        // selected commits below it plus what the commits in between add
+        std::vector<std::vector<std::uint64_t>> encodedBitmaps(commits.size());
+        std::size_t bitmaps = 0;
+        for (std::uint32_t c = 0; c < commitCount; ++c) {
+            if (!selected[c]) continue;
+            Bitmap bits;
+            bits.set(c);
+            std::vector<std::uint32_t> walk = {c};
+            std::vector<std::uint32_t> own;
+            while (!walk.empty()) {
+                std::uint32_t x = walk.back();
+                walk.pop_back();
+                own.push_back(x);
+                for (std::uint32_t p : parents[x]) {
+                    if (bits.test(p)) continue;
+                    if (selected[p]) {
+                        bits.orEncoded(encodedBitmaps[p]);
+                        continue;
+                    }
+                    bits.set(p);
+                    walk.push_back(p);
+                }
+            }
+            for (std::uint32_t x : own) {
+                if (rootPos[x] == NOT_FOUND || bits.test(rootPos[x])) continue;
+                bits.set(rootPos[x]);
+                treeStack.push_back(rootPos[x]);
+                while (!treeStack.empty()) {
+                    std::uint32_t k = treeStack.back() - commitCount;
+                    treeStack.pop_back();
+                    for (std::uint32_t child : children[k]) {
+                        if (bits.test(child)) continue;
+                        bits.set(child);
+                        treeStack.push_back(child);
+                    }
+                }
+            }
+            encodedBitmaps[c] = bits.encode();
+            ++bitmaps;
+        }
+
+        std::vector<unsigned char> out(BITMAP_MAGIC, BITMAP_MAGIC + 4);
+        putBE32(out, BITMAP_VERSION);
+        putBE32(out, commitCount);
+        putBE32(out, static_cast<std::uint32_t>(objects.size()));
+        putBE32(out, static_cast<std::uint32_t>(bitmaps));
+        for (const auto* ids : {&commits, &objects}) {
+            for (const std::string& id : *ids) {
+                unsigned char raw[RAW_ID];
+                fromHex(id, raw);
+                out.insert(out.end(), raw, raw + RAW_ID);
+            }
+        }
+        putLookup(out, commits, 0);
+        putLookup(out, objects, commitCount);
+        std::uint64_t offset = 0;
+        for (std::uint32_t c = 0; c < commitCount; ++c) {
+            if (!selected[c]) continue;
+            putBE32(out, c);
+            putBE64(out, offset);
+            putBE32(out, static_cast<std::uint32_t>(encodedBitmaps[c].size()));
+            offset += encodedBitmaps[c].size();
+        }
+        for (std::uint32_t c = 0; c < commitCount; ++c) {
+            for (std::uint64_t word : encodedBitmaps[c]) putBE64(out, word);
+        }
+        putTrailer(out);
+
+        writeDurable(repo.BITMAP, false, out);
+        return bitmaps;
+    }
+
+} // namespace gitcpp
@@ -0,0 +1,86 @@
+#pragma once
+#include "Bitmap.hpp"
+#include "CommitGraph.hpp"
+#include "ObjectStore.hpp"
+#include "Repository.hpp"
+#include "Utils.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace gitcpp {
+
+    /// Reachability bitmaps (`bitmap`): for selected commits, the set of
+    /// every commit, tree and blob reachable from them, as an EWAH
+    /// compressed bitmap over a fixed object order.
+    ///
+    /// The order lists the commits reachable from the branch heads when
+    /// the file was written, parents before children, followed by their
+    /// trees and blobs in the order the commits first reach them, so a
+    /// commit's bitmap is mostly one long run. Commits are selected so that
+    /// every path from an indexed commit meets a selected one within
+    /// SPACING commits; branch heads are always selected.
+    ///
+    /// The file is "GCBM", version, commit, object and bitmap counts, the
+    /// raw ids in bit order, a 256-entry fan-out and id-sorted positions
+    /// for the commits and again for the objects, one (position, word
+    /// offset, word count) entry per bitmap sorted by position, the EWAH
+    /// words and a SHA-1 trailer.
+    ///
+    /// Commits made after the file was written are not indexed; queries
+    /// walk them until they reach indexed history.
+    class BitmapIndex {
+    public:
+        static constexpr std::uint32_t NOT_FOUND = 0xffffffff;
+        static constexpr std::uint32_t SPACING = 64;
+
+        /// Load the bitmaps of `repo`; empty if it has none. Throws if the
+        /// file does not match its trailer.
+        explicit BitmapIndex(const Repository& repo);
+
+        bool empty() const { return bitmapCount_ == 0; }
+        std::uint32_t commitCount() const { return commitCount_; }
+        std::uint32_t objectCount() const { return objectCount_; }
+        std::uint32_t bitmapCount() const { return bitmapCount_; }
+
+        /// Bit position of a commit, or of a tree or blob; NOT_FOUND if the
+        /// index does not cover it.
+        std::uint32_t findCommit(const std::string& id) const;
+        std::uint32_t findObject(const std::string& id) const;
+
+        /// Id at a bit position; positions below commitCount() are commits.
+        std::string id(std::uint32_t pos) const;
+
+        /// Or the bitmap of the commit at `pos` into `into`; false if the
+        /// commit has no bitmap.
+        bool orBitmap(std::uint32_t pos, Bitmap& into) const;
+
+        /// Whether `ancestor` is reachable from `descendant` (or equal to
+        /// it). History is walked from `descendant` only until it meets
+        /// commits with a bitmap, whose bitmap answers for everything below.
+        bool isAncestor(const CommitGraph& graph, const ObjectStore& store,
+                        const std::string& ancestor, const std::string& descendant) const;
+
+        /// Rewrite the bitmaps for everything reachable from the branch
+        /// heads. Returns the number of bitmaps written.
+        static std::size_t write(const Repository& repo, const ObjectStore& store);
+
+    private:
+        std::uint32_t find(const unsigned char* lookup, std::uint32_t base, std::uint32_t count,
+                           const std::string& id) const;
+        bool encoded(std::uint32_t pos, std::vector<std::uint64_t>& words) const;
+
+        MappedFile map_;
+        std::uint32_t commitCount_ = 0;
+        std::uint32_t objectCount_ = 0;
+        std::uint32_t bitmapCount_ = 0;
+        const unsigned char* ids_ = nullptr;
+        const unsigned char* commitLookup_ = nullptr;   // fan-out, then positions
+        const unsigned char* objectLookup_ = nullptr;
+        const unsigned char* entries_ = nullptr;
+        const unsigned char* words_ = nullptr;
+        std::uint64_t wordCount_ = 0;
+    };
+
+} // namespace gitcpp
@@ -0,0 +1,50 @@
+#include "Checkout.hpp"
+#include "ThreadPool.hpp"
+
+#include <filesystem>
+#include <set>
+
+namespace fs = std::filesystem;
+
+namespace gitcpp {
+
+    std::vector<std::string> checkoutFiles(const Repository& repo, const ObjectStore& store,
+                                           const std::vector<std::pair<std::string, std::string>>& files) {
+        // Plan the directories first so workers never race to create them.
+        // The set holds every ancestor and orders parents before children.
+        std::set<fs::path> dirs;
+        for (const auto& file : files) {
+            for (fs::path dir = fs::path(file.first).parent_path(); !dir.empty(); dir = dir.parent_path()) {
+                if (!dirs.insert(dir).second) break;
+            }
+        }
+        for (const fs::path& dir : dirs) {
+            fs::create_directory(dir);
+        }
+
+        std::vector<char> missing(files.size(), 0);
+        ThreadPool::shared(repo).parallelFor(files.size(), [&](std::size_t i) {
+            const auto& [path, id] = files[i];
+            if (!store.contains(ObjectKind::Blob, id)) {
+                missing[i] = 1;
+                return;
+            }
+            store.checkout(id, path);
+        });
+
+        std::vector<std::string> skipped;
+        for (std::size_t i = 0; i < files.size(); ++i) {
+            if (missing[i]) skipped.push_back(files[i].first);
+        }
+        return skipped;
+    }
+
+    void removeWorkingFile(const std::string& path) {
+        fs::remove(path);
+        std::error_code ec;
+        for (fs::path dir = fs::path(path).parent_path(); !dir.empty(); dir = dir.parent_path()) {
+            if (!fs::is_empty(dir, ec) || ec || !fs::remove(dir, ec)) break;
+        }
+    }
+
+} // namespace gitcpp
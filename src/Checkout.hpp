@@ -0,0 +1,24 @@
+#pragma once
+#include "ObjectStore.hpp"
+#include "Repository.hpp"
+
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace gitcpp {
+
+    /// Write `files` (path, blob id) into the working tree. Every parent
+    /// directory is created up front, in path order, and the files are then
+    /// written concurrently on the shared worker pool with
+    /// ObjectStore::checkout(). Existing files are replaced.
+    ///
+    /// Returns the paths whose blobs are missing from the store, in the
+    /// order of `files`; those paths are left untouched.
+    std::vector<std::string> checkoutFiles(const Repository& repo, const ObjectStore& store,
+                                           const std::vector<std::pair<std::string, std::string>>& files);
+
+    /// Remove a tracked file and any directories it leaves empty.
+    void removeWorkingFile(const std::string& path);
+
+} // namespace gitcpp
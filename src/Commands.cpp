@@ -1,14 +1,31 @@
+    #include "BitmapIndex.hpp"
+    #include "Checkout.hpp"
     #include "Commands.hpp"
     #include "Repository.hpp"
     #include "Utils.hpp"
     #include "Commit.hpp"
+    #include "CommitGraph.hpp"
+    #include "Diff.hpp"
+    #include "ObjectStore.hpp"
+    #include "Index.hpp"
+    #include "MergeBase.hpp"
+    #include "MessageIndex.hpp"
+    #include "Reachability.hpp"
+    #include "Rename.hpp"
+    #include "ThreadPool.hpp"
+    #include "Tree.hpp"
     #include <filesystem>
+    #include <functional>
     #include <iostream>
     #include <sstream>
     #include <string>
     #include <vector>
     #include <algorithm>
+    #include <array>
+    #include <atomic>
+    #include <chrono>
     #include <map>
+    #include <optional>
     #include <set>
     #include <queue>
     
@@ -22,91 +39,284 @@ namespace gitcpp::commands {
         std::exit(0);
     }
     
-    // Forward declarations for merge helper functions
-    std::string findMergeBase(const std::string& commit1, const std::string& commit2);
-    std::set<std::string> getCommitAncestors(const std::string& commitHash);
-    void performFastForwardMerge(const std::string& targetCommit, const std::string& branchName);
-    void updateWorkingDirectory(const std::string& commitHash);
-    void performThreeWayMerge(const std::string& currentCommit, const std::string& otherCommit, 
-                             const std::string& baseCommit, const std::string& branchName);
-    std::map<std::string, std::string> getFilesFromCommit(const std::string& commitHash);
-    std::string mergeFile(const std::string& filePath, const std::string& currentHash, 
-                         const std::string& otherHash, const std::string& baseHash, bool& hasConflicts);
-    void createConflictFile(const std::string& filePath, const std::string& currentHash, const std::string& otherHash);
-    void createMergeCommit(const std::map<std::string, std::string>& files, 
+    // Forward declarations for merge helper functions. They share the
+    // caller's repository and object store, so objects decoded by one
+    // helper are cached for the next.
+    std::vector<std::string> findMergeBases(const Repository& repo, const ObjectStore& store,
+                                            const std::string& commit1, const std::string& commit2);
+    std::set<std::string> getCommitAncestors(const Repository& repo, const ObjectStore& store, const std::string& commitHash);
+    void performFastForwardMerge(const Repository& repo, const ObjectStore& store,
+                                 const std::string& targetCommit, const std::string& branchName);
+    void updateWorkingDirectory(const Repository& repo, const ObjectStore& store, const std::string& commitHash);
+    void performThreeWayMerge(const Repository& repo, const ObjectStore& store,
+                             const std::string& currentCommit, const std::string& otherCommit, 
+                             const std::vector<std::string>& baseCommits, const std::string& branchName);
+    std::map<std::string, std::string> getFilesFromCommit(const ObjectStore& store, const std::string& commitHash);
+    std::string mergeFile(const ObjectStore& store, const std::string& filePath, const std::string& currentHash, 
+                         const std::string& otherHash, const std::string& baseHash,
+                         std::map<std::string, std::string>& conflictFiles);
+    std::string conflictFileContents(const ObjectStore& store, const std::string& filePath,
+                                     const std::string& currentHash, const std::string& otherHash);
+    void createMergeCommit(const Repository& repo, const ObjectStore& store,
+                          const std::map<std::string, std::string>& files, const std::set<std::string>& written,
                           const std::string& parent1, const std::string& parent2, const std::string& branchName);
     
+    // Commit id the current branch points at, or "" before the first commit
+    static std::string headCommit(const Repository& repo) {
+        std::string current_branch = gitcpp::readContentsAsString(repo.CURRENT_BRANCH);
+        fs::path head_path = repo.HEADS / current_branch;
+        if (!fs::exists(head_path)) {
+            return "";
+        }
+        return gitcpp::readContentsAsString(head_path);
+    }
+    
+    // Tree id recorded in a commit object, or "" if it cannot be found
+    static std::string commitTree(const ObjectStore& store, const std::string& commitHash) {
+        auto commit = store.commit(commitHash);
+        return commit ? commit->tree : "";
+    }
+    
+    // Parents of a commit, from the commit-graph when it knows the commit and
+    // from the commit object otherwise
+    static std::vector<std::string> commitParents(const CommitGraph& graph, const ObjectStore& store,
+                                                  const std::string& commitHash) {
+        std::vector<std::string> parents;
+        std::uint32_t pos = graph.find(commitHash);
+        if (pos != CommitGraph::NOT_FOUND) {
+            for (std::uint32_t parent : graph.parents(pos)) {
+                parents.push_back(graph.id(parent));
+            }
+            return parents;
+        }
+        if (auto commit = store.commit(commitHash)) {
+            parents = commit->parents;
+        }
+        return parents;
+    }
+    
+    // One log entry: the id, author line and indented message
+    static std::string formatCommit(const std::string& commitHash, const CommitView& commit) {
+        std::string out = "===\ncommit " + commitHash + "\n";
+        if (!commit.author.empty()) {
+            out += "author ";
+            out += commit.author;
+            out += "\n";
+        }
+        out += "\n";
+        std::string_view rest = commit.message;
+        while (!rest.empty()) {
+            std::size_t eol = rest.find('\n');
+            out += "    ";
+            out += rest.substr(0, eol);
+            out += "\n";
+            rest.remove_prefix(eol == std::string_view::npos ? rest.size() : eol + 1);
+        }
+        out += "\n";
+        return out;
+    }
+    
+    static void printCommit(const std::string& commitHash, const CommitView& commit) {
+        std::cout << formatCommit(commitHash, commit) << std::flush;
+    }
+    
+    // Open the staging index. Repositories that still have the old text
+    // file_map (staged changes only) are converted once: HEAD's files plus
+    // whatever was staged.
+    static Index openIndex(const Repository& repo, const ObjectStore& store) {
+        Index index(repo.INDEX);
+        if (fs::exists(repo.INDEX) || !fs::exists(repo.FILE_MAP)) {
+            return index;
+        }
+    
+        std::map<std::string, std::string> files = readTree(store, commitTree(store, headCommit(repo)));
+        std::istringstream stream(gitcpp::readContentsAsString(repo.FILE_MAP));
+        std::string line;
+        while (std::getline(stream, line)) {
+            size_t colon_pos = line.find(':');
+            if (colon_pos != std::string::npos) {
+                files[line.substr(0, colon_pos)] = line.substr(colon_pos + 1);
+            }
+        }
+        for (const auto& [path, hash] : files) {
+            IndexEntry entry;
+            entry.path = path;
+            entry.id = hash;
+            index.set(entry);
+        }
+        index.write();
+        fs::remove(repo.FILE_MAP);
+        return index;
+    }
+    
+    // Make the index track exactly `files`. With `recordStat`, the working
+    // tree copies were just written from these blobs, so their stat data is
+    // recorded as well.
+    static void setIndexFromTree(const Repository& repo, const ObjectStore& store,
+                                 const std::map<std::string, std::string>& files, bool recordStat) {
+        Index index = openIndex(repo, store);
+        index.clear();
+        for (const auto& [path, hash] : files) {
+            IndexEntry entry;
+            entry.path = path;
+            entry.id = hash;
+            if (recordStat) {
+                statEntry(path, entry);
+            }
+            index.set(entry);
+        }
+        index.write();
+    }
+    
+    // Make the index track `files` after a checkout that only wrote the
+    // paths in `written`. Other entries that already match keep their stat
+    // data; entries that did not match (staged changes) get none, so status
+    // rehashes them.
+    static void updateIndexAfterCheckout(const Repository& repo, const ObjectStore& store,
+                                         const std::map<std::string, std::string>& files,
+                                         const std::set<std::string>& written) {
+        Index index = openIndex(repo, store);
+        for (const IndexEntry& entry : index.entries()) {
+            if (!files.count(entry.path)) index.erase(entry.path);
+        }
+        for (const auto& [path, hash] : files) {
+            bool wasWritten = written.count(path) > 0;
+            auto existing = index.get(path);
+            if (existing && existing->id == hash && !wasWritten) continue;
+            IndexEntry entry;
+            entry.path = path;
+            entry.id = hash;
+            if (wasWritten) {
+                statEntry(path, entry);
+            }
+            index.set(entry);
+        }
+        index.write();
+    }
+    
+    // Read and hash `paths` on the shared worker pool, storing each as a
+    // blob. Entries (with stat data) come back in the order of `paths`.
+    static std::vector<IndexEntry> hashFiles(const Repository& repo, const ObjectStore& store,
+                                             const std::vector<std::string>& paths) {
+        std::vector<IndexEntry> entries(paths.size());
+        ThreadPool::shared(repo).parallelFor(paths.size(), [&](std::size_t i) {
+            IndexEntry& entry = entries[i];
+            entry.path = paths[i];
+            statEntry(paths[i], entry);
+            entry.id = store.writeFile(ObjectKind::Blob, paths[i]);
+        });
+        return entries;
+    }
+    
+    // How a tracked file in the working tree compares to its index entry
+    enum class FileState { Clean, Refreshed, Modified, Deleted };
+    
+    // Check `tracked` for modifications and deletions on the worker pool.
+    // Files whose stat data still matches the index are clean without being
+    // read; unchanged files with new stat data are Refreshed, and `current`
+    // holds their fresh entries. Results are kept per entry, in order.
+    static std::vector<FileState> workingTreeStates(const Repository& repo, const Index& index,
+                                                    const std::vector<IndexEntry>& tracked,
+                                                    std::vector<IndexEntry>& current) {
+        std::vector<FileState> states(tracked.size(), FileState::Clean);
+        current = tracked;
+        ThreadPool::shared(repo).parallelFor(tracked.size(), [&](std::size_t i) {
+            const IndexEntry& entry = tracked[i];
+            if (!statEntry(entry.path, current[i])) {
+                states[i] = FileState::Deleted;
+                return;
+            }
+            if (statMatches(entry, current[i]) && !index.isRacy(entry)) {
+                return;
+            }
+            if (gitcpp::sha1File(entry.path) != entry.id) {
+                states[i] = FileState::Modified;
+            } else if (!statMatches(entry, current[i])) {
+                states[i] = FileState::Refreshed;
+            }
+        });
+        return states;
+    }
+    
     void init() {
         // The constructor handles all the logic for init.
         Repository repo;
     }
     
     void add(const std::string& fileToAdd) {
-        Repository repo(false);
-        fs::path file_path(fileToAdd);
-        if (!fs::exists(file_path)) {
-            // Following git's behavior of printing to stderr and exiting with 1
-            std::cerr << "Error: File does not exist: " << fileToAdd << std::endl;
-            std::exit(1);
-        }
-    
-        // Read file and create blob
-        auto content_bytes = gitcpp::readContents(file_path);
-        std::string blob_hash = gitcpp::sha1(content_bytes);
-    
-        // Read the staging index
-        std::map<std::string, std::string> staged_files;
-        std::string index_content = gitcpp::readContentsAsString(repo.FILE_MAP);
-        if (index_content != "{}" && !index_content.empty()) {
-            std::istringstream stream(index_content);
-            std::string line;
-            while (std::getline(stream, line)) {
-                size_t colon_pos = line.find(':');
-                if (colon_pos != std::string::npos) {
-                    staged_files[line.substr(0, colon_pos)] = line.substr(colon_pos + 1);
-                }
+        add(std::vector<std::string>{fileToAdd});
+    }
+    
+    void add(const std::vector<std::string>& pathsToAdd) {
+        Repository repo = Repository::open();
+        ObjectStore store(repo);
+        for (const std::string& path : pathsToAdd) {
+            if (!fs::exists(path)) {
+                // Following git's behavior of printing to stderr and exiting with 1
+                std::cerr << "Error: File does not exist: " << path << std::endl;
+                std::exit(1);
             }
         }
     
-        // Add or update the file in the staging index
-        staged_files[fileToAdd] = blob_hash;
-    
-        // Write the blob file to the blob store
-        gitcpp::writeContents(repo.BLOBS / blob_hash, content_bytes);
+        // Files named directly are always added. Directories (including
+        // ".") are walked like status does: hidden entries and ignored
+        // paths are skipped.
+        std::vector<std::string> patterns = loadGitignorePatterns();
+        std::set<std::string> files;
+        for (const std::string& path : pathsToAdd) {
+            if (!fs::is_directory(path)) {
+                files.insert(fs::path(path).lexically_normal().generic_string());
+                continue;
+            }
+            for (auto it = fs::recursive_directory_iterator(path); it != fs::recursive_directory_iterator(); ++it) {
+                std::string name = it->path().filename().string();
+                std::string relative_path = it->path().lexically_normal().generic_string();
+                if ((!name.empty() && name[0] == '.') || isIgnored(patterns, relative_path)) {
+                    if (it->is_directory()) it.disable_recursion_pending();
+                    continue;
+                }
+                if (it->is_regular_file()) {
+                    files.insert(relative_path);
+                }
+            }
+        }
     
-        // Write the staging index back to disk
-        std::ostringstream new_index_content;
-        for (const auto& [file, hash] : staged_files) {
-            new_index_content << file << ":" << hash << "\n";
+        // Hash every file into the blob store in parallel, then update the
+        // staging index with a single write
+        Index index = openIndex(repo, store);
+        for (const IndexEntry& entry : hashFiles(repo, store, std::vector<std::string>(files.begin(), files.end()))) {
+            index.set(entry);
         }
-        gitcpp::writeContents(repo.FILE_MAP, new_index_content.str());
+        index.write();
     }
     
     void commit(const std::string& message) {
-        Repository repo(false);
-        std::string staged_content = gitcpp::readContentsAsString(repo.FILE_MAP);
+        Repository repo = Repository::open();
+        ObjectStore store(repo);
+        Index index = openIndex(repo, store);
         std::string removed_content = gitcpp::readContentsAsString(repo.REMOVE_SET);
-        
-        // Check if there are any changes to commit (staged files or removed files)
-        bool has_staged_files = !(staged_content.empty() || staged_content == "{}");
+    
+        // Get parent commit hash
+        std::string current_branch = gitcpp::readContentsAsString(repo.CURRENT_BRANCH);
+        fs::path head_path = repo.HEADS / current_branch;
+        std::string parent_hash = headCommit(repo);
+        std::string parent_tree = commitTree(store, parent_hash);
+        
+        // Save the tree. Unchanged directories hash to their existing
+        // subtrees, which are reused rather than rewritten.
+        std::map<std::string, std::string> files = index.toMap();
+        std::string treeHash = writeTree(store, files);
+        
+        // Check if there are any changes to commit (staged files or removed
+        // files). A parent with an old flat tree is compared file by file.
+        bool has_staged_files = parent_hash.empty() ? !files.empty()
+                                                    : treeHash != parent_tree && readTree(store, parent_tree) != files;
         bool has_removed_files = !(removed_content.empty() || removed_content == "[]");
         
         if (!has_staged_files && !has_removed_files) {
             gitcpp::message("Nothing to commit, working tree clean");
             return;
         }
-    
-        // Create tree hash from the staging index and save the tree
-        std::string treeHash = gitcpp::sha1(staged_content);
-        gitcpp::writeContents(repo.BLOBS / treeHash, staged_content);
-    
-        // Get parent commit hash
-        std::string current_branch = gitcpp::readContentsAsString(repo.CURRENT_BRANCH);
-        fs::path head_path = repo.HEADS / current_branch;
-        std::string parent_hash;
-        if (fs::exists(head_path)) {
-            parent_hash = gitcpp::readContentsAsString(head_path);
-        }
         
         std::vector<std::string> parent_hashes;
         if (!parent_hash.empty()) {
@@ -115,97 +325,65 @@ namespace gitcpp::commands {
     
         // Create and save commit object
         Commit new_commit(treeHash, parent_hashes, message);
-        gitcpp::writeContents(repo.COMMITS / new_commit.getCommitHash(), new_commit.getCommitContents());
+        store.write(ObjectKind::Commit, new_commit.getCommitHash(), new_commit.getCommitContents());
     
         // Update branch head
-        gitcpp::writeContents(head_path, new_commit.getCommitHash());
+        gitcpp::writeDurable(head_path, false, new_commit.getCommitHash());
+        CommitGraph::update(repo, store, {new_commit.getCommitHash()});
+        MessageIndex::update(repo, store, {new_commit.getCommitHash()});
     
-        // Clear staging area and remove set
-        gitcpp::writeContents(repo.FILE_MAP, "{}");
-        gitcpp::writeContents(repo.REMOVE_SET, "[]");
+        // Clear remove set; the index keeps tracking every committed file
+        gitcpp::writeDurable(repo.REMOVE_SET, false, "[]");
     }
     
     void remove(const std::string& fileToRemove) {
-        Repository repo(false);
-        // Read the staging index
-        std::map<std::string, std::string> staged_files;
-        std::string index_content = gitcpp::readContentsAsString(repo.FILE_MAP);
-        if (index_content != "{}" && !index_content.empty()) {
-            std::istringstream stream(index_content);
-            std::string line;
-            while (std::getline(stream, line)) {
-                size_t colon_pos = line.find(':');
-                if (colon_pos != std::string::npos) {
-                    staged_files[line.substr(0, colon_pos)] = line.substr(colon_pos + 1);
-                }
-            }
-        }
-    
-        bool removed = false;
-        if (staged_files.count(fileToRemove)) {
-            staged_files.erase(fileToRemove);
-            removed = true;
-        }
-    
-        // If the file was staged, write the updated index back to disk
-        if (removed) {
-            std::ostringstream new_index_content;
-            for (const auto& [file, hash] : staged_files) {
-                new_index_content << file << ":" << hash << "\n";
+        Repository repo = Repository::open();
+        ObjectStore store(repo);
+        Index index = openIndex(repo, store);
+        std::map<std::string, std::string> head_files = readTree(store, commitTree(store, headCommit(repo)));
+    
+        auto entry = index.get(fileToRemove);
+        auto head_it = head_files.find(fileToRemove);
+    
+        // If the file is staged, unstage it back to its committed version
+        if (entry && (head_it == head_files.end() || head_it->second != entry->id)) {
+            if (head_it != head_files.end()) {
+                IndexEntry committed;
+                committed.path = fileToRemove;
+                committed.id = head_it->second;
+                index.set(committed);
+            } else {
+                index.erase(fileToRemove);
             }
-            gitcpp::writeContents(repo.FILE_MAP, new_index_content.str());
+            index.write();
             return;
         }
     
-        // Check if the file is in the current commit
-        std::string current_branch = gitcpp::readContentsAsString(repo.CURRENT_BRANCH);
-        fs::path head_path = repo.HEADS / current_branch;
-        if (fs::exists(head_path)) {
-            std::string head_commit_hash = gitcpp::readContentsAsString(head_path);
-            fs::path commit_path = repo.COMMITS / head_commit_hash;
-            if (fs::exists(commit_path)) {
-                std::string commit_contents = gitcpp::readContentsAsString(commit_path);
-                size_t nul_pos = commit_contents.find('\0');
-                if (nul_pos != std::string::npos) {
-                    std::string body = commit_contents.substr(nul_pos + 1);
-                    std::istringstream body_stream(body);
-                    std::string line;
-                    std::string tree_hash;
-                    while (std::getline(body_stream, line)) {
-                        if (line.rfind("tree ", 0) == 0) {
-                            tree_hash = line.substr(5);
-                            break;
-                        }
-                    }
-    
-                    if (!tree_hash.empty()) {
-                        std::string tree_contents = gitcpp::readContentsAsString(repo.BLOBS / tree_hash);
-                        if (tree_contents.find(fileToRemove) != std::string::npos) {
-                            // Stage for removal
-                            std::string removed_content = gitcpp::readContentsAsString(repo.REMOVE_SET);
-                            if (removed_content == "[]") {
-                                removed_content = "";
-                            }
-                            if (removed_content.find(fileToRemove) == std::string::npos) {
-                                removed_content += fileToRemove + "\n";
-                                gitcpp::writeContents(repo.REMOVE_SET, removed_content);
-                            }
-                            // Delete the file
-                            fs::remove(fileToRemove);
-                            removed = true;
-                        }
-                    }
-                }
+        // If the file is in the current commit, stage it for removal
+        if (head_it != head_files.end()) {
+            std::string removed_content = gitcpp::readContentsAsString(repo.REMOVE_SET);
+            if (removed_content == "[]") {
+                removed_content = "";
             }
-        }
+            if (removed_content.find(fileToRemove) == std::string::npos) {
+                removed_content += fileToRemove + "\n";
+                gitcpp::writeDurable(repo.REMOVE_SET, false, removed_content);
+            }
+            index.erase(fileToRemove);
+            index.write();
     
-        if (!removed) {
-            gitcpp::message("No reason to remove the file.");
+            // Delete the file
+            fs::remove(fileToRemove);
+            return;
         }
+    
+        gitcpp::message("No reason to remove the file.");
     }
     
     void log() {
-        Repository repo(false);
+        Repository repo = Repository::open();
+        ObjectStore store(repo);
+        CommitGraph graph(repo);
         std::string current_branch = gitcpp::readContentsAsString(repo.CURRENT_BRANCH);
         fs::path head_path = repo.HEADS / current_branch;
         if (!fs::exists(head_path)) {
@@ -214,172 +392,79 @@ namespace gitcpp::commands {
         std::string current_commit_hash = gitcpp::readContentsAsString(head_path);
     
         while (!current_commit_hash.empty()) {
-            fs::path commit_path = repo.COMMITS / current_commit_hash;
-            if (!fs::exists(commit_path)) {
+            if (!store.contains(ObjectKind::Commit, current_commit_hash)) {
                 std::cerr << "Error: Corrupt repository. Commit object not found: " << current_commit_hash << std::endl;
                 break;
             }
     
-            std::string commit_contents = gitcpp::readContentsAsString(commit_path);
-            size_t nul_pos = commit_contents.find('\0');
-            if (nul_pos == std::string::npos) {
+            auto commit = store.commit(current_commit_hash);
+            if (!commit) {
                 std::cerr << "Error: Corrupt repository. Malformed commit object: " << current_commit_hash << std::endl;
                 break;
             }
+            std::vector<std::string> parents = commitParents(graph, store, current_commit_hash);
+            std::string parent_hash = parents.empty() ? "" : parents.back();
     
-            std::string body = commit_contents.substr(nul_pos + 1);
-            std::istringstream body_stream(body);
-            std::string line;
-            std::string parent_hash = "";
-    
-            std::cout << "===" << std::endl;
-            std::cout << "commit " << current_commit_hash << std::endl;
-    
-            // Parse the commit body header
-            while(std::getline(body_stream, line) && !line.empty()) {
-                if (line.rfind("parent ", 0) == 0) {
-                    parent_hash = line.substr(7);
-                }
-                // A real log would parse the date and format it nicely
-                if (line.rfind("author ", 0) == 0) {
-                    std::cout << line << std::endl;
-                }
-            }
-    
-            // The rest of the stream is the message
-            std::string message;
-            std::string temp_line;
-            while(std::getline(body_stream, temp_line)) {
-                message += "    " + temp_line + "\n";
-            }
-            std::cout << "\n" << message << std::endl;
+            printCommit(current_commit_hash, commit->view);
     
             current_commit_hash = parent_hash;
         }
     }
     
     void globalLog() {
-        Repository repo(false);
-        // Get all commit files from the commits directory
-        std::vector<std::string> all_commits = gitcpp::plainFilenamesIn(repo.COMMITS);
-        
-        if (all_commits.empty()) {
-            return;
-        }
-        
-        // Filter out invalid commit files (SHA-1 hashes should be 40 characters)
-        std::vector<std::string> valid_commits;
-        for (const std::string& commit_hash : all_commits) {
-            if (commit_hash.length() == 40) {
-                valid_commits.push_back(commit_hash);
-            }
-        }
-        
-        // Sort commits by filename (which are SHA-1 hashes) for consistent output
-        std::sort(valid_commits.begin(), valid_commits.end());
-        
-        for (const std::string& commit_hash : valid_commits) {
-            fs::path commit_path = repo.COMMITS / commit_hash;
-            
-            if (!fs::exists(commit_path)) {
-                continue;
-            }
-            
-            std::string commit_contents = gitcpp::readContentsAsString(commit_path);
-            size_t nul_pos = commit_contents.find('\0');
-            if (nul_pos == std::string::npos) {
-                std::cerr << "Error: Corrupt repository. Malformed commit object: " << commit_hash << std::endl;
-                continue;
-            }
-            
-            std::string body = commit_contents.substr(nul_pos + 1);
-            std::istringstream body_stream(body);
-            std::string line;
-            
-            std::cout << "===" << std::endl;
-            std::cout << "commit " << commit_hash << std::endl;
-            
-            // Parse the commit body header
-            while(std::getline(body_stream, line) && !line.empty()) {
-                // A real log would parse the date and format it nicely
-                if (line.rfind("author ", 0) == 0) {
-                    std::cout << line << std::endl;
+        Repository repo = Repository::open();
+        ObjectStore store(repo);
+        // Every commit id, loose and packed, sorted for consistent output
+        std::vector<std::string> commits = store.list(ObjectKind::Commit);
+        
+        // Commits are parsed in parallel a batch at a time and printed in
+        // id order, so the output matches a sequential scan while memory
+        // stays bounded by the batch
+        std::size_t batch = std::size_t(ThreadPool::shared(repo).size()) * 1024;
+        for (std::size_t first = 0; first < commits.size(); first += batch) {
+            std::vector<std::string> ids(commits.begin() + first,
+                                         commits.begin() + std::min(first + batch, commits.size()));
+            std::vector<std::string> entries(ids.size());
+            std::vector<char> malformed(ids.size(), 0);
+            store.scanCommits(ids, [&](std::size_t i, const CommitView* commit) {
+                if (commit) {
+                    entries[i] = formatCommit(ids[i], *commit);
+                } else {
+                    malformed[i] = 1;
                 }
+            });
+            for (std::size_t i = 0; i < ids.size(); ++i) {
+                if (malformed[i]) {
+                    std::cout << std::flush;
+                    std::cerr << "Error: Corrupt repository. Malformed commit object: " << ids[i] << std::endl;
+                    continue;
+                }
+                std::cout << entries[i];
             }
-            
-            // The rest of the stream is the message
-            std::string message;
-            std::string temp_line;
-            while(std::getline(body_stream, temp_line)) {
-                message += "    " + temp_line + "\n";
-            }
-            std::cout << "\n" << message << std::endl;
+            std::cout << std::flush;
         }
     }
     
-    void find(const std::string& message) {
-        Repository repo(false);
-        // Get all commit files from the commits directory
-        std::vector<std::string> all_commits = gitcpp::plainFilenamesIn(repo.COMMITS);
-        
-        if (all_commits.empty()) {
-            std::cout << "Found no commit with that message." << std::endl;
-            return;
+    void find(const std::string& query, const std::string& mode) {
+        if (!mode.empty() && mode != "--contains" && mode != "--word") {
+            throw error("Unknown find option: " + mode);
         }
+        Repository repo = Repository::open();
         
-        // Filter out invalid commit files (SHA-1 hashes should be 40 characters)
-        std::vector<std::string> valid_commits;
-        for (const std::string& commit_hash : all_commits) {
-            if (commit_hash.length() == 40) {
-                valid_commits.push_back(commit_hash);
-            }
+        // Repositories from before the index get one on their first search
+        if (!MessageIndex(repo).exists()) {
+            ObjectStore store(repo);
+            MessageIndex::write(repo, store);
         }
         
-        std::vector<std::string> matching_commits;
-        
-        for (const std::string& commit_hash : valid_commits) {
-            fs::path commit_path = repo.COMMITS / commit_hash;
-            
-            if (!fs::exists(commit_path)) {
-                continue;
-            }
-            
-            std::string commit_contents = gitcpp::readContentsAsString(commit_path);
-            size_t nul_pos = commit_contents.find('\0');
-            if (nul_pos == std::string::npos) {
-                continue; // Skip malformed commits
-            }
-            
-            std::string body = commit_contents.substr(nul_pos + 1);
-            std::istringstream body_stream(body);
-            std::string line;
-            
-            // Skip header lines until we get to the message
-            while(std::getline(body_stream, line) && !line.empty()) {
-                // Skip header lines (tree, parent, author, etc.)
-            }
-            
-            // The rest of the stream is the message
-            std::string commit_message;
-            std::string temp_line;
-            while(std::getline(body_stream, temp_line)) {
-                if (!commit_message.empty()) {
-                    commit_message += "\n";
-                }
-                commit_message += temp_line;
-            }
-            
-            // Check if the commit message matches
-            if (commit_message == message) {
-                matching_commits.push_back(commit_hash);
-            }
-        }
+        MessageIndex index(repo);
+        std::vector<std::string> matching_commits = mode == "--contains" ? index.containing(query)
+                                                  : mode == "--word"     ? index.withWords(query)
+                                                                         : index.exact(query);
         
         if (matching_commits.empty()) {
             std::cout << "Found no commit with that message." << std::endl;
         } else {
-            // Sort for consistent output
-            std::sort(matching_commits.begin(), matching_commits.end());
             for (const std::string& commit_hash : matching_commits) {
                 std::cout << commit_hash << std::endl;
             }
@@ -387,7 +472,8 @@ namespace gitcpp::commands {
     }
     
     void status() {
-        Repository repo(false);
+        Repository repo = Repository::open();
+        ObjectStore store(repo);
         std::cout << "=== Branches ===" << std::endl;
         std::string current_branch = gitcpp::readContentsAsString(repo.CURRENT_BRANCH);
         std::vector<std::string> branches = gitcpp::plainFilenamesIn(repo.HEADS);
@@ -405,15 +491,36 @@ namespace gitcpp::commands {
         }
         std::cout << std::endl;
     
+        // Get current commit's tree and the staging index to compare against
+        std::map<std::string, std::string> current_commit_files = readTree(store, commitTree(store, headCommit(repo)));
+        Index index = openIndex(repo, store);
+        std::vector<IndexEntry> tracked = index.entries();
+    
+        // Staged paths new since HEAD may be renames of paths no longer
+        // staged
+        std::map<std::string, std::string> added_files;
+        std::map<std::string, std::string> deleted_files = current_commit_files;
+        for (const IndexEntry& entry : tracked) {
+            if (!deleted_files.erase(entry.path)) added_files.emplace_hint(added_files.end(), entry.path, entry.id);
+        }
+        std::map<std::string, Rename> renamed_from;
+        for (const Rename& rename : detectRenames(store, deleted_files, added_files, renameOptions(repo),
+                                                  current_commit_files)) {
+            renamed_from[rename.newPath] = rename;
+        }
+        
         std::cout << "=== Staged Files ===" << std::endl;
-        std::string staged_content = gitcpp::readContentsAsString(repo.FILE_MAP);
-        if (staged_content != "{}") {
-            std::istringstream staged_stream(staged_content);
-            std::string line;
-            while (std::getline(staged_stream, line)) {
-                size_t colon_pos = line.find(':');
-                if (colon_pos != std::string::npos) {
-                    std::cout << line.substr(0, colon_pos) << std::endl;
+        for (const IndexEntry& entry : tracked) {
+            auto it = current_commit_files.find(entry.path);
+            if (it == current_commit_files.end() || it->second != entry.id) {
+                auto renamed = renamed_from.find(entry.path);
+                if (renamed != renamed_from.end() && renamed->second.copy) {
+                    // The source is still there
+                    std::cout << renamed->second.oldPath << " => " << entry.path << " (copy)" << std::endl;
+                } else if (renamed != renamed_from.end()) {
+                    std::cout << renamed->second.oldPath << " -> " << entry.path << std::endl;
+                } else {
+                    std::cout << entry.path << std::endl;
                 }
             }
         }
@@ -432,82 +539,20 @@ namespace gitcpp::commands {
     
         std::cout << "=== Modifications Not Staged For Commit ===" << std::endl;
         
-        // Get current commit's tree to compare against
-        std::map<std::string, std::string> current_commit_files;
-        fs::path head_path = repo.HEADS / current_branch;
-        if (fs::exists(head_path)) {
-            std::string head_commit_hash = gitcpp::readContentsAsString(head_path);
-            fs::path commit_path = repo.COMMITS / head_commit_hash;
-            if (fs::exists(commit_path)) {
-                std::string commit_contents = gitcpp::readContentsAsString(commit_path);
-                size_t nul_pos = commit_contents.find('\0');
-                if (nul_pos != std::string::npos) {
-                    std::string body = commit_contents.substr(nul_pos + 1);
-                    std::istringstream body_stream(body);
-                    std::string line;
-                    std::string tree_hash;
-                    while (std::getline(body_stream, line)) {
-                        if (line.rfind("tree ", 0) == 0) {
-                            tree_hash = line.substr(5);
-                            break;
-                        }
-                    }
-                    
-                    if (!tree_hash.empty() && fs::exists(repo.BLOBS / tree_hash)) {
-                        std::string tree_contents = gitcpp::readContentsAsString(repo.BLOBS / tree_hash);
-                        std::istringstream tree_stream(tree_contents);
-                        while (std::getline(tree_stream, line)) {
-                            size_t colon_pos = line.find(':');
-                            if (colon_pos != std::string::npos) {
-                                current_commit_files[line.substr(0, colon_pos)] = line.substr(colon_pos + 1);
-                            }
-                        }
-                    }
-                }
-            }
-        }
-        
-        // Get staged files
-        std::map<std::string, std::string> staged_files;
-        if (staged_content != "{}") {
-            std::istringstream staged_stream(staged_content);
-            std::string line;
-            while (std::getline(staged_stream, line)) {
-                size_t colon_pos = line.find(':');
-                if (colon_pos != std::string::npos) {
-                    staged_files[line.substr(0, colon_pos)] = line.substr(colon_pos + 1);
-                }
-            }
-        }
-        
-        // Get removed files
-        std::set<std::string> removed_files;
-        if (removed_content != "[]") {
-            std::istringstream removed_stream(removed_content);
-            std::string line;
-            while (std::getline(removed_stream, line)) {
-                removed_files.insert(line);
-            }
-        }
-        
-        // Check for modifications and deletions
+        std::vector<IndexEntry> current;
+        std::vector<FileState> states = workingTreeStates(repo, index, tracked, current);
+    
         std::vector<std::string> modifications;
-        for (const auto& [file_path, blob_hash] : current_commit_files) {
-            if (staged_files.count(file_path) || removed_files.count(file_path)) {
-                // File is staged or staged for removal, skip checking working directory
-                continue;
-            }
-            
-            if (!fs::exists(file_path)) {
-                // File was deleted
-                modifications.push_back(file_path + " (deleted)");
-            } else {
-                // Check if file was modified
-                auto content_bytes = gitcpp::readContents(file_path);
-                std::string current_hash = gitcpp::sha1(content_bytes);
-                if (current_hash != blob_hash) {
-                    modifications.push_back(file_path + " (modified)");
-                }
+        bool refreshed = false;
+        for (std::size_t i = 0; i < tracked.size(); ++i) {
+            if (states[i] == FileState::Deleted) {
+                modifications.push_back(tracked[i].path + " (deleted)");
+            } else if (states[i] == FileState::Modified) {
+                modifications.push_back(tracked[i].path + " (modified)");
+            } else if (states[i] == FileState::Refreshed) {
+                // Unchanged: remember the new stat data so the next status can skip it
+                index.set(current[i]);
+                refreshed = true;
             }
         }
         
@@ -520,6 +565,7 @@ namespace gitcpp::commands {
         std::cout << "=== Untracked Files ===" << std::endl;
         
         // Find untracked files (files in working directory not in commit or staging)
+        std::vector<std::string> ignore_patterns = loadGitignorePatterns();
         std::vector<std::string> untracked_files;
         std::function<void(const fs::path&)> scan_directory = [&](const fs::path& dir) {
             if (!fs::exists(dir) || !fs::is_directory(dir)) return;
@@ -534,7 +580,7 @@ namespace gitcpp::commands {
                     std::string relative_path = fs::relative(entry.path(), fs::current_path()).string();
                     
                     // Skip if file is in current commit, staged, or ignored
-                    if (!current_commit_files.count(relative_path) && !staged_files.count(relative_path) && !isIgnored(relative_path)) {
+                    if (!current_commit_files.count(relative_path) && !index.contains(relative_path) && !isIgnored(ignore_patterns, relative_path)) {
                         untracked_files.push_back(relative_path);
                     }
                 }
@@ -547,10 +593,167 @@ namespace gitcpp::commands {
             std::cout << file << std::endl;
         }
         std::cout << std::endl;
+    
+        if (refreshed) {
+            index.write();
+        }
+    }
+    
+    // Commit named by a branch or a commit id, or "" if there is none
+    static std::string resolveCommit(const Repository& repo, const ObjectStore& store, const std::string& name) {
+        fs::path branch_path = repo.HEADS / name;
+        if (!name.empty() && fs::is_regular_file(branch_path)) {
+            return gitcpp::readContentsAsString(branch_path);
+        }
+        return store.contains(ObjectKind::Commit, name) ? name : "";
+    }
+    
+    // Print one file's diff; a missing side is a created or deleted file.
+    // With `rename`, `path` is the new path of a renamed or copied file.
+    static void printFileDiff(const std::string& path, const std::optional<std::string>& old_contents,
+                              const std::optional<std::string>& new_contents, const Rename* rename = nullptr) {
+        std::string old_path = rename ? rename->oldPath : path;
+        std::string old_name = old_contents ? "a/" + old_path : "/dev/null";
+        std::string new_name = new_contents ? "b/" + path : "/dev/null";
+        std::string_view old_text = old_contents ? std::string_view(*old_contents) : std::string_view();
+        std::string_view new_text = new_contents ? std::string_view(*new_contents) : std::string_view();
+        
+        std::cout << "diff --git a/" << old_path << " b/" << path << "\n";
+        if (rename) {
+            const char* kind = rename->copy ? "copy" : "rename";
+            std::cout << "similarity index " << rename->similarity << "%\n"
+                      << kind << " from " << rename->oldPath << "\n" << kind << " to " << path << "\n";
+        } else if (!old_contents) {
+            std::cout << "new file\n";
+        } else if (!new_contents) {
+            std::cout << "deleted file\n";
+        }
+        if (gitcpp::isBinary(old_text) || gitcpp::isBinary(new_text)) {
+            if (old_text != new_text) {
+                std::cout << "Binary files " << old_name << " and " << new_name << " differ\n";
+            }
+            return;
+        }
+        std::cout << gitcpp::unifiedDiff(old_text, new_text, old_name, new_name);
+    }
+    
+    // A changed path: blob ids on the old and new side, "" where missing
+    struct FileChange {
+        std::string path;
+        std::string oldId;
+        std::string newId;
+    };
+    
+    // Print the diffs of `changes` (sorted by path) between the tree
+    // `old_tree` and a newer state. Added paths are matched against deleted
+    // ones (and, with rename.copies, against every old file) and printed as
+    // renames or copies; deleted paths consumed by a rename are skipped.
+    static void printChanges(const Repository& repo, const ObjectStore& store, const std::string& old_tree,
+                             const std::vector<FileChange>& changes) {
+        auto blob = [&](const std::string& id) -> std::optional<std::string> {
+            if (id.empty()) return std::nullopt;
+            return store.readAsString(ObjectKind::Blob, id);
+        };
+        
+        std::map<std::string, std::string> deleted, added;
+        for (const FileChange& change : changes) {
+            if (change.newId.empty()) deleted.emplace_hint(deleted.end(), change.path, change.oldId);
+            if (change.oldId.empty()) added.emplace_hint(added.end(), change.path, change.newId);
+        }
+        RenameOptions options = renameOptions(repo);
+        std::map<std::string, std::string> copy_sources;
+        if (options.copies && !added.empty()) copy_sources = readTree(store, old_tree);
+        std::map<std::string, Rename> renames;
+        std::set<std::string> renamed;
+        for (Rename& rename : detectRenames(store, deleted, added, options, copy_sources)) {
+            if (!rename.copy) renamed.insert(rename.oldPath);
+            renames.emplace(rename.newPath, std::move(rename));
+        }
+        
+        for (const FileChange& change : changes) {
+            auto rename = renames.find(change.path);
+            if (rename != renames.end()) {
+                const std::string& old_id = rename->second.copy ? copy_sources.at(rename->second.oldPath)
+                                                                : deleted.at(rename->second.oldPath);
+                printFileDiff(change.path, blob(old_id), blob(change.newId), &rename->second);
+            } else if (!renamed.count(change.path)) {
+                printFileDiff(change.path, blob(change.oldId), blob(change.newId));
+            }
+        }
+    }
+    
+    void diff(const std::vector<std::string>& args) {
+        Repository repo = Repository::open();
+        ObjectStore store(repo);
+        
+        if (args.size() == 2) {
+            // diff <commit> <commit>: subtrees and blobs with equal ids are
+            // skipped without being read
+            std::string old_commit = resolveCommit(repo, store, args[0]);
+            std::string new_commit = resolveCommit(repo, store, args[1]);
+            if (old_commit.empty() || new_commit.empty()) {
+                std::cout << "No commit with that id exists." << std::endl;
+                return;
+            }
+            std::string old_tree = commitTree(store, old_commit);
+            std::vector<FileChange> changes;
+            diffTrees(store, old_tree, commitTree(store, new_commit),
+                      [&](const std::string& path, const std::string& old_id, const std::string& new_id) {
+                changes.push_back(FileChange{path, old_id, new_id});
+            });
+            printChanges(repo, store, old_tree, changes);
+            return;
+        }
+        
+        if (args.size() == 1 && (args[0] == "--staged" || args[0] == "--cached")) {
+            // diff --staged: HEAD against the index
+            std::string head_tree = commitTree(store, headCommit(repo));
+            std::map<std::string, std::string> head_files = readTree(store, head_tree);
+            std::map<std::string, std::string> staged_files;
+            for (const IndexEntry& entry : openIndex(repo, store).entries()) {
+                staged_files.emplace_hint(staged_files.end(), entry.path, entry.id);
+            }
+            std::set<std::string> paths;
+            for (const auto& file : head_files) paths.insert(file.first);
+            for (const auto& file : staged_files) paths.insert(file.first);
+            std::vector<FileChange> changes;
+            for (const std::string& path : paths) {
+                auto old_it = head_files.find(path);
+                auto new_it = staged_files.find(path);
+                std::string old_id = old_it == head_files.end() ? "" : old_it->second;
+                std::string new_id = new_it == staged_files.end() ? "" : new_it->second;
+                if (old_id != new_id) {
+                    changes.push_back(FileChange{path, old_id, new_id});
+                }
+            }
+            printChanges(repo, store, head_tree, changes);
+            return;
+        }
+        
+        if (!args.empty()) {
+            std::cout << "Usage: diff [--staged | <commit> <commit>]" << std::endl;
+            return;
+        }
+        
+        // diff: the index against the working tree. Files whose stat data
+        // matches the index are not read.
+        Index index = openIndex(repo, store);
+        std::vector<IndexEntry> tracked = index.entries();
+        std::vector<IndexEntry> current;
+        std::vector<FileState> states = workingTreeStates(repo, index, tracked, current);
+        for (std::size_t i = 0; i < tracked.size(); ++i) {
+            if (states[i] == FileState::Modified) {
+                printFileDiff(tracked[i].path, store.readAsString(ObjectKind::Blob, tracked[i].id),
+                              gitcpp::readContentsAsString(tracked[i].path));
+            } else if (states[i] == FileState::Deleted) {
+                printFileDiff(tracked[i].path, store.readAsString(ObjectKind::Blob, tracked[i].id), std::nullopt);
+            }
+        }
     }
     
     void restore(const std::vector<std::string>& argv) {
-        Repository repo(false);
+        Repository repo = Repository::open();
+        ObjectStore store(repo);
         // Skip the "restore" command itself
         std::vector<std::string> args;
         for (size_t i = 1; i < argv.size(); ++i) {
@@ -588,69 +791,34 @@ namespace gitcpp::commands {
         }
         
         // Validate commit exists
-        fs::path commit_path = repo.COMMITS / commit_id;
-        if (!fs::exists(commit_path)) {
+        if (!store.contains(ObjectKind::Commit, commit_id)) {
             std::cout << "No commit with that id exists." << std::endl;
             return;
         }
         
         // Read commit to get tree hash
-        std::string commit_contents = gitcpp::readContentsAsString(commit_path);
-        size_t nul_pos = commit_contents.find('\0');
-        if (nul_pos == std::string::npos) {
-            std::cout << "Corrupt commit object." << std::endl;
-            return;
-        }
-        
-        std::string body = commit_contents.substr(nul_pos + 1);
-        std::istringstream body_stream(body);
-        std::string line;
-        std::string tree_hash;
-        
-        while (std::getline(body_stream, line)) {
-            if (line.rfind("tree ", 0) == 0) {
-                tree_hash = line.substr(5);
-                break;
-            }
-        }
-        
-        if (tree_hash.empty()) {
+        auto commit = store.commit(commit_id);
+        if (!commit) {
             std::cout << "Corrupt commit object - no tree found." << std::endl;
             return;
         }
+        const std::string& tree_hash = commit->tree;
         
         // Read tree to find file
-        fs::path tree_path = repo.BLOBS / tree_hash;
-        if (!fs::exists(tree_path)) {
+        if (!store.contains(ObjectKind::Blob, tree_hash)) {
             std::cout << "Corrupt repository - tree object missing." << std::endl;
             return;
         }
         
-        std::string tree_contents = gitcpp::readContentsAsString(tree_path);
-        std::istringstream tree_stream(tree_contents);
-        std::string blob_hash;
-        bool file_found = false;
-        
-        while (std::getline(tree_stream, line)) {
-            size_t colon_pos = line.find(':');
-            if (colon_pos != std::string::npos) {
-                std::string tree_file_path = line.substr(0, colon_pos);
-                if (tree_file_path == file_path) {
-                    blob_hash = line.substr(colon_pos + 1);
-                    file_found = true;
-                    break;
-                }
-            }
-        }
-        
-        if (!file_found) {
+        std::optional<std::string> found = findInTree(store, tree_hash, file_path);
+        if (!found) {
             std::cout << "File does not exist in that commit." << std::endl;
             return;
         }
+        std::string blob_hash = *found;
         
         // Read blob and restore file
-        fs::path blob_path = repo.BLOBS / blob_hash;
-        if (!fs::exists(blob_path)) {
+        if (!store.contains(ObjectKind::Blob, blob_hash)) {
             std::cout << "Corrupt repository - blob object missing." << std::endl;
             return;
         }
@@ -662,14 +830,13 @@ namespace gitcpp::commands {
         }
         
         // Copy blob content to working directory
-        auto blob_contents = gitcpp::readContents(blob_path);
-        gitcpp::writeContents(file_fs_path, blob_contents);
+        store.checkout(blob_hash, file_fs_path);
         
         std::cout << "Restored " << file_path << " from commit " << commit_id << std::endl;
     }
     
     void branch(const std::string& name) {
-        Repository repo(false);
+        Repository repo = Repository::open();
         fs::path branch_path = repo.HEADS / name;
         if (fs::exists(branch_path)) {
             gitcpp::message("A branch with that name already exists.");
@@ -686,11 +853,12 @@ namespace gitcpp::commands {
         }
         
         std::string head_commit_hash = gitcpp::readContentsAsString(head_path);
-        gitcpp::writeContents(branch_path, head_commit_hash);
+        gitcpp::writeDurable(branch_path, false, head_commit_hash);
     }
     
     void switchBranch(const std::string& name, const std::string& mode) {
-        Repository repo(false);
+        Repository repo = Repository::open();
+        ObjectStore store(repo);
         fs::path branch_path = repo.HEADS / name;
         if (!fs::exists(branch_path)) {
             gitcpp::message("A branch with that name does not exist.");
@@ -707,75 +875,38 @@ namespace gitcpp::commands {
         // Get the commit hash of the branch to switch to
         std::string branch_commit_hash = gitcpp::readContentsAsString(branch_path);
     
-        // Get the tree hash from the commit
-        fs::path commit_path = repo.COMMITS / branch_commit_hash;
-        std::string commit_contents = gitcpp::readContentsAsString(commit_path);
-        size_t nul_pos = commit_contents.find('\0');
-        std::string body = commit_contents.substr(nul_pos + 1);
-        std::istringstream body_stream(body);
-        std::string line;
-        std::string tree_hash;
-        while (std::getline(body_stream, line)) {
-            if (line.rfind("tree ", 0) == 0) {
-                tree_hash = line.substr(5);
-                break;
-            }
-        }
-    
-        // Get the tree of the current branch
-        fs::path head_path = repo.HEADS / current_branch;
-        std::string head_commit_hash = gitcpp::readContentsAsString(head_path);
-        fs::path current_commit_path = repo.COMMITS / head_commit_hash;
-        std::string current_commit_contents = gitcpp::readContentsAsString(current_commit_path);
-        size_t current_nul_pos = current_commit_contents.find('\0');
-        std::string current_body = current_commit_contents.substr(current_nul_pos + 1);
-        std::istringstream current_body_stream(current_body);
-        std::string current_line;
-        std::string current_tree_hash;
-        while (std::getline(current_body_stream, current_line)) {
-            if (current_line.rfind("tree ", 0) == 0) {
-                current_tree_hash = current_line.substr(5);
-                break;
-            }
-        }
-    
-        // Delete files that are tracked in the current branch
-        std::string current_tree_contents = gitcpp::readContentsAsString(repo.BLOBS / current_tree_hash);
-        std::istringstream current_tree_stream(current_tree_contents);
-        while (std::getline(current_tree_stream, current_line)) {
-            size_t colon_pos = current_line.find(':');
-            if (colon_pos != std::string::npos) {
-                std::string file_path = current_line.substr(0, colon_pos);
-                fs::remove(file_path);
+        // Get the tree hash from the commit, and the tree of the current branch
+        std::string tree_hash = commitTree(store, branch_commit_hash);
+        std::string current_tree_hash = commitTree(store, headCommit(repo));
+    
+        // Only paths whose blobs differ between the trees are touched;
+        // unchanged files (and their mtimes) are left alone. Removals go
+        // first so a file can replace a directory and vice versa.
+        std::vector<std::pair<std::string, std::string>> changed;
+        diffTrees(store, current_tree_hash, tree_hash,
+                  [&](const std::string& file_path, const std::string&, const std::string& blob_hash) {
+            if (blob_hash.empty()) {
+                removeWorkingFile(file_path);
+            } else {
+                changed.emplace_back(file_path, blob_hash);
             }
+        });
+        checkoutFiles(repo, store, changed);
+        std::set<std::string> written;
+        for (const auto& change : changed) {
+            written.insert(change.first);
         }
     
-        // Checkout the files from the new branch's tree
-        std::string tree_contents = gitcpp::readContentsAsString(repo.BLOBS / tree_hash);
-        std::istringstream tree_stream(tree_contents);
-        while (std::getline(tree_stream, line)) {
-            size_t colon_pos = line.find(':');
-            if (colon_pos != std::string::npos) {
-                std::string file_path = line.substr(0, colon_pos);
-                std::string blob_hash = line.substr(colon_pos + 1);
-                std::string blob_contents = gitcpp::readContentsAsString(repo.BLOBS / blob_hash);
-                
-                // Create parent directories if they don't exist
-                fs::path parent_dir = fs::path(file_path).parent_path();
-                if (!parent_dir.empty() && !fs::exists(parent_dir)) {
-                    fs::create_directories(parent_dir);
-                }
-                
-                gitcpp::writeContents(file_path, blob_contents);
-            }
-        }
+        // The index now tracks the checked-out tree
+        updateIndexAfterCheckout(repo, store, readTree(store, tree_hash), written);
+        gitcpp::writeDurable(repo.REMOVE_SET, false, "[]");
     
         // Update the current branch
-        gitcpp::writeContents(repo.CURRENT_BRANCH, name);
+        gitcpp::writeDurable(repo.CURRENT_BRANCH, false, name);
     }
     
     void rmBranch(const std::string& name) {
-        Repository repo(false);
+        Repository repo = Repository::open();
         // Check if branch exists
         fs::path branch_path = repo.HEADS / name;
         if (!fs::exists(branch_path)) {
@@ -800,58 +931,29 @@ namespace gitcpp::commands {
     }
     
     void reset(const std::string& commitId) {
-        Repository repo(false);
+        Repository repo = Repository::open();
+        ObjectStore store(repo);
         // Validate commit exists
-        fs::path commit_path = repo.COMMITS / commitId;
-        if (!fs::exists(commit_path)) {
+        if (!store.contains(ObjectKind::Commit, commitId)) {
             std::cout << "No commit with that id exists." << std::endl;
             return;
         }
         
         // Read commit to get tree hash
-        std::string commit_contents = gitcpp::readContentsAsString(commit_path);
-        size_t nul_pos = commit_contents.find('\0');
-        if (nul_pos == std::string::npos) {
-            std::cout << "Corrupt commit object." << std::endl;
-            return;
-        }
-        
-        std::string body = commit_contents.substr(nul_pos + 1);
-        std::istringstream body_stream(body);
-        std::string line;
-        std::string tree_hash;
-        
-        while (std::getline(body_stream, line)) {
-            if (line.rfind("tree ", 0) == 0) {
-                tree_hash = line.substr(5);
-                break;
-            }
-        }
-        
-        if (tree_hash.empty()) {
+        auto commit = store.commit(commitId);
+        if (!commit) {
             std::cout << "Corrupt commit object - no tree found." << std::endl;
             return;
         }
+        const std::string& tree_hash = commit->tree;
         
         // Read tree to get all files in the commit
-        fs::path tree_path = repo.BLOBS / tree_hash;
-        if (!fs::exists(tree_path)) {
+        if (!store.contains(ObjectKind::Blob, tree_hash)) {
             std::cout << "Corrupt repository - tree object missing." << std::endl;
             return;
         }
         
-        std::string tree_contents = gitcpp::readContentsAsString(tree_path);
-        std::istringstream tree_stream(tree_contents);
-        std::map<std::string, std::string> commit_files;
-        
-        while (std::getline(tree_stream, line)) {
-            size_t colon_pos = line.find(':');
-            if (colon_pos != std::string::npos) {
-                std::string file_path = line.substr(0, colon_pos);
-                std::string blob_hash = line.substr(colon_pos + 1);
-                commit_files[file_path] = blob_hash;
-            }
-        }
+        std::map<std::string, std::string> commit_files = readTree(store, tree_hash);
         
         // Get current working directory files to know what to remove
         std::set<std::string> current_files;
@@ -881,38 +983,26 @@ namespace gitcpp::commands {
         }
         
         // Restore all files from the commit
-        for (const auto& [file_path, blob_hash] : commit_files) {
-            fs::path blob_path = repo.BLOBS / blob_hash;
-            if (!fs::exists(blob_path)) {
-                std::cout << "Warning: blob object missing for " << file_path << std::endl;
-                continue;
-            }
-            
-            // Create parent directories if needed
-            fs::path file_fs_path(file_path);
-            if (file_fs_path.has_parent_path()) {
-                fs::create_directories(file_fs_path.parent_path());
-            }
-            
-            // Copy blob content to working directory
-            auto blob_contents = gitcpp::readContents(blob_path);
-            gitcpp::writeContents(file_fs_path, blob_contents);
+        std::vector<std::pair<std::string, std::string>> to_restore(commit_files.begin(), commit_files.end());
+        for (const std::string& file_path : checkoutFiles(repo, store, to_restore)) {
+            std::cout << "Warning: blob object missing for " << file_path << std::endl;
         }
         
         // Update current branch to point to the new commit
         std::string current_branch = gitcpp::readContentsAsString(repo.CURRENT_BRANCH);
         fs::path head_path = repo.HEADS / current_branch;
-        gitcpp::writeContents(head_path, commitId);
+        gitcpp::writeDurable(head_path, false, commitId);
         
-        // Clear staging area
-        gitcpp::writeContents(repo.FILE_MAP, "{}");
-        gitcpp::writeContents(repo.REMOVE_SET, "[]");
+        // Reset the staging area to the commit's files
+        setIndexFromTree(repo, store, commit_files, true);
+        gitcpp::writeDurable(repo.REMOVE_SET, false, "[]");
         
         std::cout << "Reset to commit " << commitId << std::endl;
     }
     
     void merge(const std::string& otherBranch) {
-        Repository repo(false);
+        Repository repo = Repository::open();
+        ObjectStore store(repo);
         // Check if other branch exists
         fs::path other_branch_path = repo.HEADS / otherBranch;
         if (!fs::exists(other_branch_path)) {
@@ -938,23 +1028,38 @@ namespace gitcpp::commands {
             return;
         }
         
-        // Find common ancestor (merge base)
-        std::string merge_base = findMergeBase(current_commit, other_commit);
+        // With reachability bitmaps, ancestry is answered without walking
+        // history down to the merge base
+        BitmapIndex bitmaps(repo);
+        if (!bitmaps.empty()) {
+            CommitGraph graph(repo);
+            if (bitmaps.isAncestor(graph, store, current_commit, other_commit)) {
+                performFastForwardMerge(repo, store, other_commit, otherBranch);
+                return;
+            }
+            if (bitmaps.isAncestor(graph, store, other_commit, current_commit)) {
+                gitcpp::message("Already up to date.");
+                return;
+            }
+        }
+        
+        // Find the common ancestors (merge bases)
+        std::vector<std::string> merge_bases = findMergeBases(repo, store, current_commit, other_commit);
         
         // Check for fast-forward merge
-        if (merge_base == current_commit) {
+        if (merge_bases.size() == 1 && merge_bases[0] == current_commit) {
             // Fast-forward merge: just update current branch to other commit
-            performFastForwardMerge(other_commit, otherBranch);
+            performFastForwardMerge(repo, store, other_commit, otherBranch);
             return;
         }
         
-        if (merge_base == other_commit) {
+        if (merge_bases.size() == 1 && merge_bases[0] == other_commit) {
             gitcpp::message("Already up to date.");
             return;
         }
         
         // Perform three-way merge
-        performThreeWayMerge(current_commit, other_commit, merge_base, otherBranch);
+        performThreeWayMerge(repo, store, current_commit, other_commit, merge_bases, otherBranch);
     }
     
     // Utility placeholders
@@ -966,8 +1071,8 @@ namespace gitcpp::commands {
     // Helper function implementations for merge
     
     // Get all ancestors of a commit
-    std::set<std::string> getCommitAncestors(const std::string& commitHash) {
-        Repository repo(false);
+    std::set<std::string> getCommitAncestors(const Repository& repo, const ObjectStore& store, const std::string& commitHash) {
+        CommitGraph graph(repo);
         std::set<std::string> ancestors;
         std::queue<std::string> toVisit;
         
@@ -976,29 +1081,41 @@ namespace gitcpp::commands {
             ancestors.insert(commitHash);
         }
         
-        while (!toVisit.empty()) {
+        // Commits in the graph are walked by position without touching
+        // their objects
+        std::vector<bool> visited(graph.size(), false);
+        std::vector<std::uint32_t> graphQueue;
+        
+        while (!toVisit.empty() || !graphQueue.empty()) {
+            if (!graphQueue.empty()) {
+                std::uint32_t pos = graphQueue.back();
+                graphQueue.pop_back();
+                for (std::uint32_t parent : graph.parents(pos)) {
+                    if (!visited[parent]) {
+                        visited[parent] = true;
+                        ancestors.insert(graph.id(parent));
+                        graphQueue.push_back(parent);
+                    }
+                }
+                continue;
+            }
+            
             std::string current = toVisit.front();
             toVisit.pop();
             
-            fs::path commit_path = repo.COMMITS / current;
-            if (!fs::exists(commit_path)) continue;
-            
-            std::string commit_contents = gitcpp::readContentsAsString(commit_path);
-            size_t nul_pos = commit_contents.find('\0');
-            if (nul_pos == std::string::npos) continue;
-            
-            // Parse commit to find parent
-            std::string metadata = commit_contents.substr(nul_pos + 1);
-            std::istringstream stream(metadata);
-            std::string line;
+            std::uint32_t pos = graph.find(current);
+            if (pos != CommitGraph::NOT_FOUND) {
+                if (!visited[pos]) {
+                    visited[pos] = true;
+                    graphQueue.push_back(pos);
+                }
+                continue;
+            }
             
-            while (std::getline(stream, line)) {
-                if (line.find("parent ") == 0) {
-                    std::string parent = line.substr(7); // Skip "parent "
-                    if (ancestors.find(parent) == ancestors.end()) {
-                        ancestors.insert(parent);
-                        toVisit.push(parent);
-                    }
+            for (const std::string& parent : commitParents(graph, store, current)) {
+                if (ancestors.find(parent) == ancestors.end()) {
+                    ancestors.insert(parent);
+                    toVisit.push(parent);
                 }
             }
         }
@@ -1006,173 +1123,68 @@ namespace gitcpp::commands {
         return ancestors;
     }
     
-    // Helper function to find merge base (common ancestor)
-    std::string findMergeBase(const std::string& commit1, const std::string& commit2) {
-        std::cout << "DEBUG: Finding merge base between " << commit1 << " and " << commit2 << std::endl;
-        
-        // Simple implementation: find first common ancestor
-        std::set<std::string> ancestors1 = getCommitAncestors(commit1);
-        std::set<std::string> ancestors2 = getCommitAncestors(commit2);
-        
-        std::cout << "DEBUG: Ancestors1 count: " << ancestors1.size() << std::endl;
-        std::cout << "DEBUG: Ancestors2 count: " << ancestors2.size() << std::endl;
-        
-        // Find intersection
-        for (const auto& ancestor : ancestors1) {
-            if (ancestors2.count(ancestor)) {
-                std::cout << "DEBUG: Found merge base: " << ancestor << std::endl;
-                return ancestor;
-            }
-        }
-        
-        std::cout << "DEBUG: No merge base found" << std::endl;
-        return ""; // No common ancestor found
+    // Helper function to find the merge bases (best common ancestors), best first
+    std::vector<std::string> findMergeBases(const Repository& repo, const ObjectStore& store,
+                                            const std::string& commit1, const std::string& commit2) {
+        CommitGraph graph(repo);
+        return mergeBases(graph, store, commit1, commit2);
     }
     
     // Update working directory to match a commit
-    void updateWorkingDirectory(const std::string& commitHash) {
-        Repository repo(false);
-        fs::path commit_path = repo.COMMITS / commitHash;
-        if (!fs::exists(commit_path)) return;
-        
-        std::string commit_contents = gitcpp::readContentsAsString(commit_path);
-        size_t nul_pos = commit_contents.find('\0');
-        if (nul_pos == std::string::npos) return;
-        
-        std::string tree_hash = commit_contents.substr(0, nul_pos);
-        if (tree_hash.empty()) return;
-        
-        fs::path tree_path = repo.BLOBS / tree_hash;
-        if (!fs::exists(tree_path)) return;
-        
-        std::string tree_contents = gitcpp::readContentsAsString(tree_path);
-        std::istringstream tree_stream(tree_contents);
-        std::string line;
+    void updateWorkingDirectory(const Repository& repo, const ObjectStore& store, const std::string& commitHash) {
+        auto commit = store.commit(commitHash);
+        if (!commit || !store.contains(ObjectKind::Blob, commit->tree)) return;
         
         // Clear current working directory of tracked files
         // (In a real implementation, you'd be more careful about this)
         
-        // Restore files from the commit
-        while (std::getline(tree_stream, line)) {
-            if (line.empty()) continue;
-            
-            size_t colon_pos = line.find(':');
-            if (colon_pos == std::string::npos) continue;
-            
-            std::string file_path = line.substr(0, colon_pos);
-            std::string blob_hash = line.substr(colon_pos + 1);
-            
-            fs::path blob_path = repo.BLOBS / blob_hash;
-            if (fs::exists(blob_path)) {
-                auto blob_contents = gitcpp::readContents(blob_path);
-                gitcpp::writeContents(file_path, blob_contents);
-            }
-        }
+        // Restore files from the commit; missing blobs are skipped
+        std::map<std::string, std::string> files = readTree(store, commit->tree);
+        checkoutFiles(repo, store, {files.begin(), files.end()});
     }
     
     // Perform fast-forward merge
-    void performFastForwardMerge(const std::string& targetCommit, const std::string& branchName) {
-        Repository repo(false);
+    void performFastForwardMerge(const Repository& repo, const ObjectStore& store,
+                                 const std::string& targetCommit, const std::string& branchName) {
         std::string current_branch = gitcpp::readContentsAsString(repo.CURRENT_BRANCH);
         fs::path current_head_path = repo.HEADS / current_branch;
         
         // Update current branch to point to target commit
-        gitcpp::writeContents(current_head_path, targetCommit);
+        gitcpp::writeDurable(current_head_path, false, targetCommit);
         
         // Update working directory to match target commit
-        updateWorkingDirectory(targetCommit);
+        updateWorkingDirectory(repo, store, targetCommit);
+        setIndexFromTree(repo, store, readTree(store, commitTree(store, targetCommit)), true);
         
         std::cout << "Fast-forward merge completed. Merged branch '" << branchName << "' into '" << current_branch << "'." << std::endl;
     }
     
     // Get files from a commit
-    std::map<std::string, std::string> getFilesFromCommit(const std::string& commitHash) {
-        Repository repo(false);
-        std::map<std::string, std::string> files;
-        
-        if (commitHash.empty()) {
-            std::cout << "DEBUG: Empty commit hash" << std::endl;
-            return files;
-        }
-        
-        fs::path commit_path = repo.COMMITS / commitHash;
-        if (!fs::exists(commit_path)) {
-            std::cout << "DEBUG: Commit file doesn't exist: " << commit_path << std::endl;
-            return files;
+    std::map<std::string, std::string> getFilesFromCommit(const ObjectStore& store, const std::string& commitHash) {
+        auto commit = store.commit(commitHash);
+        if (!commit) {
+            return {};
         }
-        
-        std::string commit_contents = gitcpp::readContentsAsString(commit_path);
-        size_t nul_pos = commit_contents.find('\0');
-        if (nul_pos == std::string::npos) {
-            std::cout << "DEBUG: No null separator found in commit" << std::endl;
-            return files;
-        }
-        
-        // The tree hash is stored in the commit metadata, not at the beginning
-        std::string metadata = commit_contents.substr(nul_pos + 1);
-        std::istringstream metadata_stream(metadata);
-        std::string line;
-        std::string tree_hash;
-        
-        // Find the tree line in the metadata
-        while (std::getline(metadata_stream, line)) {
-            if (line.rfind("tree ", 0) == 0) {
-                tree_hash = line.substr(5); // Skip "tree "
-                break;
-            }
-        }
-        
-        if (tree_hash.empty()) {
-            std::cout << "DEBUG: No tree found in commit metadata" << std::endl;
-            return files;
-        }
-        
-        std::cout << "DEBUG: Found tree hash in metadata: " << tree_hash << std::endl;
-        
-        fs::path tree_path = repo.BLOBS / tree_hash;
-        if (!fs::exists(tree_path)) {
-            std::cout << "DEBUG: Tree file doesn't exist: " << tree_path << std::endl;
-            return files;
-        }
-        
-        std::string tree_contents = gitcpp::readContentsAsString(tree_path);
-        std::cout << "DEBUG: Tree contents: " << tree_contents << std::endl;
-        
-        std::istringstream tree_stream(tree_contents);
-        
-        while (std::getline(tree_stream, line)) {
-            if (line.empty()) continue;
-            
-            size_t colon_pos = line.find(':');
-            if (colon_pos == std::string::npos) continue;
-            
-            std::string file_path = line.substr(0, colon_pos);
-            std::string blob_hash = line.substr(colon_pos + 1);
-            files[file_path] = blob_hash;
-            std::cout << "DEBUG: Found file: " << file_path << " -> " << blob_hash << std::endl;
-        }
-        
-        return files;
+        return readTree(store, commit->tree);
     }
     
-    // Create a file with conflict markers
-    void createConflictFile(const std::string& filePath, const std::string& currentHash, const std::string& otherHash) {
-        Repository repo(false);
+    // Whole-file conflict: both versions between markers (used when the
+    // versions cannot be merged line by line)
+    std::string conflictFileContents(const ObjectStore& store, const std::string& filePath,
+                                     const std::string& currentHash, const std::string& otherHash) {
         std::string currentContent = "";
         std::string otherContent = "";
         
         if (!currentHash.empty()) {
-            fs::path current_blob = repo.BLOBS / currentHash;
-            if (fs::exists(current_blob)) {
-                auto bytes = gitcpp::readContents(current_blob);
+            if (store.contains(ObjectKind::Blob, currentHash)) {
+                auto bytes = store.read(ObjectKind::Blob, currentHash);
                 currentContent = std::string(bytes.begin(), bytes.end());
             }
         }
         
         if (!otherHash.empty()) {
-            fs::path other_blob = repo.BLOBS / otherHash;
-            if (fs::exists(other_blob)) {
-                auto bytes = gitcpp::readContents(other_blob);
+            if (store.contains(ObjectKind::Blob, otherHash)) {
+                auto bytes = store.read(ObjectKind::Blob, otherHash);
                 otherContent = std::string(bytes.begin(), bytes.end());
             }
         }
@@ -1184,12 +1196,15 @@ namespace gitcpp::commands {
             otherContent +
             "\n>>>>>>> " + filePath + "\n";
         
-        gitcpp::writeContents(filePath, conflictContent);
+        return conflictContent;
     }
     
-    // Merge a single file (three-way merge logic)
-    std::string mergeFile(const std::string& filePath, const std::string& currentHash, 
-                         const std::string& otherHash, const std::string& baseHash, bool& hasConflicts) {
+    // Merge a single file (three-way merge logic). Nothing is written to the
+    // working tree: cleanly merged contents are stored as a blob, and a
+    // conflicted file's contents (with markers) go to `conflictFiles`.
+    std::string mergeFile(const ObjectStore& store, const std::string& filePath, const std::string& currentHash, 
+                         const std::string& otherHash, const std::string& baseHash,
+                         std::map<std::string, std::string>& conflictFiles) {
         // Case 1: File unchanged in both branches
         if (currentHash == otherHash) {
             return currentHash;
@@ -1205,71 +1220,117 @@ namespace gitcpp::commands {
             return otherHash;
         }
         
-        // Case 4: File changed in both branches - potential conflict
-        if (currentHash != otherHash && currentHash != baseHash && otherHash != baseHash) {
-            // For now, mark as conflict and use current version
-            // In a full implementation, you'd do line-by-line merging
-            std::cout << "CONFLICT (content): Merge conflict in " << filePath << std::endl;
-            std::cout << "Automatic merge failed; fix conflicts and then commit the result." << std::endl;
-            hasConflicts = true;
-            
-            // Create conflict markers in the file
-            createConflictFile(filePath, currentHash, otherHash);
-            return currentHash; // Return current version for now
+        // Case 4: File changed in both branches - merge the lines. A file
+        // added on both sides merges against an empty base.
+        if (!currentHash.empty() && !otherHash.empty()) {
+            std::string base = baseHash.empty() ? "" : store.readAsString(ObjectKind::Blob, baseHash);
+            std::string current = store.readAsString(ObjectKind::Blob, currentHash);
+            std::string other = store.readAsString(ObjectKind::Blob, otherHash);
+            if (!gitcpp::isBinary(base) && !gitcpp::isBinary(current) && !gitcpp::isBinary(other)) {
+                MergeResult merged = merge3(base, current, other, "HEAD", filePath);
+                if (merged.conflicts == 0) {
+                    std::cout << "Auto-merging " << filePath << std::endl;
+                    std::string merged_hash = gitcpp::sha1(merged.text);
+                    store.write(ObjectKind::Blob, merged_hash, merged.text);
+                    return merged_hash;
+                }
+                std::cout << "CONFLICT (content): Merge conflict in " << filePath << std::endl;
+                conflictFiles[filePath] = merged.text;
+                return currentHash;
+            }
         }
         
+        // Deleted on one side and changed on the other, or binary
+        std::cout << "CONFLICT (content): Merge conflict in " << filePath << std::endl;
+        conflictFiles[filePath] = conflictFileContents(store, filePath, currentHash, otherHash);
         return currentHash;
     }
     
     // Create merge commit
-    void createMergeCommit(const std::map<std::string, std::string>& files, 
+    void createMergeCommit(const Repository& repo, const ObjectStore& store,
+                          const std::map<std::string, std::string>& files, const std::set<std::string>& written,
                           const std::string& parent1, const std::string& parent2, const std::string& branchName) {
-        Repository repo(false);
-        // Create tree content
-        std::ostringstream tree_content;
-        for (const auto& [path, hash] : files) {
-            tree_content << path << ":" << hash << "\n";
-        }
-        
-        std::string tree_content_str = tree_content.str();
-        std::string tree_hash = gitcpp::sha1(tree_content_str);
-        gitcpp::writeContents(repo.BLOBS / tree_hash, tree_content_str);
+        // Create the tree, sharing unchanged subtrees with the parents
+        std::string tree_hash = writeTree(store, files);
         
         // Create merge commit with two parents
         std::vector<std::string> parents = {parent1, parent2};
         std::string message = "Merge branch '" + branchName + "'";
         
         Commit merge_commit(tree_hash, parents, message);
-        gitcpp::writeContents(repo.COMMITS / merge_commit.getCommitHash(), merge_commit.getCommitContents());
+        store.write(ObjectKind::Commit, merge_commit.getCommitHash(), merge_commit.getCommitContents());
+        CommitGraph::update(repo, store, {merge_commit.getCommitHash()});
+        MessageIndex::update(repo, store, {merge_commit.getCommitHash()});
         
         // Update current branch
         std::string current_branch = gitcpp::readContentsAsString(repo.CURRENT_BRANCH);
         fs::path current_head_path = repo.HEADS / current_branch;
-        gitcpp::writeContents(current_head_path, merge_commit.getCommitHash());
+        gitcpp::writeDurable(current_head_path, false, merge_commit.getCommitHash());
         
-        // Clear staging area
-        gitcpp::writeContents(repo.FILE_MAP, "{}");
-        gitcpp::writeContents(repo.REMOVE_SET, "[]");
+        // The index tracks the merged files; those just written get fresh
+        // stat data
+        updateIndexAfterCheckout(repo, store, files, written);
+        gitcpp::writeDurable(repo.REMOVE_SET, false, "[]");
         
         std::cout << "Merge completed successfully." << std::endl;
     }
     
     // Perform three-way merge
-    void performThreeWayMerge(const std::string& currentCommit, const std::string& otherCommit, 
-                             const std::string& baseCommit, const std::string& branchName) {
-        std::cout << "DEBUG: Performing three-way merge" << std::endl;
-        std::cout << "DEBUG: Current commit: " << currentCommit << std::endl;
-        std::cout << "DEBUG: Other commit: " << otherCommit << std::endl;
-        std::cout << "DEBUG: Base commit: " << baseCommit << std::endl;
-        
+    void performThreeWayMerge(const Repository& repo, const ObjectStore& store,
+                             const std::string& currentCommit, const std::string& otherCommit, 
+                             const std::vector<std::string>& baseCommits, const std::string& branchName) {
         // Get file lists from all three commits
-        auto currentFiles = getFilesFromCommit(currentCommit);
-        auto otherFiles = getFilesFromCommit(otherCommit);
-        auto baseFiles = getFilesFromCommit(baseCommit);
+        auto currentFiles = getFilesFromCommit(store, currentCommit);
+        auto otherFiles = getFilesFromCommit(store, otherCommit);
+        
+        // With several merge bases (criss-cross history) the base is the set
+        // of files all of them agree on; a file the bases disagree about is
+        // treated as new on both sides, so differing versions conflict.
+        std::map<std::string, std::string> baseFiles;
+        if (!baseCommits.empty()) {
+            baseFiles = getFilesFromCommit(store, baseCommits[0]);
+        }
+        for (std::size_t i = 1; i < baseCommits.size(); ++i) {
+            auto otherBase = getFilesFromCommit(store, baseCommits[i]);
+            for (auto it = baseFiles.begin(); it != baseFiles.end();) {
+                auto match = otherBase.find(it->first);
+                if (match == otherBase.end() || match->second != it->second) {
+                    it = baseFiles.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+        }
         
-        std::cout << "DEBUG: Current files count: " << currentFiles.size() << std::endl;
-        std::cout << "DEBUG: Other files count: " << otherFiles.size() << std::endl;
-        std::cout << "DEBUG: Base files count: " << baseFiles.size() << std::endl;
+        // Follow renames from the base: a file renamed on one side and
+        // changed on the other merges under its new name, and the old path
+        // is dropped
+        std::map<std::string, std::array<std::string, 3>> renamedFiles;     // new path -> base, current, other
+        std::set<std::string> renamedAway;
+        RenameOptions renameOpts = renameOptions(repo);
+        renameOpts.copies = false;
+        auto renamesTo = [&](const std::map<std::string, std::string>& side) {
+            std::map<std::string, std::string> deleted, added;
+            for (const auto& [path, hash] : baseFiles) {
+                if (!side.count(path)) deleted.emplace_hint(deleted.end(), path, hash);
+            }
+            for (const auto& [path, hash] : side) {
+                if (!baseFiles.count(path)) added.emplace_hint(added.end(), path, hash);
+            }
+            return detectRenames(store, deleted, added, renameOpts);
+        };
+        for (const Rename& rename : renamesTo(currentFiles)) {
+            auto other = otherFiles.find(rename.oldPath);
+            if (other == otherFiles.end() || otherFiles.count(rename.newPath)) continue;
+            renamedFiles[rename.newPath] = {baseFiles[rename.oldPath], currentFiles[rename.newPath], other->second};
+            renamedAway.insert(rename.oldPath);
+        }
+        for (const Rename& rename : renamesTo(otherFiles)) {
+            auto current = currentFiles.find(rename.oldPath);
+            if (current == currentFiles.end() || currentFiles.count(rename.newPath)) continue;
+            renamedFiles[rename.newPath] = {baseFiles[rename.oldPath], current->second, otherFiles[rename.newPath]};
+            renamedAway.insert(rename.oldPath);
+        }
         
         // Collect all unique file paths
         std::set<std::string> allFiles;
@@ -1277,39 +1338,184 @@ namespace gitcpp::commands {
         for (const auto& [path, hash] : otherFiles) allFiles.insert(path);
         for (const auto& [path, hash] : baseFiles) allFiles.insert(path);
         
-        bool hasConflicts = false;
+        std::map<std::string, std::string> conflictFiles;
         std::map<std::string, std::string> mergedFiles;
         
         for (const std::string& filePath : allFiles) {
             std::string currentHash = currentFiles.count(filePath) ? currentFiles[filePath] : "";
             std::string otherHash = otherFiles.count(filePath) ? otherFiles[filePath] : "";
             std::string baseHash = baseFiles.count(filePath) ? baseFiles[filePath] : "";
-            
-            std::cout << "DEBUG: File: " << filePath << std::endl;
-            std::cout << "DEBUG:   Current hash: " << currentHash << std::endl;
-            std::cout << "DEBUG:   Other hash: " << otherHash << std::endl;
-            std::cout << "DEBUG:   Base hash: " << baseHash << std::endl;
+            if (renamedAway.count(filePath)) continue;
+            auto renamed = renamedFiles.find(filePath);
+            if (renamed != renamedFiles.end()) {
+                baseHash = renamed->second[0];
+                currentHash = renamed->second[1];
+                otherHash = renamed->second[2];
+            }
             
             // Determine merge result for this file
-            std::string resultHash = mergeFile(filePath, currentHash, otherHash, baseHash, hasConflicts);
+            std::string resultHash = mergeFile(store, filePath, currentHash, otherHash, baseHash, conflictFiles);
             if (!resultHash.empty()) {
                 mergedFiles[filePath] = resultHash;
             }
         }
         
-        if (hasConflicts) {
+        // Every file was merged in memory; only now is the working tree touched
+        if (!conflictFiles.empty()) {
+            for (const auto& [filePath, contents] : conflictFiles) {
+                fs::path parent_dir = fs::path(filePath).parent_path();
+                if (!parent_dir.empty()) {
+                    fs::create_directories(parent_dir);
+                }
+                gitcpp::writeContents(filePath, contents);
+            }
             gitcpp::message("Automatic merge failed; fix conflicts and then commit the result.");
             return;
         }
         
+        // Bring the working tree to the merged result
+        std::vector<std::pair<std::string, std::string>> changed;
+        for (const std::string& filePath : allFiles) {
+            auto current = currentFiles.find(filePath);
+            auto merged = mergedFiles.find(filePath);
+            if (merged == mergedFiles.end()) {
+                if (current != currentFiles.end()) removeWorkingFile(filePath);
+            } else if (current == currentFiles.end() || current->second != merged->second) {
+                changed.emplace_back(filePath, merged->second);
+            }
+        }
+        checkoutFiles(repo, store, changed);
+        std::set<std::string> written;
+        for (const auto& change : changed) {
+            written.insert(change.first);
+        }
+        
         // Create merge commit
-        createMergeCommit(mergedFiles, currentCommit, otherCommit, branchName);
+        createMergeCommit(repo, store, mergedFiles, written, currentCommit, otherCommit, branchName);
+    }
+    
+    void repack(bool all) {
+        Repository repo = Repository::open();
+        ObjectStore store(repo);
+        PackStats stats = store.repack(all);
+        if (stats.objects == 0) {
+            gitcpp::message("Nothing to pack.");
+            return;
+        }
+        std::cout << "Packed " << stats.objects << " objects (" << stats.deltas << " deltas) into "
+                  << stats.name << ": " << stats.inputBytes << " -> " << stats.packBytes << " bytes." << std::endl;
+    }
+    
+    // Unreachable objects younger than this are kept by gc: they may belong
+    // to a command still running (an add, a commit being written)
+    static constexpr long long DEFAULT_PRUNE_EXPIRE = 14 * 24 * 60 * 60;
+    
+    // Enough of an object to hold a tree header or a flat tree's first line
+    static constexpr std::size_t TREE_PREFIX = 4096 + 64;
+    
+    void gc(const std::string& expire) {
+        Repository repo = Repository::open();
+        ObjectStore store(repo);
+        std::string setting = expire.empty() ? repo.getConfig("gc.pruneExpire") : expire;
+        long long grace = DEFAULT_PRUNE_EXPIRE;
+        if (setting == "now") {
+            grace = 0;
+        } else if (!setting.empty()) {
+            if (setting.find_first_not_of("0123456789") != std::string::npos || setting.size() > 12) {
+                gitcpp::message("Invalid prune expiry: " + setting);
+                return;
+            }
+            grace = std::stoll(setting);
+        }
+        
+        // Everything reachable from a branch head or staged in the index
+        std::vector<std::string> tips;
+        for (const std::string& branch : gitcpp::plainFilenamesIn(repo.HEADS)) {
+            tips.push_back(gitcpp::readContentsAsString(repo.HEADS / branch));
+        }
+        std::vector<std::string> staged;
+        for (const IndexEntry& entry : openIndex(repo, store).entries()) {
+            staged.push_back(entry.id);
+        }
+        
+        CommitGraph graph(repo);
+        BitmapIndex bitmaps(repo);
+        ThreadPool& pool = ThreadPool::shared(repo);
+        Reachable reachable = markReachable(graph, store, pool, tips, {}, staged, bitmaps.empty() ? nullptr : &bitmaps);
+        
+        // Objects inside the grace period are kept, so whatever they refer
+        // to must be kept too: recent commits and trees (of either format)
+        // are marked from like the heads. Only the start of each recent
+        // object is read to tell trees from blobs.
+        auto cutoff = fs::file_time_type::clock::now() - std::chrono::seconds(grace);
+        std::vector<std::string> recent_commits = store.recent(ObjectKind::Commit, cutoff);
+        std::vector<std::string> recent_objects = store.recent(ObjectKind::Blob, cutoff);
+        std::vector<char> is_tree(recent_objects.size(), 0);
+        pool.parallelFor(recent_objects.size(), [&](std::size_t i) {
+            if (reachable.objects.count(recent_objects[i])) return;
+            auto prefix = store.readPrefix(ObjectKind::Blob, recent_objects[i], TREE_PREFIX);
+            is_tree[i] = isTreePrefix(std::string_view(reinterpret_cast<const char*>(prefix.data()), prefix.size()));
+        });
+        std::vector<std::string> recent_trees;
+        for (std::size_t i = 0; i < recent_objects.size(); ++i) {
+            if (is_tree[i]) recent_trees.push_back(std::move(recent_objects[i]));
+        }
+        Reachable referenced = markReachable(graph, store, pool, recent_commits, recent_trees, {},
+                                             bitmaps.empty() ? nullptr : &bitmaps, &reachable);
+        
+        std::atomic<std::size_t> kept{0};
+        auto marked = [](const Reachable& set, ObjectKind kind, const std::string& id) {
+            return (kind == ObjectKind::Commit ? set.commits : set.objects).count(id) > 0;
+        };
+        PruneStats stats = store.prune([&](ObjectKind kind, const std::string& id) {
+            if (marked(reachable, kind, id)) return true;
+            if (!marked(referenced, kind, id)) return false;
+            ++kept;
+            return true;
+        }, cutoff);
+        
+        // The commit-graph, the bitmaps and the message index may list
+        // pruned objects
+        if (stats.pruned > 0 && graph.size() > 0) {
+            CommitGraph::write(repo, store);
+        }
+        if (stats.pruned > 0 && !bitmaps.empty()) {
+            BitmapIndex::write(repo, store);
+        }
+        if (stats.pruned > 0 && MessageIndex(repo).exists()) {
+            MessageIndex::write(repo, store);
+        }
+        
+        std::cout << "Reachable: " << reachable.commits.size() << " commits, " << reachable.objects.size()
+                  << " trees and blobs." << std::endl;
+        std::cout << "Pruned " << stats.pruned << " unreachable objects, reclaimed " << stats.bytes << " bytes."
+                  << std::endl;
+        if (stats.recent + kept > 0) {
+            std::cout << "Kept " << stats.recent + kept
+                      << " unreachable objects newer than the grace period or used by one." << std::endl;
+        }
+    }
+    
+    void bitmapWrite() {
+        Repository repo = Repository::open();
+        ObjectStore store(repo);
+        std::size_t bitmaps = BitmapIndex::write(repo, store);
+        BitmapIndex index(repo);
+        std::cout << "Wrote " << bitmaps << " reachability bitmaps over " << index.commitCount() << " commits and "
+                  << index.objectCount() << " trees and blobs." << std::endl;
+    }
+    
+    void commitGraphWrite() {
+        Repository repo = Repository::open();
+        ObjectStore store(repo);
+        std::size_t commits = CommitGraph::write(repo, store);
+        std::cout << "Wrote commit-graph with " << commits << " commits." << std::endl;
     }
     
     void config(const std::string& key, const std::string& value) {
-        Repository repo(false);
+        Repository repo = Repository::open();
         // Create config directory if it doesn't exist
-        fs::path config_dir = repo.GITCPP_DIR / "config";
+        fs::path config_dir = repo.CONFIG;
         if (!fs::exists(config_dir)) {
             fs::create_directories(config_dir);
         }
@@ -1319,6 +1525,22 @@ namespace gitcpp::commands {
         gitcpp::writeContents(config_file, value);
     }
     
+    bool parseGlobalOptions(std::vector<std::string>& args) {
+        // Everything from the command name on belongs to the command, so
+        // messages and paths that start with "-j" are left alone
+        std::size_t i = 0;
+        while (i < args.size() && args[i].rfind("-j", 0) == 0) {
+            std::string value = args[i].size() > 2 ? args[i].substr(2) : (i + 1 < args.size() ? args[++i] : "");
+            if (value.empty() || value.size() > 4 || value.find_first_not_of("0123456789") != std::string::npos) {
+                return false;
+            }
+            ThreadPool::setRequestedThreads(static_cast<unsigned>(std::stoul(value)));
+            ++i;
+        }
+        args.erase(args.begin(), args.begin() + static_cast<std::ptrdiff_t>(i));
+        return true;
+    }
+
     std::vector<std::string> loadGitignorePatterns() {
         std::vector<std::string> patterns;
         fs::path gitignore_path = ".gitcppignore";
@@ -1339,9 +1561,7 @@ namespace gitcpp::commands {
         return patterns;
     }
     
-    bool isIgnored(const std::string& filePath) {
-        static std::vector<std::string> patterns = loadGitignorePatterns();
-        
+    bool isIgnored(const std::vector<std::string>& patterns, const std::string& filePath) {
         for (const auto& pattern : patterns) {
             // Handle wildcard patterns
             if (pattern.find('*') != std::string::npos) {
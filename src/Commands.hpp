@@ -9,12 +9,14 @@ namespace gitcpp::commands {
 
 
     void add(const std::string& fileToAdd);
+    void add(const std::vector<std::string>& pathsToAdd);   // files and directories ("." adds everything)
     void commit(const std::string& message);
     void remove(const std::string& fileToRemove);
     void log();
     void globalLog();
-    void find(const std::string& message);
+    void find(const std::string& query, const std::string& mode = "");     // [--contains | --word]
     void status();
+    void diff(const std::vector<std::string>& args);             // [--staged | <commit> <commit>]
     void restore(const std::vector<std::string>& argv);         // mirrors restore(args)
     void branch(const std::string& name);
     void switchBranch(const std::string& name, const std::string& mode);
@@ -22,10 +24,19 @@ namespace gitcpp::commands {
     void reset(const std::string& commitId);                     // switchBranch(commitId, "commit")
     void merge(const std::string& otherBranch);
     void config(const std::string& key, const std::string& value);
+    void repack(bool all);                                       // fold loose objects into a pack
+    void commitGraphWrite();                                     // rebuild the commit-graph
+    void bitmapWrite();                                          // rebuild the reachability bitmaps
+    void gc(const std::string& expire);                          // prune unreachable objects ("" = config)
 
 
+    // Command-line handling: apply the "-j N" / "-jN" options that come
+    // before the command name and remove them from `args`. Returns false
+    // for an invalid thread count.
+    bool parseGlobalOptions(std::vector<std::string>& args);
+
     // Helper functions for .gitignore support
-    bool isIgnored(const std::string& filePath);
+    bool isIgnored(const std::vector<std::string>& patterns, const std::string& filePath);
     std::vector<std::string> loadGitignorePatterns();
 
     bool isStageEmpty();
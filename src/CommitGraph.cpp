@@ -0,0 +1,298 @@
+#include "CommitGraph.hpp"
+#include "LayerChain.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <set>
+#include <unordered_map>
+
+namespace fs = std::filesystem;
+
+namespace gitcpp {
+
+    namespace {
+
+        constexpr unsigned char GRAPH_MAGIC[4] = {'G', 'C', 'C', 'G'};
+        constexpr std::uint32_t GRAPH_VERSION = 1;
+        constexpr std::size_t HEADER = 12;
+        constexpr std::size_t RAW_ID = 20;
+        constexpr std::size_t FANOUT = 256 * 4;
+
+        // Record: raw tree id, first parent, second parent, generation,
+        // commit time.
+        constexpr std::size_t RECORD = RAW_ID + 4 + 4 + 4 + 8;
+
+        // Parent slots hold a position, NO_PARENT, or (second slot only)
+        // EXTRA_EDGES | index into the edge list, whose last entry for a
+        // commit also carries EXTRA_EDGES.
+        constexpr std::uint32_t NO_PARENT = 0x70000000;
+        constexpr std::uint32_t EXTRA_EDGES = 0x80000000;
+
+        LayerChain chainOf(const Repository& repo) {
+            return LayerChain(repo.COMMIT_GRAPHS, "graph-", ".graph");
+        }
+
+    } // namespace
+
+    struct CommitGraph::Node {
+        std::string id;
+        std::string tree;
+        std::vector<std::string> parents;
+        std::int64_t timestamp = 0;
+        std::uint32_t generation = 0;
+    };
+
+    CommitGraph::CommitGraph(const Repository& repo) {
+        LayerChain chain = chainOf(repo);
+        std::vector<std::string> names;
+        if (!chain.read(names)) return;
+
+        for (const std::string& name : names) {
+            fs::path file = chain.file(name);
+            Layer layer;
+            layer.name = name;
+            layer.map = MappedFile(file);
+            const unsigned char* data = layer.map.data();
+            std::size_t size = layer.map.size();
+            if (size < HEADER + FANOUT + 4 + RAW_ID || std::memcmp(data, GRAPH_MAGIC, 4) != 0 ||
+                getBE32(data + 4) != GRAPH_VERSION || !trailerMatches(data, size)) {
+                throw error("Corrupt commit-graph: " + file.string());
+            }
+            layer.count = getBE32(data + 8);
+            layer.offset = count_;
+            layer.fanout = data + HEADER;
+            layer.ids = layer.fanout + FANOUT;
+            layer.records = layer.ids + std::size_t(layer.count) * RAW_ID;
+            const unsigned char* edgeHeader = layer.records + std::size_t(layer.count) * RECORD;
+            if (edgeHeader + 4 + RAW_ID > data + size) {
+                throw error("Corrupt commit-graph: " + file.string());
+            }
+            layer.edgeCount = getBE32(edgeHeader);
+            layer.edges = edgeHeader + 4;
+            if (layer.edges + std::size_t(layer.edgeCount) * 4 + RAW_ID != data + size ||
+                getBE32(layer.fanout + 255 * 4) != layer.count) {
+                throw error("Corrupt commit-graph: " + file.string());
+            }
+            count_ += layer.count;
+            layers_.push_back(std::move(layer));
+        }
+    }
+
+    std::uint32_t CommitGraph::find(const std::string& id) const {
+        if (layers_.empty() || !isObjectId(id)) return NOT_FOUND;
+        unsigned char raw[RAW_ID];
+        fromHex(id, raw);
+        for (const Layer& layer : layers_) {
+            std::uint32_t lo = raw[0] == 0 ? 0 : getBE32(layer.fanout + (raw[0] - 1) * 4);
+            std::uint32_t hi = getBE32(layer.fanout + raw[0] * 4);
+            while (lo < hi) {
+                std::uint32_t mid = lo + (hi - lo) / 2;
+                int cmp = std::memcmp(layer.ids + std::size_t(mid) * RAW_ID, raw, RAW_ID);
+                if (cmp == 0) return layer.offset + mid;
+                if (cmp < 0) lo = mid + 1; else hi = mid;
+            }
+        }
+        return NOT_FOUND;
+    }
+
+    const CommitGraph::Layer& CommitGraph::layerOf(std::uint32_t pos) const {
+        for (auto it = layers_.rbegin(); it != layers_.rend(); ++it) {
+            if (pos >= it->offset) {
+                if (pos - it->offset >= it->count) break;
+                return *it;
+            }
+        }
+        throw error("Commit-graph position out of range");
+    }
+
+    const unsigned char* CommitGraph::record(std::uint32_t pos) const {
+        const Layer& layer = layerOf(pos);
+        return layer.records + std::size_t(pos - layer.offset) * RECORD;
+    }
+
+    std::string CommitGraph::id(std::uint32_t pos) const {
+        const Layer& layer = layerOf(pos);
+        return toHex(layer.ids + std::size_t(pos - layer.offset) * RAW_ID, RAW_ID);
+    }
+
+    std::string CommitGraph::tree(std::uint32_t pos) const {
+        return toHex(record(pos), RAW_ID);
+    }
+
+    std::vector<std::uint32_t> CommitGraph::parents(std::uint32_t pos) const {
+        const Layer& layer = layerOf(pos);
+        const unsigned char* r = layer.records + std::size_t(pos - layer.offset) * RECORD;
+        std::vector<std::uint32_t> result;
+        std::uint32_t first = getBE32(r + RAW_ID);
+        std::uint32_t second = getBE32(r + RAW_ID + 4);
+        if (first == NO_PARENT) return result;
+        result.push_back(first);
+        if (second & EXTRA_EDGES) {
+            for (std::uint32_t i = second & ~EXTRA_EDGES; i < layer.edgeCount; ++i) {
+                std::uint32_t edge = getBE32(layer.edges + std::size_t(i) * 4);
+                result.push_back(edge & ~EXTRA_EDGES);
+                if (edge & EXTRA_EDGES) break;
+            }
+        } else if (second != NO_PARENT) {
+            result.push_back(second);
+        }
+        return result;
+    }
+
+    std::uint32_t CommitGraph::generation(std::uint32_t pos) const {
+        return getBE32(record(pos) + RAW_ID + 8);
+    }
+
+    std::int64_t CommitGraph::timestamp(std::uint32_t pos) const {
+        return static_cast<std::int64_t>(getBE64(record(pos) + RAW_ID + 12));
+    }
+
+    std::size_t CommitGraph::write(const Repository& repo, const ObjectStore& store) {
+        std::vector<Node> nodes;
+        for (const std::string& id : store.list(ObjectKind::Commit)) {
+            if (auto commit = store.commit(id)) {
+                nodes.push_back(Node{id, commit->tree, commit->parents, commit->timestamp});
+            }
+        }
+        CommitGraph empty;
+        writeChain(repo, empty, nodes);
+        return nodes.size();
+    }
+
+    void CommitGraph::update(const Repository& repo, const ObjectStore& store, const std::vector<std::string>& commits) {
+        CommitGraph graph(repo);
+
+        // New commits and their ancestors that are not in the graph yet
+        std::vector<Node> nodes;
+        std::set<std::string> seen;
+        std::vector<std::string> pending(commits);
+        while (!pending.empty()) {
+            std::string id = pending.back();
+            pending.pop_back();
+            if (!seen.insert(id).second || graph.find(id) != NOT_FOUND || !store.contains(ObjectKind::Commit, id)) {
+                continue;
+            }
+            auto commit = store.commit(id);
+            if (!commit) continue;
+            pending.insert(pending.end(), commit->parents.begin(), commit->parents.end());
+            nodes.push_back(Node{id, commit->tree, commit->parents, commit->timestamp});
+        }
+        if (nodes.empty()) return;
+
+        // Fold the top layers into the new one while they are not much bigger
+        std::vector<std::size_t> sizes;
+        for (const Layer& layer : graph.layers_) sizes.push_back(layer.count);
+        for (std::size_t folded = LayerChain::foldCount(sizes, nodes.size()); folded > 0; --folded) {
+            const Layer& top = graph.layers_.back();
+            for (std::uint32_t pos = top.offset; pos < top.offset + top.count; ++pos) {
+                Node node;
+                node.id = graph.id(pos);
+                node.tree = graph.tree(pos);
+                node.timestamp = graph.timestamp(pos);
+                for (std::uint32_t parent : graph.parents(pos)) node.parents.push_back(graph.id(parent));
+                nodes.push_back(std::move(node));
+            }
+            graph.count_ -= top.count;
+            graph.layers_.pop_back();
+        }
+        writeChain(repo, graph, nodes);
+    }
+
+    // Write `commits` as a new layer on top of `base` and make the chain
+    // point at base's layers plus the new one.
+    void CommitGraph::writeChain(const Repository& repo, CommitGraph& base, std::vector<Node>& commits) {
+        std::sort(commits.begin(), commits.end(), [](const Node& a, const Node& b) { return a.id < b.id; });
+        commits.erase(std::unique(commits.begin(), commits.end(),
+                                  [](const Node& a, const Node& b) { return a.id == b.id; }),
+                      commits.end());
+
+        std::unordered_map<std::string, std::uint32_t> local;
+        for (std::uint32_t i = 0; i < commits.size(); ++i) local.emplace(commits[i].id, i);
+
+        // Parent positions; parents the graph cannot reach are dropped
+        std::vector<std::vector<std::uint32_t>> parents(commits.size());
+        for (std::size_t i = 0; i < commits.size(); ++i) {
+            for (const std::string& parent : commits[i].parents) {
+                auto it = local.find(parent);
+                std::uint32_t pos = it != local.end() ? base.count_ + it->second : base.find(parent);
+                if (pos != NOT_FOUND) parents[i].push_back(pos);
+            }
+        }
+
+        // Generations, parents first, without recursion (histories are deep)
+        std::vector<std::uint32_t> stack;
+        for (std::uint32_t start = 0; start < commits.size(); ++start) {
+            if (commits[start].generation) continue;
+            stack.push_back(start);
+            while (!stack.empty()) {
+                std::uint32_t i = stack.back();
+                std::uint32_t generation = 1;
+                bool ready = true;
+                for (std::uint32_t pos : parents[i]) {
+                    if (pos < base.count_) {
+                        generation = std::max(generation, base.generation(pos) + 1);
+                        continue;
+                    }
+                    const Node& parent = commits[pos - base.count_];
+                    if (parent.generation == 0) {
+                        stack.push_back(pos - base.count_);
+                        ready = false;
+                    }
+                    generation = std::max(generation, parent.generation + 1);
+                }
+                if (ready) {
+                    commits[i].generation = generation;
+                    stack.pop_back();
+                }
+            }
+        }
+
+        std::vector<unsigned char> out(GRAPH_MAGIC, GRAPH_MAGIC + 4);
+        putBE32(out, GRAPH_VERSION);
+        putBE32(out, static_cast<std::uint32_t>(commits.size()));
+        std::uint32_t fanout[256] = {};
+        for (const Node& node : commits) {
+            unsigned char raw[RAW_ID];
+            fromHex(node.id, raw);
+            ++fanout[raw[0]];
+        }
+        std::uint32_t running = 0;
+        for (std::uint32_t bucket : fanout) {
+            running += bucket;
+            putBE32(out, running);
+        }
+        for (const Node& node : commits) {
+            unsigned char raw[RAW_ID];
+            fromHex(node.id, raw);
+            out.insert(out.end(), raw, raw + RAW_ID);
+        }
+        std::vector<std::uint32_t> edges;
+        for (std::size_t i = 0; i < commits.size(); ++i) {
+            unsigned char raw[RAW_ID];
+            fromHex(commits[i].tree, raw);
+            out.insert(out.end(), raw, raw + RAW_ID);
+            const std::vector<std::uint32_t>& p = parents[i];
+            putBE32(out, p.empty() ? NO_PARENT : p[0]);
+            if (p.size() <= 2) {
+                putBE32(out, p.size() == 2 ? p[1] : NO_PARENT);
+            } else {
+                putBE32(out, EXTRA_EDGES | static_cast<std::uint32_t>(edges.size()));
+                for (std::size_t k = 1; k < p.size(); ++k) {
+                    edges.push_back(p[k] | (k + 1 == p.size() ? EXTRA_EDGES : 0));
+                }
+            }
+            putBE32(out, commits[i].generation);
+            putBE64(out, static_cast<std::uint64_t>(commits[i].timestamp));
+        }
+        putBE32(out, static_cast<std::uint32_t>(edges.size()));
+        for (std::uint32_t edge : edges) putBE32(out, edge);
+        putTrailer(out);
+
+        LayerChain chain = chainOf(repo);
+        std::vector<std::string> names;
+        for (const Layer& layer : base.layers_) names.push_back(layer.name);
+        names.push_back(chain.writeLayer(out));
+        chain.writeChain(names);
+    }
+
+} // namespace gitcpp
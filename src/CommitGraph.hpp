@@ -0,0 +1,82 @@
+#pragma once
+#include "ObjectStore.hpp"
+#include "Repository.hpp"
+#include "Utils.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace gitcpp {
+
+    /// Commit-graph (`commit-graphs/`): parents, tree, commit time and
+    /// generation number of every commit, so history walks do not have to
+    /// open and parse commit objects.
+    ///
+    /// The graph is a chain of layer files listed base first in
+    /// `commit-graphs/chain`. Each layer is "GCCG", version, commit count,
+    /// a 256-entry fan-out, the sorted raw commit ids, one fixed-size
+    /// record per commit (raw tree id, two parent positions, generation,
+    /// commit time), an edge list for commits with more than two parents
+    /// and a SHA-1 trailer. Positions are global: a layer's commits follow
+    /// those of the layers below it, and parents always live in the same
+    /// or a lower layer.
+    ///
+    /// Generation numbers are 1 for root commits and one more than the
+    /// largest parent generation otherwise, so a commit can never be an
+    /// ancestor of a commit with a lower generation.
+    class CommitGraph {
+    public:
+        static constexpr std::uint32_t NOT_FOUND = 0xffffffff;
+
+        /// Load the graph of `repo`; empty if it has none. Throws if a
+        /// layer does not match its trailer.
+        explicit CommitGraph(const Repository& repo);
+
+        std::uint32_t size() const { return count_; }
+        std::size_t layerCount() const { return layers_.size(); }
+
+        /// Position of a commit, or NOT_FOUND.
+        std::uint32_t find(const std::string& id) const;
+
+        std::string id(std::uint32_t pos) const;
+        std::string tree(std::uint32_t pos) const;
+        std::vector<std::uint32_t> parents(std::uint32_t pos) const;
+        std::uint32_t generation(std::uint32_t pos) const;
+        std::int64_t timestamp(std::uint32_t pos) const;
+
+        /// Rewrite the graph as a single layer holding every commit in
+        /// `store`. Returns the number of commits written.
+        static std::size_t write(const Repository& repo, const ObjectStore& store);
+
+        /// Add `commits`, and any ancestors the graph does not know yet, as
+        /// a new layer. Small layers at the top of the chain are merged
+        /// into it so the chain stays logarithmic in the number of commits.
+        static void update(const Repository& repo, const ObjectStore& store, const std::vector<std::string>& commits);
+
+    private:
+        struct Layer {
+            std::string name;
+            MappedFile map;
+            std::uint32_t offset = 0;     // global position of the first commit
+            std::uint32_t count = 0;
+            const unsigned char* fanout = nullptr;
+            const unsigned char* ids = nullptr;
+            const unsigned char* records = nullptr;
+            const unsigned char* edges = nullptr;
+            std::uint32_t edgeCount = 0;
+        };
+
+        CommitGraph() = default;
+
+        struct Node;
+        static void writeChain(const Repository& repo, CommitGraph& base, std::vector<Node>& commits);
+
+        const Layer& layerOf(std::uint32_t pos) const;
+        const unsigned char* record(std::uint32_t pos) const;
+
+        std::vector<Layer> layers_;
+        std::uint32_t count_ = 0;
+    };
+
+} // namespace gitcpp
@@ -0,0 +1,472 @@
+#include "Diff.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <unordered_map>
+
+namespace gitcpp {
+
+    namespace {
+
+        // Lines that occur more often than this in a range are not used as
+        // histogram anchors; a range without anchors goes to Myers
+        constexpr std::size_t MAX_CHAIN = 64;
+
+        // Myers searches at least this many edits deep before it settles
+        // for the furthest point reached (see bisect())
+        constexpr long MIN_COST_LIMIT = 256;
+
+        // Bytes inspected by isBinary()
+        constexpr std::size_t BINARY_PROBE = 8000;
+
+        // Half-open line ranges [aLo, aHi) of the old and [bLo, bHi) of the
+        // new side
+        struct Range {
+            std::size_t aLo, aHi, bLo, bHi;
+            bool myers;                     // no anchor was found; bisect instead
+        };
+
+        // Marks the lines each side drops (old) or adds (new). Both sides
+        // are sequences of line numbers, equal numbers meaning equal lines.
+        // Ranges are processed from an explicit stack, so deeply nested
+        // splits cannot overflow the call stack.
+        class LineMatcher {
+        public:
+            LineMatcher(const std::vector<std::uint32_t>& a, const std::vector<std::uint32_t>& b,
+                        std::size_t distinctLines)
+                : removed(a.size(), 0), added(b.size(), 0), a_(a), b_(b),
+                  count_(distinctLines, 0), first_(distinctLines, 0), next_(a.size(), 0) {
+                long diagonals = static_cast<long>(a.size() + b.size()) + 3;
+                long root = 1;
+                while (root * root < diagonals) ++root;
+                costLimit_ = std::max(MIN_COST_LIMIT, root);
+            }
+
+            void run() {
+                pending_.push_back(Range{0, a_.size(), 0, b_.size(), false});
+                while (!pending_.empty()) {
+                    Range r = pending_.back();
+                    pending_.pop_back();
+                    process(r);
+                }
+            }
+
+            std::vector<char> removed;
+            std::vector<char> added;
+
+        private:
+            void process(Range r) {
+                while (r.aLo < r.aHi && r.bLo < r.bHi && a_[r.aLo] == b_[r.bLo]) {
+                    ++r.aLo;
+                    ++r.bLo;
+                }
+                while (r.aLo < r.aHi && r.bLo < r.bHi && a_[r.aHi - 1] == b_[r.bHi - 1]) {
+                    --r.aHi;
+                    --r.bHi;
+                }
+                if (r.aLo == r.aHi || r.bLo == r.bHi) {
+                    markAll(r);
+                } else if (r.myers) {
+                    bisect(r);
+                } else {
+                    histogram(r);
+                }
+            }
+
+            void markAll(const Range& r) {
+                std::fill(removed.begin() + r.aLo, removed.begin() + r.aHi, 1);
+                std::fill(added.begin() + r.bLo, added.begin() + r.bHi, 1);
+            }
+
+            // Split around the longest run of common lines seeded by the
+            // rarest line (fewest occurrences on the old side)
+            void histogram(const Range& r) {
+                // Occurrences of each line in the old range, chained in
+                // order through next_
+                for (std::size_t i = r.aHi; i-- > r.aLo;) {
+                    std::uint32_t line = a_[i];
+                    next_[i] = first_[line];
+                    first_[line] = i;
+                    ++count_[line];
+                }
+
+                std::size_t bestRarity = MAX_CHAIN;
+                std::size_t bestLength = 0;
+                std::size_t bestA = 0, bestB = 0;
+                for (std::size_t j = r.bLo; j < r.bHi;) {
+                    std::size_t next = j + 1;
+                    std::size_t occurrences = count_[b_[j]];
+                    if (occurrences > 0 && occurrences <= bestRarity) {
+                        std::size_t i = first_[b_[j]];
+                        for (std::size_t n = 0; n < occurrences; ++n, i = next_[i]) {
+                            std::size_t rarity = occurrences;
+                            std::size_t before = 0;
+                            while (i - before > r.aLo && j - before > r.bLo &&
+                                   a_[i - before - 1] == b_[j - before - 1]) {
+                                ++before;
+                                rarity = std::min(rarity, count_[a_[i - before]]);
+                            }
+                            std::size_t after = 1;
+                            while (i + after < r.aHi && j + after < r.bHi && a_[i + after] == b_[j + after]) {
+                                rarity = std::min(rarity, count_[a_[i + after]]);
+                                ++after;
+                            }
+                            // Lines inside this run need not be tried as seeds again
+                            next = std::max(next, j + after);
+                            std::size_t length = before + after;
+                            if (rarity < bestRarity || (rarity == bestRarity && length > bestLength)) {
+                                bestRarity = rarity;
+                                bestLength = length;
+                                bestA = i - before;
+                                bestB = j - before;
+                            }
+                        }
+                    }
+                    j = next;
+                }
+                for (std::size_t i = r.aLo; i < r.aHi; ++i) {
+                    count_[a_[i]] = 0;
+                }
+
+                if (bestLength == 0) {
+                    pending_.push_back(Range{r.aLo, r.aHi, r.bLo, r.bHi, true});
+                    return;
+                }
+                pending_.push_back(Range{r.aLo, bestA, r.bLo, bestB, false});
+                pending_.push_back(Range{bestA + bestLength, r.aHi, bestB + bestLength, r.bHi, false});
+            }
+
+            // Myers' algorithm run from both ends at once; the point where
+            // the two searches meet lies on an optimal path, and the halves
+            // on either side of it are diffed independently. Very different
+            // ranges would cost O(ND); past the cost limit the range is
+            // split at the furthest point the forward search reached, which
+            // keeps the result valid but no longer minimal.
+            void bisect(const Range& r) {
+                const std::uint32_t* x = a_.data() + r.aLo;
+                const std::uint32_t* y = b_.data() + r.bLo;
+                long n = static_cast<long>(r.aHi - r.aLo);
+                long m = static_cast<long>(r.bHi - r.bLo);
+                long maxD = (n + m + 1) / 2;
+                long offset = maxD;
+                long length = 2 * maxD + 2;
+                std::vector<long> forward(length, -1);
+                std::vector<long> backward(length, -1);
+                forward[offset + 1] = 0;
+                backward[offset + 1] = 0;
+                long delta = n - m;
+                bool odd = delta % 2 != 0;
+
+                // Diagonals that ran off the edit graph are not extended again
+                long fStart = 0, fEnd = 0, bStart = 0, bEnd = 0;
+                for (long d = 0; d < maxD; ++d) {
+                    for (long k = -d + fStart; k <= d - fEnd; k += 2) {
+                        long ko = offset + k;
+                        long x1 = (k == -d || (k != d && forward[ko - 1] < forward[ko + 1])) ? forward[ko + 1]
+                                                                                             : forward[ko - 1] + 1;
+                        long y1 = x1 - k;
+                        while (x1 < n && y1 < m && x[x1] == y[y1]) {
+                            ++x1;
+                            ++y1;
+                        }
+                        forward[ko] = x1;
+                        if (x1 > n) {
+                            fEnd += 2;
+                        } else if (y1 > m) {
+                            fStart += 2;
+                        } else if (odd) {
+                            long other = offset + delta - k;
+                            if (other >= 0 && other < length && backward[other] != -1 &&
+                                x1 >= n - backward[other]) {
+                                split(r, x1, y1);
+                                return;
+                            }
+                        }
+                    }
+
+                    for (long k = -d + bStart; k <= d - bEnd; k += 2) {
+                        long ko = offset + k;
+                        long x2 = (k == -d || (k != d && backward[ko - 1] < backward[ko + 1])) ? backward[ko + 1]
+                                                                                               : backward[ko - 1] + 1;
+                        long y2 = x2 - k;
+                        while (x2 < n && y2 < m && x[n - x2 - 1] == y[m - y2 - 1]) {
+                            ++x2;
+                            ++y2;
+                        }
+                        backward[ko] = x2;
+                        if (x2 > n) {
+                            bEnd += 2;
+                        } else if (y2 > m) {
+                            bStart += 2;
+                        } else if (!odd) {
+                            long other = offset + delta - k;
+                            if (other >= 0 && other < length && forward[other] != -1) {
+                                long x1 = forward[other];
+                                long y1 = x1 - (other - offset);
+                                if (x1 >= n - x2) {
+                                    split(r, x1, y1);
+                                    return;
+                                }
+                            }
+                        }
+                    }
+
+                    if (d >= costLimit_) {
+                        long bestX = -1, bestY = -1;
+                        for (long k = -d + fStart; k <= d - fEnd; k += 2) {
+                            long x1 = forward[offset + k];
+                            long y1 = x1 - k;
+                            if (x1 <= n && y1 >= 0 && y1 <= m && x1 + y1 > bestX + bestY) {
+                                bestX = x1;
+                                bestY = y1;
+                            }
+                        }
+                        if (bestX >= 0) {
+                            split(r, bestX, bestY);
+                            return;
+                        }
+                    }
+                }
+                markAll(r);
+            }
+
+            void split(const Range& r, long x, long y) {
+                std::size_t a = r.aLo + static_cast<std::size_t>(x);
+                std::size_t b = r.bLo + static_cast<std::size_t>(y);
+                if ((a == r.aLo && b == r.bLo) || (a == r.aHi && b == r.bHi)) {
+                    markAll(r);         // no progress; cannot happen on trimmed ranges
+                    return;
+                }
+                pending_.push_back(Range{r.aLo, a, r.bLo, b, true});
+                pending_.push_back(Range{a, r.aHi, b, r.bHi, true});
+            }
+
+            const std::vector<std::uint32_t>& a_;
+            const std::vector<std::uint32_t>& b_;
+            std::vector<Range> pending_;
+            long costLimit_;
+
+            // Per distinct line: occurrences in the range being anchored
+            // (zero outside histogram()) and the first of them
+            std::vector<std::size_t> count_;
+            std::vector<std::size_t> first_;
+            std::vector<std::size_t> next_;     // per old line: next occurrence
+
+        };
+
+        // 1-based "start,count" of a hunk side; an empty side names the
+        // line before it and a single line omits the count
+        std::string hunkRange(std::size_t from, std::size_t count) {
+            std::string range = std::to_string(count == 0 ? from : from + 1);
+            if (count != 1) range += "," + std::to_string(count);
+            return range;
+        }
+
+        void appendLines(std::string& out, const std::vector<std::string_view>& lines, std::size_t from,
+                         std::size_t to) {
+            for (; from < to; ++from) out += lines[from];
+        }
+
+        // One side of a conflict; the closing marker needs a line of its own
+        void appendConflictSide(std::string& out, const std::vector<std::string_view>& lines, std::size_t from,
+                                std::size_t to) {
+            appendLines(out, lines, from, to);
+            if (!out.empty() && out.back() != '\n') out += '\n';
+        }
+
+        void appendLine(std::string& out, char prefix, std::string_view line) {
+            out += prefix;
+            out += line;
+            if (line.empty() || line.back() != '\n') {
+                out += "\n\\ No newline at end of file\n";
+            }
+        }
+
+    } // namespace
+
+    std::vector<std::string_view> splitLines(std::string_view text) {
+        std::vector<std::string_view> lines;
+        while (!text.empty()) {
+            std::size_t eol = text.find('\n');
+            std::size_t size = eol == std::string_view::npos ? text.size() : eol + 1;
+            lines.push_back(text.substr(0, size));
+            text.remove_prefix(size);
+        }
+        return lines;
+    }
+
+    std::vector<DiffRegion> diffLines(const std::vector<std::string_view>& oldLines,
+                                      const std::vector<std::string_view>& newLines) {
+        // Common head and tail lines never need hashing
+        std::size_t head = 0;
+        while (head < oldLines.size() && head < newLines.size() && oldLines[head] == newLines[head]) ++head;
+        std::size_t tail = 0;
+        while (tail < oldLines.size() - head && tail < newLines.size() - head &&
+               oldLines[oldLines.size() - 1 - tail] == newLines[newLines.size() - 1 - tail]) {
+            ++tail;
+        }
+
+        std::unordered_map<std::string_view, std::uint32_t> numbers;
+        numbers.reserve(oldLines.size() + newLines.size() - 2 * (head + tail));
+        auto number = [&](std::string_view line) {
+            return numbers.emplace(line, static_cast<std::uint32_t>(numbers.size())).first->second;
+        };
+        std::vector<std::uint32_t> a, b;
+        a.reserve(oldLines.size() - head - tail);
+        b.reserve(newLines.size() - head - tail);
+        for (std::size_t i = head; i < oldLines.size() - tail; ++i) a.push_back(number(oldLines[i]));
+        for (std::size_t j = head; j < newLines.size() - tail; ++j) b.push_back(number(newLines[j]));
+
+        LineMatcher matcher(a, b, numbers.size());
+        matcher.run();
+
+        // Unmarked lines pair up in order; each gap between pairs is a region
+        std::vector<DiffRegion> regions;
+        std::size_t i = 0, j = 0;
+        while (i < a.size() || j < b.size()) {
+            if (i < a.size() && j < b.size() && !matcher.removed[i] && !matcher.added[j]) {
+                ++i;
+                ++j;
+                continue;
+            }
+            DiffRegion region;
+            region.oldStart = head + i;
+            region.newStart = head + j;
+            while (i < a.size() && matcher.removed[i]) ++i;
+            while (j < b.size() && matcher.added[j]) ++j;
+            region.oldCount = head + i - region.oldStart;
+            region.newCount = head + j - region.newStart;
+            regions.push_back(region);
+        }
+        return regions;
+    }
+
+    bool isBinary(std::string_view data) {
+        return data.substr(0, BINARY_PROBE).find('\0') != std::string_view::npos;
+    }
+
+    std::string unifiedDiff(std::string_view oldText, std::string_view newText,
+                            const std::string& oldName, const std::string& newName, std::size_t context) {
+        std::vector<std::string_view> oldLines = splitLines(oldText);
+        std::vector<std::string_view> newLines = splitLines(newText);
+        std::vector<DiffRegion> regions = diffLines(oldLines, newLines);
+        if (regions.empty()) return "";
+
+        std::string out = "--- " + oldName + "\n+++ " + newName + "\n";
+        for (std::size_t first = 0; first < regions.size();) {
+            // Regions whose context would touch share a hunk
+            std::size_t last = first;
+            while (last + 1 < regions.size() &&
+                   regions[last + 1].oldStart - (regions[last].oldStart + regions[last].oldCount) <= 2 * context) {
+                ++last;
+            }
+            const DiffRegion& front = regions[first];
+            const DiffRegion& back = regions[last];
+            std::size_t leading = std::min(context, front.oldStart);
+            std::size_t oldFrom = front.oldStart - leading;
+            std::size_t newFrom = front.newStart - leading;
+            std::size_t trailing = std::min(context, oldLines.size() - (back.oldStart + back.oldCount));
+            std::size_t oldTo = back.oldStart + back.oldCount + trailing;
+            std::size_t newTo = back.newStart + back.newCount + trailing;
+
+            out += "@@ -" + hunkRange(oldFrom, oldTo - oldFrom) + " +" + hunkRange(newFrom, newTo - newFrom) + " @@\n";
+            std::size_t pos = oldFrom;
+            for (std::size_t r = first; r <= last; ++r) {
+                const DiffRegion& region = regions[r];
+                for (; pos < region.oldStart; ++pos) appendLine(out, ' ', oldLines[pos]);
+                for (std::size_t k = 0; k < region.oldCount; ++k) appendLine(out, '-', oldLines[region.oldStart + k]);
+                for (std::size_t k = 0; k < region.newCount; ++k) appendLine(out, '+', newLines[region.newStart + k]);
+                pos = region.oldStart + region.oldCount;
+            }
+            for (; pos < oldTo; ++pos) appendLine(out, ' ', oldLines[pos]);
+            first = last + 1;
+        }
+        return out;
+    }
+
+    MergeResult merge3(std::string_view base, std::string_view ours, std::string_view theirs,
+                       const std::string& oursLabel, const std::string& theirsLabel) {
+        std::vector<std::string_view> baseLines = splitLines(base);
+        std::vector<std::string_view> sideLines[2] = {splitLines(ours), splitLines(theirs)};
+
+        // Changes of both sides in base order; within one side they never
+        // overlap or touch
+        struct Change {
+            DiffRegion region;
+            int side;
+        };
+        std::vector<Change> changes;
+        for (int side = 0; side < 2; ++side) {
+            for (const DiffRegion& region : diffLines(baseLines, sideLines[side])) {
+                changes.push_back(Change{region, side});
+            }
+        }
+        std::sort(changes.begin(), changes.end(), [](const Change& x, const Change& y) {
+            if (x.region.oldStart != y.region.oldStart) return x.region.oldStart < y.region.oldStart;
+            return x.side < y.side;
+        });
+
+        MergeResult result;
+        std::size_t copied = 0;     // base lines up to here are in the result
+        for (std::size_t c = 0; c < changes.size();) {
+            // A chunk is a maximal run of overlapping or touching changes,
+            // covering base lines [lo, hi)
+            std::size_t lo = changes[c].region.oldStart;
+            std::size_t hi = lo + changes[c].region.oldCount;
+            const DiffRegion* first[2] = {nullptr, nullptr};
+            const DiffRegion* last[2] = {nullptr, nullptr};
+            std::size_t end = c;
+            for (; end < changes.size() && (end == c || changes[end].region.oldStart <= hi); ++end) {
+                const Change& change = changes[end];
+                if (!first[change.side]) first[change.side] = &change.region;
+                last[change.side] = &change.region;
+                hi = std::max(hi, change.region.oldStart + change.region.oldCount);
+            }
+            appendLines(result.text, baseLines, copied, lo);
+            copied = hi;
+
+            // The lines each side has in place of base [lo, hi); outside its
+            // own changes a side matches the base
+            std::size_t from[2], to[2];
+            for (int side = 0; side < 2; ++side) {
+                if (!first[side]) continue;
+                from[side] = first[side]->newStart - (first[side]->oldStart - lo);
+                to[side] = last[side]->newStart + last[side]->newCount + (hi - (last[side]->oldStart + last[side]->oldCount));
+            }
+            c = end;
+            if (!first[1]) {
+                appendLines(result.text, sideLines[0], from[0], to[0]);
+                continue;
+            }
+            if (!first[0]) {
+                appendLines(result.text, sideLines[1], from[1], to[1]);
+                continue;
+            }
+
+            const std::vector<std::string_view>& mine = sideLines[0];
+            const std::vector<std::string_view>& other = sideLines[1];
+            while (from[0] < to[0] && from[1] < to[1] && mine[from[0]] == other[from[1]]) {
+                result.text += mine[from[0]];
+                ++from[0];
+                ++from[1];
+            }
+            std::size_t common = 0;
+            while (to[0] - common > from[0] && to[1] - common > from[1] &&
+                   mine[to[0] - common - 1] == other[to[1] - common - 1]) {
+                ++common;
+            }
+            if (from[0] != to[0] - common || from[1] != to[1] - common) {
+                ++result.conflicts;
+                result.text += "<<<<<<< " + oursLabel + "\n";
+                appendConflictSide(result.text, mine, from[0], to[0] - common);
+                result.text += "=======\n";
+                appendConflictSide(result.text, other, from[1], to[1] - common);
+                result.text += ">>>>>>> " + theirsLabel + "\n";
+            }
+            appendLines(result.text, mine, to[0] - common, to[0]);
+        }
+        appendLines(result.text, baseLines, copied, baseLines.size());
+        return result;
+    }
+
+} // namespace gitcpp
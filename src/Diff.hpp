@@ -0,0 +1,64 @@
+#pragma once
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace gitcpp {
+
+    /// A run of lines that differs between two texts: old lines
+    /// [oldStart, oldStart + oldCount) are replaced by new lines
+    /// [newStart, newStart + newCount). Either count may be zero.
+    struct DiffRegion {
+        std::size_t oldStart = 0;
+        std::size_t oldCount = 0;
+        std::size_t newStart = 0;
+        std::size_t newCount = 0;
+    };
+
+    /// Split `text` into lines, each keeping its '\n'. The views point into
+    /// `text`.
+    std::vector<std::string_view> splitLines(std::string_view text);
+
+    /// Differing regions between two line sequences, in order.
+    ///
+    /// Every distinct line is hashed once and replaced by a small integer.
+    /// Matching then uses the histogram algorithm: it anchors on the
+    /// rarest lines common to both sides and recurses around them, which
+    /// keeps unique lines (declarations, braces with context) aligned.
+    /// Ranges without a usable anchor fall back to Myers' O(ND) algorithm
+    /// with linear-space bisection.
+    std::vector<DiffRegion> diffLines(const std::vector<std::string_view>& oldLines,
+                                      const std::vector<std::string_view>& newLines);
+
+    /// True if the data looks binary (a NUL byte near the start).
+    bool isBinary(std::string_view data);
+
+    /// Unified diff of two texts with `context` lines around each change,
+    /// headed by "--- <oldName>" and "+++ <newName>". Empty if the texts are
+    /// equal.
+    std::string unifiedDiff(std::string_view oldText, std::string_view newText,
+                            const std::string& oldName, const std::string& newName, std::size_t context = 3);
+
+    /// Result of merge3(): the merged text, with conflict markers around
+    /// each of the `conflicts` regions both sides changed differently.
+    struct MergeResult {
+        std::string text;
+        std::size_t conflicts = 0;
+    };
+
+    /// diff3-style merge of two texts derived from `base`. Each side is
+    /// diffed against the base; changes from one side only are taken as is,
+    /// identical changes once, and changes whose base ranges overlap or
+    /// touch become a conflict. Lines both sides agree on are trimmed from
+    /// a conflict, so the markers surround only the lines that differ:
+    ///
+    ///     <<<<<<< oursLabel
+    ///     ours
+    ///     =======
+    ///     theirs
+    ///     >>>>>>> theirsLabel
+    MergeResult merge3(std::string_view base, std::string_view ours, std::string_view theirs,
+                       const std::string& oursLabel, const std::string& theirsLabel);
+
+} // namespace gitcpp
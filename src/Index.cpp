@@ -0,0 +1,290 @@
+#include "Index.hpp"
+
+#include <sys/stat.h>
+
+#include <cstring>
+
+namespace fs = std::filesystem;
+
+namespace gitcpp {
+
+    namespace {
+
+        constexpr unsigned char INDEX_MAGIC[4] = {'G', 'C', 'I', 'N'};
+        constexpr unsigned char DELTA_MAGIC[4] = {'G', 'C', 'I', 'D'};
+        constexpr std::uint32_t INDEX_VERSION = 1;
+        constexpr std::size_t HEADER = 12;
+        constexpr std::size_t RAW_ID = 20;
+        constexpr std::size_t DELTA_HEADER = HEADER + RAW_ID;     // and the base's checksum
+
+        // write() rewrites the base once the delta would hold more than
+        // 1/DELTA_RATIO as many entries as the base
+        constexpr std::size_t DELTA_RATIO = 8;
+
+        // Record: path offset, path length, raw id, mode, size, mtime,
+        // ctime, inode, device, flags.
+        constexpr std::size_t RECORD = 4 + 4 + RAW_ID + 4 + 8 + 8 + 8 + 8 + 8 + 4;
+
+        void putRecord(std::vector<unsigned char>& out, const IndexEntry& e, std::uint32_t pathOffset) {
+            putBE32(out, pathOffset);
+            putBE32(out, static_cast<std::uint32_t>(e.path.size()));
+            unsigned char raw[RAW_ID];
+            fromHex(e.id, raw);
+            out.insert(out.end(), raw, raw + RAW_ID);
+            putBE32(out, e.mode);
+            putBE64(out, e.size);
+            putBE64(out, static_cast<std::uint64_t>(e.mtimeNs));
+            putBE64(out, static_cast<std::uint64_t>(e.ctimeNs));
+            putBE64(out, e.inode);
+            putBE64(out, e.device);
+            putBE32(out, e.flags);
+        }
+
+        IndexEntry readRecord(const unsigned char* r, const unsigned char* pool) {
+            IndexEntry e;
+            e.path = std::string(reinterpret_cast<const char*>(pool) + getBE32(r), getBE32(r + 4));
+            e.id = toHex(r + 8, RAW_ID);
+            const unsigned char* p = r + 8 + RAW_ID;
+            e.mode = getBE32(p);
+            e.size = getBE64(p + 4);
+            e.mtimeNs = static_cast<std::int64_t>(getBE64(p + 12));
+            e.ctimeNs = static_cast<std::int64_t>(getBE64(p + 20));
+            e.inode = getBE64(p + 28);
+            e.device = getBE64(p + 36);
+            e.flags = getBE32(p + 44);
+            return e;
+        }
+
+        // Records of `count` entries starting at `records`, `stride` bytes
+        // apart, must point into the path pool of `poolSize` bytes
+        bool recordsFit(const unsigned char* records, std::size_t count, std::size_t stride, std::size_t poolSize) {
+            for (std::size_t i = 0; i < count; ++i) {
+                const unsigned char* r = records + i * stride;
+                if (std::size_t(getBE32(r)) + getBE32(r + 4) > poolSize) return false;
+            }
+            return true;
+        }
+
+    } // namespace
+
+    bool statEntry(const fs::path& file, IndexEntry& entry) {
+        struct stat st;
+        if (::stat(file.c_str(), &st) != 0) {
+            return false;
+        }
+#ifdef __APPLE__
+        const auto& mtime = st.st_mtimespec;
+        const auto& ctime = st.st_ctimespec;
+#else
+        const auto& mtime = st.st_mtim;
+        const auto& ctime = st.st_ctim;
+#endif
+        entry.mode = static_cast<std::uint32_t>(st.st_mode);
+        entry.size = static_cast<std::uint64_t>(st.st_size);
+        entry.mtimeNs = std::int64_t(mtime.tv_sec) * 1000000000 + mtime.tv_nsec;
+        entry.ctimeNs = std::int64_t(ctime.tv_sec) * 1000000000 + ctime.tv_nsec;
+        entry.inode = static_cast<std::uint64_t>(st.st_ino);
+        entry.device = static_cast<std::uint64_t>(st.st_dev);
+        return true;
+    }
+
+    bool statMatches(const IndexEntry& a, const IndexEntry& b) {
+        return a.size == b.size && a.mtimeNs == b.mtimeNs && a.ctimeNs == b.ctimeNs &&
+               a.inode == b.inode && a.device == b.device && a.mode == b.mode;
+    }
+
+    Index::Index(const fs::path& file) : file_(file), deltaFile_(fs::path(file).concat(".delta")) {
+        IndexEntry self;
+        if (!statEntry(file_, self)) return;
+        mtimeNs_ = self.mtimeNs;
+
+        map_ = MappedFile(file_);
+        const unsigned char* data = map_.data();
+        if (map_.size() < HEADER + RAW_ID || std::memcmp(data, INDEX_MAGIC, 4) != 0 ||
+            getBE32(data + 4) != INDEX_VERSION || !trailerMatches(data, map_.size())) {
+            throw error("Corrupt index: " + file_.string());
+        }
+        count_ = getBE32(data + 8);
+        records_ = data + HEADER;
+        paths_ = records_ + std::size_t(count_) * RECORD;
+        if (paths_ + RAW_ID > data + map_.size()) {
+            throw error("Corrupt index: " + file_.string());
+        }
+        std::size_t poolSize = map_.size() - HEADER - std::size_t(count_) * RECORD - RAW_ID;
+        if (!recordsFit(records_, count_, RECORD, poolSize)) {
+            throw error("Corrupt index: " + file_.string());
+        }
+        readDelta();
+    }
+
+    void Index::readDelta() {
+        IndexEntry self;
+        if (!statEntry(deltaFile_, self)) return;
+        std::vector<unsigned char> delta = readContents(deltaFile_);
+        if (delta.size() < DELTA_HEADER + RAW_ID || std::memcmp(delta.data(), DELTA_MAGIC, 4) != 0 ||
+            getBE32(delta.data() + 4) != INDEX_VERSION || !trailerMatches(delta.data(), delta.size())) {
+            throw error("Corrupt index: " + deltaFile_.string());
+        }
+        // A delta left behind by a base that has since been rewritten is stale
+        if (std::memcmp(delta.data() + HEADER, map_.data() + map_.size() - RAW_ID, RAW_ID) != 0) return;
+
+        std::size_t count = getBE32(delta.data() + 8);
+        const unsigned char* records = delta.data() + DELTA_HEADER;
+        std::size_t fixed = DELTA_HEADER + count * (1 + RECORD) + RAW_ID;
+        if (fixed > delta.size() || !recordsFit(records + 1, count, 1 + RECORD, delta.size() - fixed)) {
+            throw error("Corrupt index: " + deltaFile_.string());
+        }
+        const unsigned char* pool = records + count * (1 + RECORD);
+        for (std::size_t i = 0; i < count; ++i) {
+            const unsigned char* r = records + i * (1 + RECORD);
+            IndexEntry entry = readRecord(r + 1, pool);
+            if (r[0]) {
+                pending_[entry.path] = entry;
+            } else {
+                pending_[entry.path] = std::nullopt;
+            }
+        }
+        deltaMtimeNs_ = self.mtimeNs;
+    }
+
+    std::string_view Index::pathAt(std::size_t i) const {
+        const unsigned char* r = records_ + i * RECORD;
+        return std::string_view(reinterpret_cast<const char*>(paths_) + getBE32(r), getBE32(r + 4));
+    }
+
+    IndexEntry Index::entryAt(std::size_t i) const {
+        return readRecord(records_ + i * RECORD, paths_);
+    }
+
+    long Index::find(std::string_view path) const {
+        if (cleared_) return -1;
+        std::size_t lo = 0, hi = count_;
+        while (lo < hi) {
+            std::size_t mid = lo + (hi - lo) / 2;
+            int cmp = pathAt(mid).compare(path);
+            if (cmp == 0) return static_cast<long>(mid);
+            if (cmp < 0) lo = mid + 1; else hi = mid;
+        }
+        return -1;
+    }
+
+    std::optional<IndexEntry> Index::get(const std::string& path) const {
+        auto it = pending_.find(path);
+        if (it != pending_.end()) return it->second;
+        long pos = find(path);
+        if (pos < 0) return std::nullopt;
+        return entryAt(static_cast<std::size_t>(pos));
+    }
+
+    void Index::set(const IndexEntry& entry) {
+        pending_[entry.path] = entry;
+    }
+
+    void Index::erase(const std::string& path) {
+        pending_[path] = std::nullopt;
+    }
+
+    void Index::clear() {
+        cleared_ = true;
+        pending_.clear();
+    }
+
+    std::vector<IndexEntry> Index::entries() const {
+        // Merge the sorted mapped records with the sorted overlay.
+        std::vector<IndexEntry> out;
+        std::size_t mapped = cleared_ ? 0 : count_;
+        out.reserve(mapped + pending_.size());
+        std::size_t i = 0;
+        auto it = pending_.begin();
+        while (i < mapped || it != pending_.end()) {
+            int cmp;
+            if (i == mapped) cmp = 1;
+            else if (it == pending_.end()) cmp = -1;
+            else cmp = pathAt(i).compare(it->first);
+
+            if (cmp < 0) {
+                out.push_back(entryAt(i++));
+            } else {
+                if (it->second) out.push_back(*it->second);
+                if (cmp == 0) ++i;
+                ++it;
+            }
+        }
+        return out;
+    }
+
+    std::map<std::string, std::string> Index::toMap() const {
+        std::map<std::string, std::string> files;
+        for (const IndexEntry& e : entries()) {
+            files.emplace_hint(files.end(), e.path, e.id);
+        }
+        return files;
+    }
+
+    bool Index::isRacy(const IndexEntry& entry) const {
+        // Entries in the delta were recorded when the delta was written
+        return entry.mtimeNs >= (pending_.count(entry.path) ? deltaMtimeNs_ : mtimeNs_);
+    }
+
+    void Index::write() {
+        // Small changes to a large index only rewrite the delta
+        bool delta = !cleared_ && map_.size() > 0 && pending_.size() * DELTA_RATIO <= count_;
+        if (delta) {
+            writeDelta();
+        } else {
+            writeBase();
+        }
+
+        // Re-open the new files so this object stays usable.
+        pending_.clear();
+        cleared_ = false;
+        count_ = 0;
+        mtimeNs_ = deltaMtimeNs_ = 0;
+        records_ = paths_ = nullptr;
+        *this = Index(file_);
+    }
+
+    void Index::writeBase() {
+        std::vector<IndexEntry> all = entries();
+
+        std::vector<unsigned char> out(INDEX_MAGIC, INDEX_MAGIC + 4);
+        putBE32(out, INDEX_VERSION);
+        putBE32(out, static_cast<std::uint32_t>(all.size()));
+        std::uint32_t pathOffset = 0;
+        for (const IndexEntry& e : all) {
+            putRecord(out, e, pathOffset);
+            pathOffset += static_cast<std::uint32_t>(e.path.size());
+        }
+        for (const IndexEntry& e : all) {
+            out.insert(out.end(), e.path.begin(), e.path.end());
+        }
+        putTrailer(out);
+
+        map_ = MappedFile();
+        writeDurable(file_, false, out);
+        std::error_code ignored;
+        fs::remove(deltaFile_, ignored);
+    }
+
+    void Index::writeDelta() {
+        std::vector<unsigned char> out(DELTA_MAGIC, DELTA_MAGIC + 4);
+        putBE32(out, INDEX_VERSION);
+        putBE32(out, static_cast<std::uint32_t>(pending_.size()));
+        out.insert(out.end(), map_.data() + map_.size() - RAW_ID, map_.data() + map_.size());
+        std::uint32_t pathOffset = 0;
+        for (const auto& [path, entry] : pending_) {
+            out.push_back(entry ? 1 : 0);
+            IndexEntry erased;
+            erased.path = path;
+            erased.id = std::string(40, '0');
+            putRecord(out, entry ? *entry : erased, pathOffset);
+            pathOffset += static_cast<std::uint32_t>(path.size());
+        }
+        for (const auto& change : pending_) {
+            out.insert(out.end(), change.first.begin(), change.first.end());
+        }
+        putTrailer(out);
+        writeDurable(deltaFile_, false, out);
+    }
+
+} // namespace gitcpp
@@ -0,0 +1,101 @@
+#pragma once
+#include "Utils.hpp"
+
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace gitcpp {
+
+    /// One tracked path in the staging index, with the stat data it had
+    /// when it was last staged or checked out.
+    struct IndexEntry {
+        std::string path;
+        std::string id;                 // 40-hex blob id
+        std::uint32_t mode = 0;
+        std::uint64_t size = 0;
+        std::int64_t mtimeNs = 0;
+        std::int64_t ctimeNs = 0;
+        std::uint64_t inode = 0;
+        std::uint64_t device = 0;
+        std::uint32_t flags = 0;
+    };
+
+    /// Fill the stat fields of `entry` from `file`. Returns false if the
+    /// file does not exist.
+    bool statEntry(const std::filesystem::path& file, IndexEntry& entry);
+
+    /// True if the stat fields of `a` and `b` agree, i.e. the file has not
+    /// been touched since `a` was recorded (modulo racy timestamps).
+    bool statMatches(const IndexEntry& a, const IndexEntry& b);
+
+    /// Binary staging index (`staged_files/index`): the full set of tracked
+    /// paths, sorted by path.
+    ///
+    /// Layout: "GCIN", version, entry count, fixed-size entry records
+    /// (path offset/length, raw id, mode, size, mtime, ctime, inode,
+    /// device, flags), the path pool and a SHA-1 trailer. The file is
+    /// mmapped, its trailer checked, and binary-searched in place; changes
+    /// are kept in an overlay.
+    ///
+    /// write() stores a small overlay as a delta file next to the index
+    /// (`index.delta`: "GCID", version, count, the index's trailer, one
+    /// set/erase byte and record per changed path, the path pool and a
+    /// SHA-1 trailer), so staging a few files in a large index does not
+    /// rewrite it. Once the delta grows past an eighth of the index it is
+    /// merged into a new index file.
+    class Index {
+    public:
+        /// Open `file`, or start empty if it does not exist.
+        explicit Index(const std::filesystem::path& file);
+
+        std::optional<IndexEntry> get(const std::string& path) const;
+        bool contains(const std::string& path) const { return get(path).has_value(); }
+
+        void set(const IndexEntry& entry);
+        void erase(const std::string& path);
+
+        /// Drop every entry (e.g. before loading a whole tree).
+        void clear();
+
+        /// All entries, sorted by path.
+        std::vector<IndexEntry> entries() const;
+
+        /// path -> blob id for every entry.
+        std::map<std::string, std::string> toMap() const;
+
+        /// An entry is racily clean if its file was modified no earlier
+        /// than the index was written: a later edit within the same
+        /// timestamp tick would leave its stat data unchanged, so its
+        /// contents must be rehashed.
+        bool isRacy(const IndexEntry& entry) const;
+
+        /// Persist the changes, replacing the delta or the index file
+        /// atomically.
+        void write();
+
+    private:
+        long find(std::string_view path) const;     // record position or -1
+        std::string_view pathAt(std::size_t i) const;
+        IndexEntry entryAt(std::size_t i) const;
+        void readDelta();
+        void writeBase();
+        void writeDelta();
+
+        std::filesystem::path file_;
+        std::filesystem::path deltaFile_;
+        MappedFile map_;
+        std::uint32_t count_ = 0;
+        const unsigned char* records_ = nullptr;
+        const unsigned char* paths_ = nullptr;
+        std::int64_t mtimeNs_ = 0;
+        std::int64_t deltaMtimeNs_ = 0;
+        bool cleared_ = false;
+        std::map<std::string, std::optional<IndexEntry>> pending_;
+    };
+
+} // namespace gitcpp
@@ -0,0 +1,70 @@
+#include "LayerChain.hpp"
+
+#include <set>
+#include <sstream>
+#include <utility>
+
+namespace fs = std::filesystem;
+
+namespace gitcpp {
+
+    namespace {
+
+        constexpr std::size_t RAW_ID = 20;
+
+        // A new layer absorbs the layer below it unless that one holds more
+        // than SIZE_MULTIPLE times as many entries.
+        constexpr std::size_t SIZE_MULTIPLE = 2;
+
+        constexpr const char* CHAIN_FILE = "chain";
+
+    } // namespace
+
+    LayerChain::LayerChain(fs::path dir, std::string prefix, std::string extension)
+        : dir_(std::move(dir)), prefix_(std::move(prefix)), extension_(std::move(extension)) {}
+
+    bool LayerChain::read(std::vector<std::string>& names) const {
+        names.clear();
+        fs::path chain = dir_ / CHAIN_FILE;
+        if (!fs::is_regular_file(chain)) return false;
+
+        std::istringstream lines(readContentsAsString(chain));
+        std::string name;
+        while (std::getline(lines, name)) {
+            if (!name.empty()) names.push_back(name);
+        }
+        return true;
+    }
+
+    std::size_t LayerChain::foldCount(const std::vector<std::size_t>& sizes, std::size_t added) {
+        std::size_t folded = 0;
+        while (folded < sizes.size() && sizes[sizes.size() - 1 - folded] <= SIZE_MULTIPLE * added) {
+            added += sizes[sizes.size() - 1 - folded];
+            ++folded;
+        }
+        return folded;
+    }
+
+    std::string LayerChain::writeLayer(const std::vector<unsigned char>& data) const {
+        if (data.size() < RAW_ID) throw error("Layer has no trailer: " + dir_.string());
+        std::string name = prefix_ + toHex(data.data() + data.size() - RAW_ID, RAW_ID);
+        fs::create_directories(dir_);
+        writeDurable(file(name), false, data);
+        return name;
+    }
+
+    void LayerChain::writeChain(const std::vector<std::string>& names) const {
+        std::string chain;
+        for (const std::string& name : names) chain += name + "\n";
+        fs::create_directories(dir_);
+        writeDurable(dir_ / CHAIN_FILE, false, chain);
+
+        // Layers that were folded into the new one are no longer referenced
+        std::set<std::string> live(names.begin(), names.end());
+        for (const std::string& file : plainFilenamesIn(dir_)) {
+            fs::path path = dir_ / file;
+            if (path.extension() == extension_ && !live.count(path.stem().string())) fs::remove(path);
+        }
+    }
+
+} // namespace gitcpp
@@ -0,0 +1,45 @@
+#pragma once
+#include "Utils.hpp"
+
+#include <cstddef>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace gitcpp {
+
+    /// Layer files of one index (the commit-graph, the message index) in a
+    /// directory of their own, listed base first in `<dir>/chain`. Layers
+    /// are named `<prefix><trailer hex><extension>` after their SHA-1
+    /// trailer. New entries go into a new layer on top, which absorbs the
+    /// small layers below it so the chain stays logarithmic in the number
+    /// of entries.
+    class LayerChain {
+    public:
+        LayerChain(std::filesystem::path dir, std::string prefix, std::string extension);
+
+        /// Layer names in the chain, base first. Returns false if there is
+        /// no chain file.
+        bool read(std::vector<std::string>& names) const;
+
+        std::filesystem::path file(const std::string& name) const { return dir_ / (name + extension_); }
+
+        /// How many of the top layers a new layer of `added` entries
+        /// absorbs, given the layer sizes base first.
+        static std::size_t foldCount(const std::vector<std::size_t>& sizes, std::size_t added);
+
+        /// Store `data`, which ends in its trailer, as a layer and return
+        /// its name.
+        std::string writeLayer(const std::vector<unsigned char>& data) const;
+
+        /// Point the chain at `names`, base first, and delete the layers it
+        /// no longer lists.
+        void writeChain(const std::vector<std::string>& names) const;
+
+    private:
+        std::filesystem::path dir_;
+        std::string prefix_;
+        std::string extension_;
+    };
+
+} // namespace gitcpp
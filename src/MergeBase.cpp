@@ -0,0 +1,190 @@
+#include "MergeBase.hpp"
+
+#include <algorithm>
+#include <queue>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace gitcpp {
+
+    namespace {
+
+        constexpr unsigned PARENT1 = 1;
+        constexpr unsigned PARENT2 = 2;
+        constexpr unsigned STALE = 4;
+        constexpr unsigned RESULT = 8;
+
+        // Commits the graph does not know are newer than everything in it
+        constexpr std::uint32_t GENERATION_INFINITY = 0xffffffff;
+
+        struct Node {
+            std::string id;
+            std::vector<std::size_t> parents;
+            bool loaded = false;
+            std::uint32_t generation = GENERATION_INFINITY;
+            std::int64_t timestamp = 0;
+            unsigned flags = 0;
+            unsigned queued = 0;            // entries in the walk queue
+        };
+
+        // Commits reached by the walk, loaded on first use from the
+        // commit-graph or, failing that, from the commit object.
+        class Walk {
+        public:
+            Walk(const CommitGraph& graph, const ObjectStore& store) : graph_(graph), store_(store) {}
+
+            std::size_t node(const std::string& id) {
+                auto it = index_.find(id);
+                if (it != index_.end()) return it->second;
+                std::size_t n = nodes_.size();
+                index_.emplace(id, n);
+                Node fresh;
+                fresh.id = id;
+                nodes_.push_back(std::move(fresh));
+                return n;
+            }
+
+            Node& operator[](std::size_t n) { return nodes_[n]; }
+
+            // Loading a commit adds nodes for its parents, so references
+            // into the walk are only stable until the next load.
+            const std::vector<std::size_t>& parents(std::size_t n) {
+                return info(n).parents;
+            }
+
+            std::uint32_t generation(std::size_t n) {
+                return info(n).generation;
+            }
+
+            // Queue order: highest generation first, then newest
+            bool before(std::size_t x, std::size_t y) {
+                info(x);
+                info(y);
+                const Node& a = nodes_[x];
+                const Node& b = nodes_[y];
+                if (a.generation != b.generation) return a.generation > b.generation;
+                return a.timestamp > b.timestamp;
+            }
+
+        private:
+            const Node& info(std::size_t n) {
+                if (!nodes_[n].loaded) load(n);
+                return nodes_[n];
+            }
+
+            void load(std::size_t n) {
+                std::string id = nodes_[n].id;
+                std::vector<std::string> parents;
+                std::uint32_t pos = graph_.find(id);
+                if (pos != CommitGraph::NOT_FOUND) {
+                    nodes_[n].generation = graph_.generation(pos);
+                    nodes_[n].timestamp = graph_.timestamp(pos);
+                    for (std::uint32_t parent : graph_.parents(pos)) parents.push_back(graph_.id(parent));
+                } else if (auto commit = store_.commit(id)) {
+                    parents = commit->parents;
+                    nodes_[n].timestamp = commit->timestamp;
+                }
+                std::vector<std::size_t> indices;
+                for (const std::string& parent : parents) indices.push_back(node(parent));
+                nodes_[n].parents = std::move(indices);
+                nodes_[n].loaded = true;
+            }
+
+            const CommitGraph& graph_;
+            const ObjectStore& store_;
+            std::vector<Node> nodes_;
+            std::unordered_map<std::string, std::size_t> index_;
+        };
+
+        // Paint commits reachable from `a` with PARENT1 and from `b` with
+        // PARENT2. Returns the commits first reached from both sides; their
+        // ancestors are painted STALE and not explored further.
+        std::vector<std::size_t> paintDownToCommon(Walk& walk, std::size_t a, std::size_t b) {
+            auto later = [&](std::size_t x, std::size_t y) { return walk.before(y, x); };
+            std::priority_queue<std::size_t, std::vector<std::size_t>, decltype(later)> queue(later);
+            // Queued entries whose commit is not (yet) STALE; the walk ends
+            // when there are none left
+            std::size_t nonStale = 0;
+            auto push = [&](std::size_t n) {
+                queue.push(n);
+                ++walk[n].queued;
+                if (!(walk[n].flags & STALE)) ++nonStale;
+            };
+            std::vector<std::size_t> result;
+
+            walk[a].flags |= PARENT1;
+            walk[b].flags |= PARENT2;
+            push(a);
+            push(b);
+            while (nonStale > 0) {
+                std::size_t n = queue.top();
+                queue.pop();
+                unsigned flags = walk[n].flags & (PARENT1 | PARENT2 | STALE);
+                --walk[n].queued;
+                if (!(flags & STALE)) --nonStale;
+                if ((flags & (PARENT1 | PARENT2)) == (PARENT1 | PARENT2)) {
+                    if (!(walk[n].flags & RESULT)) {
+                        walk[n].flags |= RESULT;
+                        result.push_back(n);
+                    }
+                    flags |= STALE;
+                }
+                std::vector<std::size_t> parents = walk.parents(n);
+                for (std::size_t parent : parents) {
+                    if ((walk[parent].flags & flags) == flags) continue;
+                    if ((flags & STALE) && !(walk[parent].flags & STALE)) nonStale -= walk[parent].queued;
+                    walk[parent].flags |= flags;
+                    push(parent);
+                }
+            }
+            return result;
+        }
+
+    } // namespace
+
+    std::vector<std::string> mergeBases(const CommitGraph& graph, const ObjectStore& store,
+                                        const std::string& a, const std::string& b) {
+        if (a.empty() || b.empty()) return {};
+        if (a == b) return {a};
+
+        Walk walk(graph, store);
+        std::size_t first = walk.node(a);
+        std::size_t second = walk.node(b);
+        std::vector<std::size_t> candidates;
+        for (std::size_t n : paintDownToCommon(walk, first, second)) {
+            if (!(walk[n].flags & STALE)) candidates.push_back(n);
+        }
+        std::sort(candidates.begin(), candidates.end(),
+                  [&](std::size_t x, std::size_t y) { return walk.before(x, y); });
+
+        // With inexact ordering (commits outside the graph) a candidate can
+        // still be an ancestor of another one. Walk down from the better
+        // candidates, never below the generation of the one being tested.
+        std::vector<std::string> bases;
+        for (std::size_t i = 0; i < candidates.size(); ++i) {
+            std::size_t target = candidates[i];
+            bool redundant = false;
+            for (std::size_t j = 0; j < candidates.size() && !redundant; ++j) {
+                if (i == j) continue;
+                std::vector<std::size_t> stack = {candidates[j]};
+                std::unordered_set<std::size_t> visited;
+                while (!stack.empty() && !redundant) {
+                    std::size_t n = stack.back();
+                    stack.pop_back();
+                    std::vector<std::size_t> parents = walk.parents(n);
+                    for (std::size_t parent : parents) {
+                        if (parent == target) {
+                            redundant = true;
+                            break;
+                        }
+                        if (walk.generation(parent) < walk.generation(target)) continue;
+                        if (visited.insert(parent).second) stack.push_back(parent);
+                    }
+                }
+            }
+            if (!redundant) bases.push_back(walk[target].id);
+        }
+        return bases;
+    }
+
+} // namespace gitcpp
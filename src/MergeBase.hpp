@@ -0,0 +1,23 @@
+#pragma once
+#include "CommitGraph.hpp"
+#include "ObjectStore.hpp"
+
+#include <string>
+#include <vector>
+
+namespace gitcpp {
+
+    /// Best common ancestors of `a` and `b`: common ancestors that are not
+    /// ancestors of another common ancestor. Usually one commit; several
+    /// for criss-cross histories; none for unrelated histories. The result
+    /// is ordered best first (highest generation, then newest).
+    ///
+    /// Both sides are walked together from a priority queue ordered by
+    /// generation number (commit time for commits the commit-graph does
+    /// not know), painting every commit with the side(s) that reach it.
+    /// The walk stops once every queued commit is below a known common
+    /// ancestor, so only the part of history above the bases is visited.
+    std::vector<std::string> mergeBases(const CommitGraph& graph, const ObjectStore& store,
+                                        const std::string& a, const std::string& b);
+
+} // namespace gitcpp
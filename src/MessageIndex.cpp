@@ -0,0 +1,356 @@
+#include "MessageIndex.hpp"
+#include "LayerChain.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <unordered_set>
+
+namespace fs = std::filesystem;
+
+namespace gitcpp {
+
+    namespace {
+
+        constexpr unsigned char INDEX_MAGIC[4] = {'G', 'C', 'M', 'I'};
+        constexpr std::uint32_t INDEX_VERSION = 1;
+        constexpr std::size_t HEADER = 4 + 4 + 4 + 4 + 8 + 8 + 8;
+        constexpr std::size_t RAW_ID = 20;
+        constexpr std::size_t HASH_ENTRY = 8 + 4;     // message hash, commit number
+        constexpr std::size_t WORD_ENTRY = 4 * 4;     // offset, length, first posting, postings
+
+        std::uint64_t messageHash(std::string_view message) {
+            std::uint64_t hash = 14695981039346656037ull;
+            for (unsigned char c : message) hash = (hash ^ c) * 1099511628211ull;
+            return hash;
+        }
+
+        bool isWordByte(unsigned char c) {
+            return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c >= 0x80;
+        }
+
+        // [begin, end) of every word in `text`
+        std::vector<std::pair<std::size_t, std::size_t>> wordsIn(std::string_view text) {
+            std::vector<std::pair<std::size_t, std::size_t>> words;
+            std::size_t i = 0;
+            while (i < text.size()) {
+                if (!isWordByte(static_cast<unsigned char>(text[i]))) {
+                    ++i;
+                    continue;
+                }
+                std::size_t begin = i;
+                while (i < text.size() && isWordByte(static_cast<unsigned char>(text[i]))) ++i;
+                words.emplace_back(begin, i);
+            }
+            return words;
+        }
+
+        std::string lowered(std::string_view word) {
+            std::string out(word);
+            for (char& c : out) {
+                if (c >= 'A' && c <= 'Z') c = static_cast<char>(c - 'A' + 'a');
+            }
+            return out;
+        }
+
+        LayerChain chainOf(const Repository& repo) {
+            return LayerChain(repo.MESSAGE_INDEX, "mindex-", ".midx");
+        }
+
+        // Messages are indexed without the newline commit() stores after them
+        std::string_view indexedMessage(std::string_view message) {
+            if (!message.empty() && message.back() == '\n') message.remove_suffix(1);
+            return message;
+        }
+
+    } // namespace
+
+    MessageIndex::MessageIndex(const Repository& repo) {
+        LayerChain chain = chainOf(repo);
+        std::vector<std::string> names;
+        exists_ = chain.read(names);
+
+        for (const std::string& name : names) {
+            fs::path file = chain.file(name);
+            Layer layer;
+            layer.name = name;
+            layer.map = MappedFile(file);
+            const unsigned char* data = layer.map.data();
+            std::size_t size = layer.map.size();
+            if (size < HEADER + 8 + RAW_ID || std::memcmp(data, INDEX_MAGIC, 4) != 0 ||
+                getBE32(data + 4) != INDEX_VERSION || !trailerMatches(data, size)) {
+                throw error("Corrupt message index: " + file.string());
+            }
+            layer.count = getBE32(data + 8);
+            layer.wordCount = getBE32(data + 12);
+            layer.postingCount = getBE64(data + 16);
+            layer.wordByteCount = getBE64(data + 24);
+            layer.messageBytes = getBE64(data + 32);
+            std::uint64_t expected = HEADER + std::uint64_t(layer.count) * (RAW_ID + 8 + HASH_ENTRY) + 8 +
+                                     std::uint64_t(layer.wordCount) * WORD_ENTRY + layer.wordByteCount +
+                                     layer.postingCount * 4 + layer.messageBytes + RAW_ID;
+            if (expected != size) {
+                throw error("Corrupt message index: " + file.string());
+            }
+            layer.ids = data + HEADER;
+            layer.offsets = layer.ids + std::size_t(layer.count) * RAW_ID;
+            layer.hashes = layer.offsets + (std::size_t(layer.count) + 1) * 8;
+            layer.words = layer.hashes + std::size_t(layer.count) * HASH_ENTRY;
+            layer.wordBytes = layer.words + std::size_t(layer.wordCount) * WORD_ENTRY;
+            layer.postings = layer.wordBytes + layer.wordByteCount;
+            layer.messages = layer.postings + layer.postingCount * 4;
+            layers_.push_back(std::move(layer));
+        }
+    }
+
+    std::string MessageIndex::Layer::id(std::uint32_t i) const {
+        return toHex(ids + std::size_t(i) * RAW_ID, RAW_ID);
+    }
+
+    std::string_view MessageIndex::Layer::message(std::uint32_t i) const {
+        std::uint64_t begin = getBE64(offsets + std::size_t(i) * 8);
+        std::uint64_t end = getBE64(offsets + (std::size_t(i) + 1) * 8);
+        if (begin > end || end > messageBytes) throw error("Corrupt message index: " + name);
+        return std::string_view(reinterpret_cast<const char*>(messages + begin), end - begin);
+    }
+
+    std::vector<std::uint32_t> MessageIndex::Layer::postingsOf(std::string_view word) const {
+        std::uint32_t lo = 0, hi = wordCount;
+        while (lo < hi) {
+            std::uint32_t mid = lo + (hi - lo) / 2;
+            const unsigned char* entry = words + std::size_t(mid) * WORD_ENTRY;
+            std::uint32_t offset = getBE32(entry);
+            std::uint32_t length = getBE32(entry + 4);
+            if (std::uint64_t(offset) + length > wordByteCount) throw error("Corrupt message index: " + name);
+            int cmp = std::string_view(reinterpret_cast<const char*>(wordBytes + offset), length).compare(word);
+            if (cmp < 0) {
+                lo = mid + 1;
+            } else if (cmp > 0) {
+                hi = mid;
+            } else {
+                std::uint32_t first = getBE32(entry + 8);
+                std::uint32_t n = getBE32(entry + 12);
+                if (std::uint64_t(first) + n > postingCount) throw error("Corrupt message index: " + name);
+                std::vector<std::uint32_t> result(n);
+                for (std::uint32_t k = 0; k < n; ++k) result[k] = getBE32(postings + (std::size_t(first) + k) * 4);
+                return result;
+            }
+        }
+        return {};
+    }
+
+    std::size_t MessageIndex::size() const {
+        std::size_t total = 0;
+        for (const Layer& layer : layers_) total += layer.count;
+        return total;
+    }
+
+    bool MessageIndex::contains(const std::string& id) const {
+        if (!isObjectId(id)) return false;
+        unsigned char raw[RAW_ID];
+        fromHex(id, raw);
+        for (const Layer& layer : layers_) {
+            std::uint32_t lo = 0, hi = layer.count;
+            while (lo < hi) {
+                std::uint32_t mid = lo + (hi - lo) / 2;
+                int cmp = std::memcmp(layer.ids + std::size_t(mid) * RAW_ID, raw, RAW_ID);
+                if (cmp == 0) return true;
+                if (cmp < 0) lo = mid + 1; else hi = mid;
+            }
+        }
+        return false;
+    }
+
+    std::vector<std::string> MessageIndex::exact(const std::string& message) const {
+        std::uint64_t hash = messageHash(message);
+        std::vector<std::string> result;
+        for (const Layer& layer : layers_) {
+            // First entry with this hash, then every one that shares it
+            std::uint32_t lo = 0, hi = layer.count;
+            while (lo < hi) {
+                std::uint32_t mid = lo + (hi - lo) / 2;
+                if (getBE64(layer.hashes + std::size_t(mid) * HASH_ENTRY) < hash) lo = mid + 1; else hi = mid;
+            }
+            for (; lo < layer.count && getBE64(layer.hashes + std::size_t(lo) * HASH_ENTRY) == hash; ++lo) {
+                std::uint32_t i = getBE32(layer.hashes + std::size_t(lo) * HASH_ENTRY + 8);
+                if (i < layer.count && layer.message(i) == message) result.push_back(layer.id(i));
+            }
+        }
+        std::sort(result.begin(), result.end());
+        return result;
+    }
+
+    std::vector<std::string> MessageIndex::search(const std::vector<std::string>& required,
+                                                  const std::function<bool(std::string_view)>& matches) const {
+        std::vector<std::string> result;
+        for (const Layer& layer : layers_) {
+            if (required.empty()) {
+                for (std::uint32_t i = 0; i < layer.count; ++i) {
+                    if (matches(layer.message(i))) result.push_back(layer.id(i));
+                }
+                continue;
+            }
+            std::vector<std::uint32_t> candidates = layer.postingsOf(required[0]);
+            for (std::size_t w = 1; w < required.size() && !candidates.empty(); ++w) {
+                std::vector<std::uint32_t> postings = layer.postingsOf(required[w]);
+                std::vector<std::uint32_t> both;
+                std::set_intersection(candidates.begin(), candidates.end(), postings.begin(), postings.end(),
+                                      std::back_inserter(both));
+                candidates.swap(both);
+            }
+            for (std::uint32_t i : candidates) {
+                if (i < layer.count && matches(layer.message(i))) result.push_back(layer.id(i));
+            }
+        }
+        std::sort(result.begin(), result.end());
+        result.erase(std::unique(result.begin(), result.end()), result.end());
+        return result;
+    }
+
+    std::vector<std::string> MessageIndex::containing(const std::string& text) const {
+        // A word of `text` that does not touch either end is a whole word of
+        // any message containing `text`
+        std::vector<std::string> required;
+        for (const auto& [begin, end] : wordsIn(text)) {
+            if (begin > 0 && end < text.size()) required.push_back(lowered(std::string_view(text).substr(begin, end - begin)));
+        }
+        std::sort(required.begin(), required.end());
+        required.erase(std::unique(required.begin(), required.end()), required.end());
+        return search(required, [&](std::string_view message) { return message.find(text) != std::string_view::npos; });
+    }
+
+    std::vector<std::string> MessageIndex::withWords(const std::string& words) const {
+        std::vector<std::string> required;
+        for (const auto& [begin, end] : wordsIn(words)) {
+            required.push_back(lowered(std::string_view(words).substr(begin, end - begin)));
+        }
+        if (required.empty()) return {};
+        std::sort(required.begin(), required.end());
+        required.erase(std::unique(required.begin(), required.end()), required.end());
+        return search(required, [](std::string_view) { return true; });
+    }
+
+    std::size_t MessageIndex::write(const Repository& repo, const ObjectStore& store) {
+        // Every commit is read once, so parse in place instead of filling
+        // the object cache
+        std::vector<std::string> ids = store.list(ObjectKind::Commit);
+        std::vector<Entry> entries(ids.size());
+        store.scanCommits(ids, [&](std::size_t i, const CommitView* commit) {
+            if (commit) entries[i] = Entry(ids[i], std::string(indexedMessage(commit->message)));   // malformed commits are not indexed
+        });
+        entries.erase(std::remove_if(entries.begin(), entries.end(), [](const Entry& e) { return e.first.empty(); }),
+                      entries.end());
+
+        MessageIndex empty;
+        std::size_t count = entries.size();
+        writeChain(repo, empty, entries);
+        return count;
+    }
+
+    void MessageIndex::update(const Repository& repo, const ObjectStore& store, const std::vector<std::string>& commits) {
+        MessageIndex index(repo);
+        if (!index.exists()) {
+            write(repo, store);
+            return;
+        }
+
+        // The new commits and the ancestors the index has not seen
+        std::vector<Entry> entries;
+        std::unordered_set<std::string> seen;
+        std::vector<std::string> stack(commits.begin(), commits.end());
+        while (!stack.empty()) {
+            std::string id = std::move(stack.back());
+            stack.pop_back();
+            if (!seen.insert(id).second || index.contains(id)) continue;
+            auto commit = store.commit(id);
+            if (!commit) continue;
+            entries.emplace_back(id, std::string(indexedMessage(commit->view.message)));
+            stack.insert(stack.end(), commit->parents.begin(), commit->parents.end());
+        }
+        if (!entries.empty()) writeChain(repo, index, entries);
+    }
+
+    // Write `entries` as a new layer on top of `base` and make the chain
+    // point at base's remaining layers plus the new one.
+    void MessageIndex::writeChain(const Repository& repo, MessageIndex& base, std::vector<Entry>& entries) {
+        std::vector<std::size_t> sizes;
+        for (const Layer& layer : base.layers_) sizes.push_back(layer.count);
+        for (std::size_t folded = LayerChain::foldCount(sizes, entries.size()); folded > 0; --folded) {
+            const Layer& top = base.layers_.back();
+            for (std::uint32_t i = 0; i < top.count; ++i) entries.emplace_back(top.id(i), std::string(top.message(i)));
+            base.layers_.pop_back();
+        }
+        std::sort(entries.begin(), entries.end());
+        entries.erase(std::unique(entries.begin(), entries.end(),
+                                  [](const Entry& a, const Entry& b) { return a.first == b.first; }),
+                      entries.end());
+
+        LayerChain chain = chainOf(repo);
+        std::vector<std::string> names;
+        for (const Layer& layer : base.layers_) names.push_back(layer.name);
+
+        if (!entries.empty()) {
+            auto count = static_cast<std::uint32_t>(entries.size());
+            std::map<std::string, std::vector<std::uint32_t>> words;
+            std::vector<std::pair<std::uint64_t, std::uint32_t>> hashes;
+            std::uint64_t messageBytes = 0;
+            for (std::uint32_t i = 0; i < count; ++i) {
+                const std::string& message = entries[i].second;
+                hashes.emplace_back(messageHash(message), i);
+                messageBytes += message.size();
+                for (const auto& [begin, end] : wordsIn(message)) {
+                    auto& postings = words[lowered(std::string_view(message).substr(begin, end - begin))];
+                    if (postings.empty() || postings.back() != i) postings.push_back(i);
+                }
+            }
+            std::sort(hashes.begin(), hashes.end());
+            std::uint64_t postingCount = 0, wordBytes = 0;
+            for (const auto& [word, postings] : words) {
+                postingCount += postings.size();
+                wordBytes += word.size();
+            }
+
+            std::vector<unsigned char> out(INDEX_MAGIC, INDEX_MAGIC + 4);
+            putBE32(out, INDEX_VERSION);
+            putBE32(out, count);
+            putBE32(out, static_cast<std::uint32_t>(words.size()));
+            putBE64(out, postingCount);
+            putBE64(out, wordBytes);
+            putBE64(out, messageBytes);
+            for (const Entry& entry : entries) {
+                unsigned char raw[RAW_ID];
+                fromHex(entry.first, raw);
+                out.insert(out.end(), raw, raw + RAW_ID);
+            }
+            std::uint64_t offset = 0;
+            for (const Entry& entry : entries) {
+                putBE64(out, offset);
+                offset += entry.second.size();
+            }
+            putBE64(out, offset);
+            for (const auto& [hash, i] : hashes) {
+                putBE64(out, hash);
+                putBE32(out, i);
+            }
+            std::uint32_t wordOffset = 0, firstPosting = 0;
+            for (const auto& [word, postings] : words) {
+                putBE32(out, wordOffset);
+                putBE32(out, static_cast<std::uint32_t>(word.size()));
+                putBE32(out, firstPosting);
+                putBE32(out, static_cast<std::uint32_t>(postings.size()));
+                wordOffset += static_cast<std::uint32_t>(word.size());
+                firstPosting += static_cast<std::uint32_t>(postings.size());
+            }
+            for (const auto& word : words) out.insert(out.end(), word.first.begin(), word.first.end());
+            for (const auto& word : words) {
+                for (std::uint32_t i : word.second) putBE32(out, i);
+            }
+            for (const Entry& entry : entries) out.insert(out.end(), entry.second.begin(), entry.second.end());
+            putTrailer(out);
+
+            names.push_back(chain.writeLayer(out));
+        }
+        chain.writeChain(names);
+    }
+
+} // namespace gitcpp
@@ -0,0 +1,98 @@
+#pragma once
+#include "ObjectStore.hpp"
+#include "Repository.hpp"
+#include "Utils.hpp"
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace gitcpp {
+
+    /// Commit message index (`message-index/`) for `find`: every commit's
+    /// message, an exact-message hash table and a word inverted index, so
+    /// searches never open commit objects.
+    ///
+    /// Like the commit-graph, the index is a chain of layer files listed
+    /// base first in `message-index/chain`; commits are added as a new
+    /// layer that absorbs the small layers on top. A layer is "GCMI",
+    /// version, commit, word and posting counts, word and message bytes,
+    /// the sorted raw commit ids, message offsets, (message hash, commit)
+    /// pairs sorted by hash, one (offset, length, first posting, postings)
+    /// entry per word sorted by word, the word bytes, the postings (commit
+    /// numbers, ascending), the messages and a SHA-1 trailer.
+    ///
+    /// Messages are stored without their trailing newline. Words are runs
+    /// of ASCII letters and digits and non-ASCII bytes, lowercased.
+    class MessageIndex {
+    public:
+        /// Load the index of `repo`; exists() is false if it has none.
+        /// Throws if a layer does not match its trailer.
+        explicit MessageIndex(const Repository& repo);
+
+        bool exists() const { return exists_; }
+        std::size_t size() const;
+
+        bool contains(const std::string& id) const;
+
+        /// Commits whose message is exactly `message`, sorted.
+        std::vector<std::string> exact(const std::string& message) const;
+
+        /// Commits whose message contains `text` (case-sensitive), sorted.
+        /// The words lying wholly inside `text` narrow the candidates;
+        /// without any, every message is scanned.
+        std::vector<std::string> containing(const std::string& text) const;
+
+        /// Commits whose message has every word of `words` (any case),
+        /// sorted.
+        std::vector<std::string> withWords(const std::string& words) const;
+
+        /// Rewrite the index as a single layer holding every commit in
+        /// `store`. Returns the number of commits indexed.
+        static std::size_t write(const Repository& repo, const ObjectStore& store);
+
+        /// Add `commits`, and any ancestors the index does not know yet.
+        /// Builds the whole index if there is none.
+        static void update(const Repository& repo, const ObjectStore& store, const std::vector<std::string>& commits);
+
+    private:
+        struct Layer {
+            std::string name;
+            MappedFile map;
+            std::uint32_t count = 0;
+            std::uint32_t wordCount = 0;
+            std::uint64_t postingCount = 0;
+            std::uint64_t wordByteCount = 0;
+            std::uint64_t messageBytes = 0;
+            const unsigned char* ids = nullptr;
+            const unsigned char* offsets = nullptr;
+            const unsigned char* hashes = nullptr;
+            const unsigned char* words = nullptr;
+            const unsigned char* wordBytes = nullptr;
+            const unsigned char* postings = nullptr;
+            const unsigned char* messages = nullptr;
+
+            std::string id(std::uint32_t i) const;
+            std::string_view message(std::uint32_t i) const;
+            std::vector<std::uint32_t> postingsOf(std::string_view word) const;
+        };
+
+        using Entry = std::pair<std::string, std::string>;      // (commit id, message)
+
+        MessageIndex() = default;
+
+        static void writeChain(const Repository& repo, MessageIndex& base, std::vector<Entry>& entries);
+
+        // Commits having every word in `required` (every commit if it is
+        // empty) whose message passes `matches`, sorted
+        std::vector<std::string> search(const std::vector<std::string>& required,
+                                        const std::function<bool(std::string_view)>& matches) const;
+
+        bool exists_ = false;
+        std::vector<Layer> layers_;
+    };
+
+} // namespace gitcpp
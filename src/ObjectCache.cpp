@@ -0,0 +1,40 @@
+#include "ObjectCache.hpp"
+
+#include <map>
+
+namespace gitcpp {
+
+    namespace {
+
+        std::mutex cachesMutex;
+
+        // Relative and absolute spellings of a directory share one cache
+        std::filesystem::path cacheKey(const std::filesystem::path& gitcppDir) {
+            return std::filesystem::absolute(gitcppDir).lexically_normal();
+        }
+
+        std::map<std::filesystem::path, std::shared_ptr<ObjectCache>>& caches() {
+            static std::map<std::filesystem::path, std::shared_ptr<ObjectCache>> all;
+            return all;
+        }
+
+    } // namespace
+
+    std::shared_ptr<ObjectCache> ObjectCache::forRepository(const std::filesystem::path& gitcppDir, std::size_t capacity) {
+        std::lock_guard<std::mutex> lock(cachesMutex);
+        std::shared_ptr<ObjectCache>& cache = caches()[cacheKey(gitcppDir)];
+        if (!cache) {
+            cache = std::make_shared<ObjectCache>(capacity);
+        } else {
+            cache->commits.setCapacity(capacity / 2);
+            cache->trees.setCapacity(capacity / 2);
+        }
+        return cache;
+    }
+
+    void ObjectCache::forget(const std::filesystem::path& gitcppDir) {
+        std::lock_guard<std::mutex> lock(cachesMutex);
+        caches().erase(cacheKey(gitcppDir));
+    }
+
+} // namespace gitcpp
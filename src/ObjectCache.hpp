@@ -0,0 +1,89 @@
+#pragma once
+#include "Objects.hpp"
+
+#include <cstddef>
+#include <filesystem>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace gitcpp {
+
+    /// Thread-safe least-recently-used map from object id to a decoded
+    /// object, bounded by the approximate number of bytes it holds.
+    template <typename Value>
+    class LruCache {
+    public:
+        explicit LruCache(std::size_t capacity) : capacity_(capacity) {}
+
+        std::shared_ptr<const Value> get(const std::string& id) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = index_.find(id);
+            if (it == index_.end()) return nullptr;
+            order_.splice(order_.begin(), order_, it->second);
+            return it->second->value;
+        }
+
+        void put(const std::string& id, std::shared_ptr<const Value> value, std::size_t cost) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (cost > capacity_ || index_.count(id)) return;
+            order_.push_front(Slot{id, std::move(value), cost});
+            index_.emplace(id, order_.begin());
+            size_ += cost;
+            while (size_ > capacity_) {
+                size_ -= order_.back().cost;
+                index_.erase(order_.back().id);
+                order_.pop_back();
+            }
+        }
+
+        void setCapacity(std::size_t capacity) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            capacity_ = capacity;
+            while (size_ > capacity_) {
+                size_ -= order_.back().cost;
+                index_.erase(order_.back().id);
+                order_.pop_back();
+            }
+        }
+
+        std::size_t size() const {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return index_.size();
+        }
+
+    private:
+        struct Slot {
+            std::string id;
+            std::shared_ptr<const Value> value;
+            std::size_t cost;
+        };
+
+        mutable std::mutex mutex_;
+        std::size_t capacity_;
+        std::size_t size_ = 0;
+        std::list<Slot> order_;
+        std::unordered_map<std::string, typename std::list<Slot>::iterator> index_;
+    };
+
+    /// Decoded commits and trees of one repository, shared by every
+    /// ObjectStore opened on it in this process. Objects are immutable, so
+    /// entries never go stale; they are only evicted.
+    struct ObjectCache {
+        explicit ObjectCache(std::size_t capacity) : commits(capacity / 2), trees(capacity / 2) {}
+
+        LruCache<CommitInfo> commits;
+        LruCache<TreeInfo> trees;
+
+        /// The cache for the repository at `gitcppDir`, created with
+        /// `capacity` bytes on first use (later calls resize it).
+        static std::shared_ptr<ObjectCache> forRepository(const std::filesystem::path& gitcppDir, std::size_t capacity);
+
+        /// Drop the cache of a repository whose objects were replaced
+        /// (re-initialised) or deleted.
+        static void forget(const std::filesystem::path& gitcppDir);
+    };
+
+} // namespace gitcpp
@@ -0,0 +1,660 @@
+#include "ObjectStore.hpp"
+#include "Utils.hpp"
+
+#include <unistd.h>
+#include <zlib.h>
+
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <set>
+
+namespace fs = std::filesystem;
+
+namespace gitcpp {
+
+    namespace {
+
+        constexpr unsigned char LOOSE_MAGIC[4] = {'G', 'C', 'Z', '1'};
+        constexpr std::size_t LOOSE_HEADER = 12;
+        constexpr std::size_t READ_CHUNK = 64 * 1024;
+        // Files at least this big are added through the streaming path
+        constexpr std::uint64_t STREAM_THRESHOLD = 8 << 20;
+        constexpr std::size_t STREAM_CHUNK = 1 << 20;
+        constexpr int FANOUT_DIRS = 256;
+        constexpr const char* LAYOUT_FANOUT = "fanout";
+
+        std::string fanoutName(int i) {
+            static const char digits[] = "0123456789abcdef";
+            return std::string{digits[i >> 4], digits[i & 0x0f]};
+        }
+
+        constexpr std::size_t DEFAULT_CACHE_MB = 64;
+
+        std::size_t parseCacheSize(const std::string& value) {
+            if (value.empty()) return DEFAULT_CACHE_MB << 20;
+            try {
+                long megabytes = std::stol(value);
+                if (megabytes >= 0) return static_cast<std::size_t>(megabytes) << 20;
+            } catch (const std::exception&) {
+            }
+            throw error("Invalid core.objectCacheSize value: " + value);
+        }
+
+        FsyncMode parseFsyncMode(const std::string& value) {
+            if (value.empty() || value == "off") return FsyncMode::Off;
+            if (value == "batch") return FsyncMode::Batch;
+            if (value == "always") return FsyncMode::Always;
+            throw error("Invalid core.fsync value: " + value);
+        }
+
+        int parseCompressionLevel(const std::string& value) {
+            if (value.empty()) return Z_DEFAULT_COMPRESSION;
+            try {
+                int level = std::stoi(value);
+                if (level >= Z_NO_COMPRESSION && level <= Z_BEST_COMPRESSION) return level;
+            } catch (const std::exception&) {
+            }
+            throw error("Invalid core.compression value: " + value);
+        }
+
+        std::vector<unsigned char> deflateLoose(const unsigned char* data, std::size_t size, int level) {
+            uLongf bound = compressBound(size);
+            std::vector<unsigned char> out(LOOSE_HEADER + bound);
+            std::memcpy(out.data(), LOOSE_MAGIC, 4);
+            std::vector<unsigned char> sizeBytes;
+            putBE64(sizeBytes, size);
+            std::memcpy(out.data() + 4, sizeBytes.data(), 8);
+            if (compress2(out.data() + LOOSE_HEADER, &bound, data, size, level) != Z_OK) {
+                throw error("Could not compress object");
+            }
+            out.resize(LOOSE_HEADER + bound);
+            return out;
+        }
+
+        // True if `data` starts like a compressed loose object. Raw objects
+        // never do: they are compressed (at level 0 if need be) instead.
+        bool hasLooseMagic(const unsigned char* data, std::size_t size) {
+            return size >= 4 && std::memcmp(data, LOOSE_MAGIC, 4) == 0;
+        }
+
+        // Read the header of a loose object from `in`. Returns false for
+        // files without the magic, which are raw objects (written with
+        // compression level 0 or by older versions), and throws for a
+        // damaged header.
+        bool readLooseHeader(std::istream& in, const fs::path& file, std::uint64_t& size) {
+            unsigned char header[LOOSE_HEADER];
+            in.read(reinterpret_cast<char*>(header), LOOSE_HEADER);
+            if (!hasLooseMagic(header, static_cast<std::size_t>(in.gcount()))) {
+                return false;
+            }
+
+            // zlib cannot expand input by more than ~1032:1
+            size = getBE64(header + 4);
+            if (static_cast<std::size_t>(in.gcount()) != LOOSE_HEADER || size / 1032 > fs::file_size(file)) {
+                throw error("Corrupt object: " + file.string());
+            }
+            return true;
+        }
+
+        // Inflate a loose object chunk by chunk straight into its final
+        // buffer, stopping after its first `limit` bytes. Files without the
+        // magic are raw objects.
+        std::vector<unsigned char> inflateLoose(const fs::path& file, std::uint64_t limit = UINT64_MAX) {
+            std::ifstream in(file, std::ios::binary);
+            if (!in) {
+                throw error("Could not open file: " + file.string());
+            }
+            std::uint64_t size;
+            if (!readLooseHeader(in, file, size)) {
+                if (limit == UINT64_MAX) return readContents(file);
+                std::vector<unsigned char> out(static_cast<std::size_t>(limit));
+                in.clear();
+                in.seekg(0);
+                in.read(reinterpret_cast<char*>(out.data()), static_cast<std::streamsize>(out.size()));
+                out.resize(static_cast<std::size_t>(in.gcount()));
+                return out;
+            }
+            std::uint64_t wanted = std::min(size, limit);
+            std::vector<unsigned char> out(wanted);
+            std::vector<unsigned char> chunk(READ_CHUNK);
+            z_stream zs{};
+            if (inflateInit(&zs) != Z_OK) {
+                throw error("Could not initialise zlib");
+            }
+            unsigned char empty = 0;
+            zs.next_out = wanted > 0 ? out.data() : &empty;
+
+            int ret = Z_OK;
+            while (ret != Z_STREAM_END && (zs.total_out < wanted || wanted == size)) {
+                in.read(reinterpret_cast<char*>(chunk.data()), chunk.size());
+                std::streamsize n = in.gcount();
+                if (n <= 0) break;
+                zs.next_in = chunk.data();
+                zs.avail_in = static_cast<uInt>(n);
+                while (zs.avail_in > 0 && ret != Z_STREAM_END && (zs.total_out < wanted || wanted == size)) {
+                    std::uint64_t remaining = wanted - zs.total_out;
+                    zs.avail_out = static_cast<uInt>(std::min<std::uint64_t>(remaining, UINT_MAX));
+                    ret = inflate(&zs, Z_NO_FLUSH);
+                    if (ret != Z_OK && ret != Z_STREAM_END) break;
+                }
+                if (ret != Z_OK && ret != Z_STREAM_END) break;
+            }
+            std::uint64_t produced = zs.total_out;
+            inflateEnd(&zs);
+            // A full read must end the stream; a partial one just fills the buffer
+            bool complete = wanted == size ? ret == Z_STREAM_END : ret == Z_OK;
+            if (!complete || produced != wanted) {
+                throw error("Corrupt object: " + file.string());
+            }
+            return out;
+        }
+
+    } // namespace
+
+    ObjectStore::ObjectStore(const Repository& repo)
+        : blobs_(repo.BLOBS), commits_(repo.COMMITS), packsDir_(repo.PACKS),
+          compressionLevel_(parseCompressionLevel(repo.getConfig("core.compression"))),
+          pool_(&ThreadPool::shared(repo)),
+          cache_(ObjectCache::forRepository(repo.GITCPP_DIR, parseCacheSize(repo.getConfig("core.objectCacheSize")))) {
+        setFsyncMode(parseFsyncMode(repo.getConfig("core.fsync")));
+        if (!fs::exists(repo.LAYOUT) || readContentsAsString(repo.LAYOUT) != LAYOUT_FANOUT) {
+            migrateToFanout();
+            writeContents(repo.LAYOUT, LAYOUT_FANOUT);
+        }
+        loadPacks();
+    }
+
+    void ObjectStore::migrateToFanout() const {
+        for (const fs::path& dir : {blobs_, commits_}) {
+            for (const std::string& name : plainFilenamesIn(dir)) {
+                if (!isObjectId(name)) continue;
+                fs::path target = dir / name.substr(0, 2) / name.substr(2);
+                fs::create_directories(target.parent_path());
+                fs::rename(dir / name, target);
+            }
+        }
+    }
+
+    void ObjectStore::loadPacks() {
+        packs_.clear();
+        if (!fs::is_directory(packsDir_)) return;
+        for (const std::string& name : plainFilenamesIn(packsDir_)) {
+            if (name.rfind("pack-", 0) != 0) continue;
+            fs::path idx = packsDir_ / name;
+            if (idx.extension() != ".idx") continue;
+            packs_.push_back(std::make_unique<Pack>(fs::path(idx).replace_extension(".pack")));
+        }
+    }
+
+    fs::path ObjectStore::loosePath(ObjectKind kind, const std::string& id) const {
+        const fs::path& dir = kind == ObjectKind::Commit ? commits_ : blobs_;
+        if (!isObjectId(id)) return dir / id;   // never matches a stored object
+        return dir / id.substr(0, 2) / id.substr(2);
+    }
+
+    bool ObjectStore::contains(ObjectKind kind, const std::string& id) const {
+        if (id.empty()) return false;
+        if (fs::is_regular_file(loosePath(kind, id))) return true;
+        for (const auto& pack : packs_) {
+            if (pack->contains(kind, id)) return true;
+        }
+        return false;
+    }
+
+    std::vector<unsigned char> ObjectStore::read(ObjectKind kind, const std::string& id) const {
+        fs::path loose = loosePath(kind, id);
+        if (!id.empty() && fs::is_regular_file(loose)) {
+            return inflateLoose(loose);
+        }
+        std::vector<unsigned char> out;
+        for (const auto& pack : packs_) {
+            ObjectKind packedKind;
+            if (pack->read(id, packedKind, out) && packedKind == kind) {
+                return out;
+            }
+        }
+        throw error("Object not found: " + id);
+    }
+
+    std::vector<unsigned char> ObjectStore::readPrefix(ObjectKind kind, const std::string& id, std::size_t size) const {
+        fs::path loose = loosePath(kind, id);
+        if (!id.empty() && fs::is_regular_file(loose)) {
+            return inflateLoose(loose, size);
+        }
+        std::vector<unsigned char> out;
+        for (const auto& pack : packs_) {
+            ObjectKind packedKind;
+            if (pack->read(id, packedKind, out, size) && packedKind == kind) {
+                return out;
+            }
+        }
+        throw error("Object not found: " + id);
+    }
+
+    std::string ObjectStore::readAsString(ObjectKind kind, const std::string& id) const {
+        auto bytes = read(kind, id);
+        return std::string(bytes.begin(), bytes.end());
+    }
+
+    void ObjectStore::checkout(const std::string& id, const fs::path& target) const {
+        fs::path loose = loosePath(ObjectKind::Blob, id);
+        if (!id.empty() && fs::is_regular_file(loose)) {
+            std::ifstream in(loose, std::ios::binary);
+            std::uint64_t size;
+            if (in && !readLooseHeader(in, loose, size)) {
+                in.close();
+                copyContents(loose, target);
+                return;
+            }
+        }
+        writeContents(target, read(ObjectKind::Blob, id));
+    }
+
+    std::shared_ptr<const CommitInfo> ObjectStore::commit(const std::string& id) const {
+        if (auto cached = cache_->commits.get(id)) return cached;
+        if (!contains(ObjectKind::Commit, id)) return nullptr;
+        auto decoded = std::make_shared<CommitInfo>();
+        if (!parseCommit(readAsString(ObjectKind::Commit, id), *decoded)) return nullptr;
+        cache_->commits.put(id, decoded, decoded->contents.size() + decoded->parents.size() * 48 + 128);
+        return decoded;
+    }
+
+    void ObjectStore::scanCommits(const std::vector<std::string>& ids,
+                                  const std::function<void(std::size_t, const CommitView*)>& visit) const {
+        // A few runs per thread keep the load even without handing out
+        // commits one at a time
+        std::size_t runs = std::min(ids.size(), std::size_t(pool_->size()) * 8);
+        pool_->parallelFor(runs, [&](std::size_t run) {
+            std::size_t begin = ids.size() * run / runs;
+            std::size_t end = ids.size() * (run + 1) / runs;
+            std::vector<unsigned char> bytes;
+            for (std::size_t i = begin; i < end; ++i) {
+                try {
+                    bytes = read(ObjectKind::Commit, ids[i]);
+                } catch (const GitcppException&) {
+                    if (contains(ObjectKind::Commit, ids[i])) throw;
+                    continue;       // removed since it was listed
+                }
+                CommitView commit;
+                bool parsed = parseCommit(std::string_view(reinterpret_cast<const char*>(bytes.data()), bytes.size()), commit);
+                visit(i, parsed ? &commit : nullptr);
+            }
+        });
+    }
+
+    std::shared_ptr<const TreeInfo> ObjectStore::tree(const std::string& id) const {
+        if (auto cached = cache_->trees.get(id)) return cached;
+        if (!contains(ObjectKind::Blob, id)) return nullptr;
+        auto decoded = std::make_shared<TreeInfo>(parseTree(readAsString(ObjectKind::Blob, id)));
+        std::size_t cost = 64;
+        for (const TreeEntry& entry : decoded->entries) cost += entry.name.size() + entry.id.size() + 48;
+        cache_->trees.put(id, decoded, cost);
+        return decoded;
+    }
+
+    void ObjectStore::write(ObjectKind kind, const std::string& id, const std::vector<unsigned char>& data) const {
+        fs::path loose = loosePath(kind, id);
+        if (freshen(loose)) return;
+        if (!fs::is_directory(loose.parent_path())) {
+            fs::create_directories(loose.parent_path());
+        }
+        if (compressionLevel_ == Z_NO_COMPRESSION && !hasLooseMagic(data.data(), data.size())) {
+            writeDurable(loose, true, data);
+            return;
+        }
+        writeDurable(loose, true, deflateLoose(data.data(), data.size(), compressionLevel_));
+    }
+
+    void ObjectStore::write(ObjectKind kind, const std::string& id, const std::string& data) const {
+        write(kind, id, std::vector<unsigned char>(data.begin(), data.end()));
+    }
+
+    bool ObjectStore::freshen(const fs::path& loose) const {
+        // prune() goes by modification time, so an object written again
+        // must look new. An empty loose file is what an unflushed write
+        // looks like after a crash; it is rewritten rather than trusted.
+        // Packed objects get a fresh loose copy instead, since touching the
+        // pack would make every object in it look new.
+        std::error_code ec;
+        auto size = fs::file_size(loose, ec);
+        if (ec || size == 0) return false;
+        fs::last_write_time(loose, fs::file_time_type::clock::now(), ec);
+        return true;
+    }
+
+    std::string ObjectStore::writeFile(ObjectKind kind, const fs::path& file) const {
+        std::uint64_t size = fs::file_size(file);
+        if (size >= STREAM_THRESHOLD) {
+            return writeFileStreaming(kind, file, size);
+        }
+        auto bytes = readContents(file);
+        std::string id = sha1(bytes);
+        write(kind, id, bytes);
+        return id;
+    }
+
+    std::string ObjectStore::writeFileStreaming(ObjectKind kind, const fs::path& file, std::uint64_t size) const {
+        std::ifstream in(file, std::ios::binary);
+        if (!in) {
+            throw error("Could not open file: " + file.string());
+        }
+
+        // The id is only known at the end, so the object goes to a
+        // temporary file that is renamed into place
+        static std::atomic<unsigned> counter{0};
+        fs::path dir = kind == ObjectKind::Commit ? commits_ : blobs_;
+        fs::path tmp = dir / ("tmp_" + std::to_string(::getpid()) + "_" + std::to_string(counter++));
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            throw error("Could not open for writing: " + tmp.string());
+        }
+
+        // Raw objects must not start like compressed ones
+        unsigned char magic[4];
+        in.read(reinterpret_cast<char*>(magic), 4);
+        bool compressed = compressionLevel_ != Z_NO_COMPRESSION || hasLooseMagic(magic, static_cast<std::size_t>(in.gcount()));
+        in.clear();
+        in.seekg(0);
+        z_stream zs{};
+        if (compressed) {
+            unsigned char header[LOOSE_HEADER];
+            std::memcpy(header, LOOSE_MAGIC, 4);
+            std::vector<unsigned char> sizeBytes;
+            putBE64(sizeBytes, size);
+            std::memcpy(header + 4, sizeBytes.data(), 8);
+            out.write(reinterpret_cast<const char*>(header), LOOSE_HEADER);
+            if (deflateInit(&zs, compressionLevel_) != Z_OK) {
+                throw error("Could not initialise zlib");
+            }
+        }
+
+        Sha1 hash;
+        std::uint64_t total = 0;
+        std::vector<unsigned char> input(STREAM_CHUNK);
+        std::vector<unsigned char> output(STREAM_CHUNK);
+        try {
+            bool done = false;
+            while (!done) {
+                in.read(reinterpret_cast<char*>(input.data()), static_cast<std::streamsize>(input.size()));
+                std::size_t n = static_cast<std::size_t>(in.gcount());
+                done = !in;
+                if (in.bad()) {
+                    throw error("Could not read file: " + file.string());
+                }
+                hash.update(input.data(), n);
+                total += n;
+                if (!compressed) {
+                    out.write(reinterpret_cast<const char*>(input.data()), static_cast<std::streamsize>(n));
+                    continue;
+                }
+                zs.next_in = input.data();
+                zs.avail_in = static_cast<uInt>(n);
+                int ret;
+                do {
+                    zs.next_out = output.data();
+                    zs.avail_out = static_cast<uInt>(output.size());
+                    ret = deflate(&zs, done ? Z_FINISH : Z_NO_FLUSH);
+                    if (ret == Z_STREAM_ERROR) {
+                        throw error("Could not compress object");
+                    }
+                    out.write(reinterpret_cast<const char*>(output.data()),
+                              static_cast<std::streamsize>(output.size() - zs.avail_out));
+                } while (zs.avail_out == 0 || (done && ret != Z_STREAM_END));
+            }
+            if (compressed) deflateEnd(&zs);
+            out.close();
+            if (!out) {
+                throw error("Error while writing to: " + tmp.string());
+            }
+            // The loose header already promised `size` bytes
+            if (total != size) {
+                throw error("File changed while it was being added: " + file.string());
+            }
+
+            std::string id = hash.hexDigest();
+            fs::path loose = loosePath(kind, id);
+            fs::create_directories(loose.parent_path());
+            if (freshen(loose)) {
+                fs::remove(tmp);
+            } else {
+                durableRename(tmp, loose, true);
+            }
+            return id;
+        } catch (...) {
+            if (compressed) deflateEnd(&zs);
+            out.close();
+            std::error_code ignored;
+            fs::remove(tmp, ignored);
+            throw;
+        }
+    }
+
+    std::vector<std::string> ObjectStore::looseIds(ObjectKind kind) const {
+        const fs::path& dir = kind == ObjectKind::Commit ? commits_ : blobs_;
+
+        // Fan-out directories are listed in parallel and concatenated in
+        // order, so the result comes out sorted.
+        std::vector<std::vector<std::string>> parts(FANOUT_DIRS);
+        pool_->parallelFor(FANOUT_DIRS, [&](std::size_t i) {
+            std::string prefix = fanoutName(static_cast<int>(i));
+            for (const std::string& name : plainFilenamesIn(dir / prefix)) {
+                std::string id = prefix + name;
+                if (isObjectId(id)) parts[i].push_back(std::move(id));
+            }
+        });
+
+        std::vector<std::string> ids;
+        for (auto& part : parts) ids.insert(ids.end(), part.begin(), part.end());
+        return ids;
+    }
+
+    std::vector<std::string> ObjectStore::recent(ObjectKind kind, fs::file_time_type cutoff) const {
+        std::vector<std::string> loose = looseIds(kind);
+        std::vector<char> isRecent(loose.size(), 0);
+        pool_->parallelFor(loose.size(), [&](std::size_t i) {
+            std::error_code ec;
+            auto written = fs::last_write_time(loosePath(kind, loose[i]), ec);
+            isRecent[i] = !ec && written >= cutoff;
+        });
+
+        std::vector<std::string> ids;
+        for (std::size_t i = 0; i < loose.size(); ++i) {
+            if (isRecent[i]) ids.push_back(std::move(loose[i]));
+        }
+        for (const auto& pack : packs_) {
+            std::error_code ec;
+            auto written = fs::last_write_time(pack->path(), ec);
+            if (ec || written < cutoff) continue;
+            auto packed = pack->ids(kind);
+            ids.insert(ids.end(), packed.begin(), packed.end());
+        }
+        std::sort(ids.begin(), ids.end());
+        ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+        return ids;
+    }
+
+    std::vector<std::string> ObjectStore::list(ObjectKind kind) const {
+        std::vector<std::string> ids = looseIds(kind);
+        for (const auto& pack : packs_) {
+            auto packed = pack->ids(kind);
+            ids.insert(ids.end(), packed.begin(), packed.end());
+        }
+        std::sort(ids.begin(), ids.end());
+        ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+        return ids;
+    }
+
+    void ObjectStore::hintNames(std::vector<PackInput>& objects, const std::map<std::string, std::size_t>& positions) const {
+        // Name hints: every tree gets the same hint, every blob the path it
+        // was committed under, so successive versions of a file are
+        // considered as delta bases for each other. Subtrees shared between
+        // commits are walked once.
+        std::set<std::string> walked;
+        std::function<void(const std::string&, const std::string&)> walk =
+            [&](const std::string& treeId, const std::string& prefix) {
+                if (!walked.insert(treeId).second) return;
+                auto decoded = tree(treeId);
+                if (!decoded) return;
+                auto packed = positions.find(treeId);
+                if (packed != positions.end()) objects[packed->second].nameHint = "\x01tree";
+
+                for (const TreeEntry& entry : decoded->entries) {
+                    if (entry.isTree) {
+                        walk(entry.id, prefix + entry.name + "/");
+                        continue;
+                    }
+                    auto blob = positions.find(entry.id);
+                    if (blob != positions.end()) objects[blob->second].nameHint = prefix + entry.name;
+                }
+            };
+        for (const std::string& commitId : list(ObjectKind::Commit)) {
+            if (auto decoded = commit(commitId)) walk(decoded->tree, "");
+        }
+    }
+
+    PackStats ObjectStore::repack(bool all) {
+        std::vector<PackInput> objects;
+        std::vector<fs::path> looseFiles;
+        std::map<std::string, std::size_t> seen;
+
+        auto collect = [&](ObjectKind kind, const std::string& id) {
+            if (seen.count(id)) return;
+            seen[id] = objects.size();
+            objects.push_back(PackInput{id, kind, read(kind, id), ""});
+        };
+
+        for (ObjectKind kind : {ObjectKind::Commit, ObjectKind::Blob}) {
+            for (const std::string& id : looseIds(kind)) {
+                collect(kind, id);
+                looseFiles.push_back(loosePath(kind, id));
+            }
+            if (all) {
+                for (const auto& pack : packs_) {
+                    for (const std::string& id : pack->ids(kind)) collect(kind, id);
+                }
+            }
+        }
+
+        hintNames(objects, seen);
+        PackStats stats = writePack(packsDir_, objects, compressionLevel_);
+        if (stats.objects == 0) return stats;
+
+        std::vector<fs::path> oldPacks;
+        if (all) {
+            for (const auto& pack : packs_) {
+                if (pack->path().stem() != stats.name) oldPacks.push_back(pack->path());
+            }
+        }
+        packs_.clear();
+        for (const fs::path& file : looseFiles) fs::remove(file);
+        for (const fs::path& pack : oldPacks) {
+            fs::remove(fs::path(pack).replace_extension(".idx"));
+            fs::remove(pack);
+        }
+        loadPacks();
+        return stats;
+    }
+
+    PruneStats ObjectStore::prune(const std::function<bool(ObjectKind, const std::string&)>& keep,
+                                  fs::file_time_type cutoff) {
+        PruneStats stats;
+
+        // Loose objects: each file is checked and deleted on its own
+        std::atomic<std::size_t> pruned{0};
+        std::atomic<std::size_t> recent{0};
+        std::atomic<std::uint64_t> bytes{0};
+        for (ObjectKind kind : {ObjectKind::Commit, ObjectKind::Blob}) {
+            std::vector<std::string> ids = looseIds(kind);
+            pool_->parallelFor(ids.size(), [&](std::size_t i) {
+                if (keep(kind, ids[i])) return;
+                fs::path file = loosePath(kind, ids[i]);
+                std::error_code ec;
+                auto written = fs::last_write_time(file, ec);
+                if (ec) return;
+                if (written >= cutoff) {
+                    ++recent;
+                    return;
+                }
+                std::uintmax_t size = fs::file_size(file, ec);
+                if (ec || !fs::remove(file, ec)) return;
+                ++pruned;
+                bytes += size;
+            });
+        }
+        stats.pruned = pruned;
+        stats.recent = recent;
+        stats.bytes = bytes;
+
+        // Temporaries of streamed objects and packs are only left behind by
+        // a crash; once past the cutoff no writer can still be using them
+        for (const fs::path& dir : {blobs_, commits_, packsDir_}) {
+            for (const std::string& name : plainFilenamesIn(dir)) {
+                if (name.rfind("tmp_", 0) != 0) continue;
+                fs::path file = dir / name;
+                std::error_code ec;
+                auto written = fs::last_write_time(file, ec);
+                if (ec || written >= cutoff) continue;
+                std::uintmax_t size = fs::file_size(file, ec);
+                if (!ec && fs::remove(file, ec)) stats.bytes += size;
+            }
+        }
+
+        // Packs written before the cutoff that hold unwanted objects are
+        // rewritten, together, as one pack of the objects they keep
+        std::vector<PackInput> objects;
+        std::map<std::string, std::size_t> seen;
+        std::vector<fs::path> rewritten;
+        std::uint64_t oldBytes = 0;
+        for (const auto& pack : packs_) {
+            std::error_code ec;
+            auto written = fs::last_write_time(pack->path(), ec);
+            bool expired = !ec && written < cutoff;
+            std::vector<std::pair<ObjectKind, std::string>> kept;
+            std::size_t dropped = 0;
+            for (ObjectKind kind : {ObjectKind::Commit, ObjectKind::Blob}) {
+                for (std::string& id : pack->ids(kind)) {
+                    if (keep(kind, id)) {
+                        kept.emplace_back(kind, std::move(id));
+                    } else if (expired) {
+                        ++dropped;
+                    } else {
+                        ++stats.recent;
+                    }
+                }
+            }
+            if (dropped == 0) continue;
+
+            for (auto& [kind, id] : kept) {
+                if (seen.count(id)) continue;
+                seen[id] = objects.size();
+                objects.push_back(PackInput{id, kind, read(kind, id), ""});
+            }
+            rewritten.push_back(pack->path());
+            oldBytes += fs::file_size(pack->path()) + fs::file_size(fs::path(pack->path()).replace_extension(".idx"));
+            stats.pruned += dropped;
+        }
+        if (rewritten.empty()) return stats;
+
+        hintNames(objects, seen);
+        PackStats packed = writePack(packsDir_, objects, compressionLevel_);
+        std::uint64_t newBytes = 0;
+        if (packed.objects > 0) {
+            newBytes = fs::file_size(packsDir_ / (packed.name + ".pack")) + fs::file_size(packsDir_ / (packed.name + ".idx"));
+        }
+        packs_.clear();
+        for (const fs::path& pack : rewritten) {
+            if (pack.stem() == packed.name) continue;
+            fs::remove(fs::path(pack).replace_extension(".idx"));
+            fs::remove(pack);
+        }
+        loadPacks();
+        if (oldBytes > newBytes) stats.bytes += oldBytes - newBytes;
+        return stats;
+    }
+
+} // namespace gitcpp
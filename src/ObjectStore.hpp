@@ -0,0 +1,127 @@
+#pragma once
+#include "ObjectCache.hpp"
+#include "Objects.hpp"
+#include "Pack.hpp"
+#include "Repository.hpp"
+#include "ThreadPool.hpp"
+
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace gitcpp {
+
+    /// Summary of an ObjectStore::prune() run.
+    struct PruneStats {
+        std::size_t pruned = 0;             // objects deleted
+        std::size_t recent = 0;             // unwanted but kept as too recent
+        std::uint64_t bytes = 0;            // disk space reclaimed
+    };
+
+    /// Object lookup over loose files (`blob_files/`, `commits/`) and packs
+    /// (`packs/`). Loose objects win over packed ones; callers never need to
+    /// know where an object lives.
+    ///
+    /// Loose objects are sharded into two-hex-digit fan-out directories
+    /// (`blob_files/ab/cdef...`); repositories with the old flat layout are
+    /// migrated once, the first time they are opened.
+    ///
+    /// Loose objects are written as "GCZ1", the 64-bit raw size and a zlib
+    /// stream, at the level set by `config core.compression <0-9>` (0 writes
+    /// raw bytes). Raw loose files from older repositories are still read.
+    ///
+    /// Decoded commits and trees are kept in an LRU cache shared by every
+    /// ObjectStore on the same repository in this process, bounded by
+    /// `config core.objectCacheSize <MiB>` (default 64).
+    class ObjectStore {
+    public:
+        explicit ObjectStore(const Repository& repo);
+
+        bool contains(ObjectKind kind, const std::string& id) const;
+
+        /// Read an object's bytes (throws if it does not exist).
+        std::vector<unsigned char> read(ObjectKind kind, const std::string& id) const;
+        std::string readAsString(ObjectKind kind, const std::string& id) const;
+
+        /// The first `size` bytes of an object, or all of it if it is
+        /// shorter (throws if it does not exist). Loose objects and whole
+        /// packed ones are only inflated that far.
+        std::vector<unsigned char> readPrefix(ObjectKind kind, const std::string& id, std::size_t size) const;
+
+        /// Write blob `id` to the working tree file `target`, replacing it
+        /// (throws if the blob does not exist). Uncompressed loose blobs are
+        /// copied file to file with copyContents(), so they can share extents
+        /// with the store; others are inflated and written.
+        void checkout(const std::string& id, const std::filesystem::path& target) const;
+
+        /// Decoded commit, or nullptr if it is missing or malformed.
+        std::shared_ptr<const CommitInfo> commit(const std::string& id) const;
+
+        /// Parse the commits `ids` on the shared pool, handing each worker a
+        /// contiguous run of them, and call `visit(i, commit)` for every one
+        /// that exists; `commit` is nullptr if it is malformed. The views
+        /// point into a buffer that lives only for the call, and nothing is
+        /// added to the object cache. `visit` is called from worker threads.
+        void scanCommits(const std::vector<std::string>& ids,
+                         const std::function<void(std::size_t, const CommitView*)>& visit) const;
+
+        /// Decoded tree, or nullptr if it is missing.
+        std::shared_ptr<const TreeInfo> tree(const std::string& id) const;
+
+        /// Store an object as a loose file, unless it already exists loose.
+        /// Writes go through a temporary file and are flushed as `config
+        /// core.fsync <off|batch|always>` asks (see FsyncMode). An existing
+        /// loose file is touched instead, so prune() treats it as new; a
+        /// packed object gets a new loose copy, leaving the pack's time as is.
+        void write(ObjectKind kind, const std::string& id, const std::vector<unsigned char>& data) const;
+        void write(ObjectKind kind, const std::string& id, const std::string& data) const;
+
+        /// Store the contents of `file` as a loose object and return its id.
+        /// Large files are hashed, compressed and written in one pass over
+        /// fixed-size chunks, so memory use does not grow with the file.
+        std::string writeFile(ObjectKind kind, const std::filesystem::path& file) const;
+
+        /// All object ids of a kind, loose and packed, sorted and unique.
+        std::vector<std::string> list(ObjectKind kind) const;
+
+        /// Ids of the `kind` objects written at or after `cutoff`: recent
+        /// loose files and everything in packs that recent, sorted and
+        /// unique. These are the objects prune() keeps regardless of `keep`.
+        std::vector<std::string> recent(ObjectKind kind, std::filesystem::file_time_type cutoff) const;
+
+        /// Fold loose objects into a new pack and delete them. With `all`,
+        /// existing packs are consolidated into the new pack as well.
+        PackStats repack(bool all);
+
+        /// Delete the objects `keep` rejects, unless they were written at or
+        /// after `cutoff`: loose files are removed one by one, and packs
+        /// older than `cutoff` that hold such objects are rewritten as a
+        /// single pack without them. Temporary files older than `cutoff`,
+        /// left by interrupted writes, are deleted as well. `keep` is called
+        /// from worker threads.
+        PruneStats prune(const std::function<bool(ObjectKind, const std::string&)>& keep,
+                         std::filesystem::file_time_type cutoff);
+
+    private:
+        std::filesystem::path loosePath(ObjectKind kind, const std::string& id) const;
+        std::vector<std::string> looseIds(ObjectKind kind) const;
+        bool freshen(const std::filesystem::path& loose) const;
+        std::string writeFileStreaming(ObjectKind kind, const std::filesystem::path& file, std::uint64_t size) const;
+        void hintNames(std::vector<PackInput>& objects, const std::map<std::string, std::size_t>& positions) const;
+        void loadPacks();
+        void migrateToFanout() const;
+
+        std::filesystem::path blobs_;
+        std::filesystem::path commits_;
+        std::filesystem::path packsDir_;
+        int compressionLevel_;
+        ThreadPool* pool_;
+        std::shared_ptr<ObjectCache> cache_;
+        std::vector<std::unique_ptr<Pack>> packs_;
+    };
+
+} // namespace gitcpp
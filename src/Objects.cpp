@@ -0,0 +1,118 @@
+#include "Objects.hpp"
+#include "Utils.hpp"
+
+#include <charconv>
+
+namespace gitcpp {
+
+    namespace {
+
+        constexpr std::string_view TREE_HEADER = "tree 2\n";
+
+        // Split off the next line of `rest`, without its newline
+        std::string_view nextLine(std::string_view& rest) {
+            std::size_t eol = rest.find('\n');
+            std::string_view line = rest.substr(0, eol);
+            rest.remove_prefix(eol == std::string_view::npos ? rest.size() : eol + 1);
+            return line;
+        }
+
+        bool startsWith(std::string_view text, std::string_view prefix) {
+            return text.compare(0, prefix.size(), prefix) == 0;
+        }
+
+        // Time of a "<name> <time> <tz>" signature, or 0
+        std::int64_t signatureTime(std::string_view signature) {
+            std::size_t tz = signature.rfind(' ');
+            if (tz == std::string_view::npos || tz == 0) return 0;
+            std::size_t time = signature.rfind(' ', tz - 1);
+            if (time == std::string_view::npos) return 0;
+            std::int64_t value = 0;
+            std::from_chars(signature.data() + time + 1, signature.data() + tz, value);
+            return value;
+        }
+
+    } // namespace
+
+    bool isLegacyTree(std::string_view contents) {
+        return !contents.empty() && !startsWith(contents, TREE_HEADER);
+    }
+
+    bool isTreePrefix(std::string_view prefix) {
+        if (prefix.empty()) return false;
+        if (!isLegacyTree(prefix)) return true;
+        std::string_view line = nextLine(prefix);
+        return line.size() > 41 && line[line.size() - 41] == ':' && isObjectId(line.substr(line.size() - 40));
+    }
+
+    TreeInfo parseTree(std::string_view contents) {
+        TreeInfo tree;
+        if (isLegacyTree(contents)) {
+            // Flat "path:id" lines: every entry is a file named by its full path
+            tree.legacy = true;
+            while (!contents.empty()) {
+                std::string_view line = nextLine(contents);
+                std::size_t colon_pos = line.find(':');
+                if (colon_pos != std::string_view::npos) {
+                    tree.entries.push_back(TreeEntry{std::string(line.substr(0, colon_pos)),
+                                                     std::string(line.substr(colon_pos + 1)), false});
+                }
+            }
+            return tree;
+        }
+
+        nextLine(contents);     // header
+        while (!contents.empty()) {
+            // "<blob|tree> <40-hex id> <name>"
+            std::string_view line = nextLine(contents);
+            if (line.size() < 47 || line[4] != ' ' || line[45] != ' ') continue;
+            tree.entries.push_back(TreeEntry{std::string(line.substr(46)), std::string(line.substr(5, 40)),
+                                             startsWith(line, "tree")});
+        }
+        return tree;
+    }
+
+    std::string formatTree(const std::vector<TreeEntry>& entries) {
+        std::string contents(TREE_HEADER);
+        for (const TreeEntry& entry : entries) {
+            contents += (entry.isTree ? "tree " : "blob ") + entry.id + " " + entry.name + "\n";
+        }
+        return contents;
+    }
+
+    bool parseCommit(std::string_view contents, CommitView& commit) {
+        commit = CommitView();
+        std::size_t nul_pos = contents.find('\0');
+        if (nul_pos == std::string_view::npos) return false;
+
+        std::string_view rest = contents.substr(nul_pos + 1);
+        const char* headersStart = rest.data();
+        while (!rest.empty()) {
+            std::string_view line = nextLine(rest);
+            if (line.empty()) break;
+            if (startsWith(line, "tree ")) {
+                commit.tree = line.substr(5);
+            } else if (startsWith(line, "parent ")) {
+                commit.parents.push_back(line.substr(7));
+            } else if (startsWith(line, "author ")) {
+                commit.author = line.substr(7);
+            } else if (startsWith(line, "committer ")) {
+                commit.committer = line.substr(10);
+                commit.timestamp = signatureTime(commit.committer);
+            }
+        }
+        commit.headers = std::string_view(headersStart, rest.data() - headersStart);
+        commit.message = rest;
+        return isObjectId(commit.tree);
+    }
+
+    bool parseCommit(std::string contents, CommitInfo& commit) {
+        commit.contents = std::move(contents);
+        if (!parseCommit(std::string_view(commit.contents), commit.view)) return false;
+        commit.tree = std::string(commit.view.tree);
+        commit.parents.assign(commit.view.parents.begin(), commit.view.parents.end());
+        commit.timestamp = commit.view.timestamp;
+        return true;
+    }
+
+} // namespace gitcpp
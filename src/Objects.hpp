@@ -0,0 +1,75 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace gitcpp {
+
+    /// One entry of a tree object: a file (blob) or a subdirectory (tree).
+    struct TreeEntry {
+        std::string name;
+        std::string id;
+        bool isTree = false;
+    };
+
+    /// A decoded tree object.
+    struct TreeInfo {
+        bool legacy = false;            // flat "path:id" tree from older versions
+        std::vector<TreeEntry> entries;
+    };
+
+    /// Fields of a commit object, as views into the buffer it was parsed
+    /// from; only valid while that buffer is.
+    struct CommitView {
+        std::string_view tree;
+        std::vector<std::string_view> parents;
+        std::string_view author;        // "<name> <time> <tz>"
+        std::string_view committer;
+        std::string_view headers;       // every header line, up to the blank line
+        std::string_view message;
+        std::int64_t timestamp = 0;     // committer time
+    };
+
+    /// A decoded commit object, owning its raw contents. `view` points into
+    /// `contents`, so a CommitInfo cannot be copied or moved.
+    struct CommitInfo {
+        CommitInfo() = default;
+        CommitInfo(const CommitInfo&) = delete;
+        CommitInfo& operator=(const CommitInfo&) = delete;
+
+        std::string tree;
+        std::vector<std::string> parents;
+        std::int64_t timestamp = 0;
+        std::string contents;           // "commit <size>\0<body>"
+        CommitView view;
+    };
+
+    /// Tree objects describe one directory each and are stored with the
+    /// blobs. A tree is the header line "tree 2" followed by one
+    /// "<blob|tree> <id> <name>" line per entry, sorted by name (directories
+    /// as if they had a trailing '/').
+    ///
+    /// Trees written by older versions are a single flat list of
+    /// "path:id" lines; they decode to entries named by full path.
+    TreeInfo parseTree(std::string_view contents);
+    std::string formatTree(const std::vector<TreeEntry>& entries);
+
+    /// True for a flat tree written by older versions.
+    bool isLegacyTree(std::string_view contents);
+
+    /// True if `prefix`, the start of a stored blob or tree, begins like a
+    /// non-empty tree: the tree header, or a flat tree's first "path:id"
+    /// line. Blobs can look like flat trees too; this only picks out the
+    /// objects worth parsing.
+    bool isTreePrefix(std::string_view prefix);
+
+    /// Parse a commit object ("commit <size>\0" and body) without copying
+    /// it; false if it has no valid tree line.
+    bool parseCommit(std::string_view contents, CommitView& commit);
+
+    /// Take ownership of `contents` and decode it into a freshly
+    /// constructed `commit`; false if it has no valid tree line.
+    bool parseCommit(std::string contents, CommitInfo& commit);
+
+} // namespace gitcpp
@@ -0,0 +1,473 @@
+#include "Pack.hpp"
+
+#include <zlib.h>
+
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <fstream>
+#include <unordered_map>
+
+namespace fs = std::filesystem;
+
+namespace gitcpp {
+
+    namespace {
+
+        constexpr unsigned char PACK_MAGIC[4] = {'G', 'C', 'P', 'K'};
+        constexpr unsigned char IDX_MAGIC[4] = {'G', 'C', 'I', 'X'};
+        // Version 1 packs store entry payloads raw, version 2 deflates them
+        constexpr std::uint32_t RAW_PACK_VERSION = 1;
+        constexpr std::uint32_t PACK_VERSION = 2;
+        constexpr std::uint32_t IDX_VERSION = 1;
+        constexpr std::size_t RAW_ID = 20;
+        constexpr std::size_t PACK_HEADER = 12;
+        constexpr std::size_t IDX_HEADER = 8;
+        constexpr std::size_t FANOUT_SIZE = 256 * 4;
+
+        // Entry type byte; the object kinds use their ObjectKind value.
+        constexpr unsigned char TYPE_OFS_DELTA = 6;
+
+        // Delta tuning: how many preceding objects are tried as bases, how
+        // long a chain may grow, and the block size used to index a base.
+        constexpr std::size_t DELTA_WINDOW = 10;
+        constexpr int MAX_DELTA_DEPTH = 50;
+        constexpr std::size_t MIN_DELTA_SIZE = 64;
+        constexpr std::size_t BLOCK = 16;
+        constexpr std::size_t MAX_BUCKET = 8;
+        constexpr std::size_t MAX_COPY = 0xffffff;
+        constexpr std::size_t MAX_INSERT = 0x7f;
+
+        void putVarint(std::vector<unsigned char>& out, std::uint64_t v) {
+            while (v >= 0x80) {
+                out.push_back(static_cast<unsigned char>(v | 0x80));
+                v >>= 7;
+            }
+            out.push_back(static_cast<unsigned char>(v));
+        }
+
+        std::uint64_t getVarint(const unsigned char*& p, const unsigned char* end) {
+            std::uint64_t v = 0;
+            int shift = 0;
+            while (true) {
+                if (p >= end || shift > 63) {
+                    throw error("Corrupt pack: truncated varint");
+                }
+                unsigned char b = *p++;
+                v |= std::uint64_t(b & 0x7f) << shift;
+                if (!(b & 0x80)) break;
+                shift += 7;
+            }
+            return v;
+        }
+
+        std::uint32_t blockHash(const unsigned char* p) {
+            std::uint32_t h = 2166136261u;
+            for (std::size_t i = 0; i < BLOCK; ++i) {
+                h = (h ^ p[i]) * 16777619u;
+            }
+            return h;
+        }
+
+        void emitInsert(std::vector<unsigned char>& out, const unsigned char* p, std::size_t n) {
+            while (n > 0) {
+                std::size_t chunk = std::min(n, MAX_INSERT);
+                out.push_back(static_cast<unsigned char>(chunk));
+                out.insert(out.end(), p, p + chunk);
+                p += chunk;
+                n -= chunk;
+            }
+        }
+
+        void emitCopy(std::vector<unsigned char>& out, std::size_t offset, std::size_t len) {
+            while (len > 0) {
+                std::size_t chunk = std::min(len, MAX_COPY);
+                unsigned char op = 0x80;
+                std::vector<unsigned char> args;
+                for (int i = 0; i < 4; ++i) {
+                    unsigned char b = static_cast<unsigned char>(offset >> (8 * i));
+                    if (b) { op |= static_cast<unsigned char>(1 << i); args.push_back(b); }
+                }
+                for (int i = 0; i < 3; ++i) {
+                    unsigned char b = static_cast<unsigned char>(chunk >> (8 * i));
+                    if (b) { op |= static_cast<unsigned char>(0x10 << i); args.push_back(b); }
+                }
+                out.push_back(op);
+                out.insert(out.end(), args.begin(), args.end());
+                offset += chunk;
+                len -= chunk;
+            }
+        }
+
+        // Append `data` to a version 2 pack: the deflated size, then the
+        // zlib stream.
+        void putPayload(std::vector<unsigned char>& pack, const std::vector<unsigned char>& data, int level) {
+            uLongf bound = compressBound(data.size());
+            std::vector<unsigned char> deflated(bound);
+            if (compress2(deflated.data(), &bound, data.data(), data.size(), level) != Z_OK) {
+                throw error("Could not compress object");
+            }
+            putVarint(pack, bound);
+            pack.insert(pack.end(), deflated.begin(), deflated.begin() + bound);
+        }
+
+        // Inflate the first `limit` bytes of a payload that inflates to
+        // `size` bytes; false if it is damaged
+        bool inflatePrefix(const unsigned char* p, std::uint64_t stored, std::uint64_t size, std::uint64_t limit,
+                           std::vector<unsigned char>& out) {
+            out.resize(std::min(size, limit));
+            if (out.size() == size) {
+                uLongf inflated = static_cast<uLongf>(size);
+                unsigned char empty = 0;
+                return uncompress(size > 0 ? out.data() : &empty, &inflated, p, static_cast<uLong>(stored)) == Z_OK &&
+                       inflated == size;
+            }
+
+            // Only the start is wanted, so inflate stops once it is there
+            z_stream zs{};
+            if (inflateInit(&zs) != Z_OK) {
+                throw error("Could not initialise zlib");
+            }
+            zs.next_in = const_cast<unsigned char*>(p);
+            zs.avail_in = static_cast<uInt>(std::min<std::uint64_t>(stored, UINT_MAX));
+            zs.next_out = out.data();
+            zs.avail_out = static_cast<uInt>(out.size());
+            int ret = Z_OK;
+            while (zs.avail_out > 0 && ret == Z_OK) ret = inflate(&zs, Z_NO_FLUSH);
+            inflateEnd(&zs);
+            return zs.avail_out == 0 && (ret == Z_OK || ret == Z_BUF_ERROR);
+        }
+
+        std::string baseName(const std::string& path) {
+            size_t slash = path.rfind('/');
+            return slash == std::string::npos ? path : path.substr(slash + 1);
+        }
+
+    } // namespace
+
+    // Delta encoding
+
+    std::vector<unsigned char> createDelta(const std::vector<unsigned char>& base,
+                                           const std::vector<unsigned char>& target,
+                                           std::size_t maxSize) {
+        std::vector<unsigned char> out;
+        putVarint(out, base.size());
+        putVarint(out, target.size());
+
+        // Index the base at block boundaries.
+        std::unordered_map<std::uint32_t, std::vector<std::uint32_t>> index;
+        for (std::size_t i = 0; i + BLOCK <= base.size(); i += BLOCK) {
+            auto& bucket = index[blockHash(base.data() + i)];
+            if (bucket.size() < MAX_BUCKET) bucket.push_back(static_cast<std::uint32_t>(i));
+        }
+
+        std::size_t t = 0;
+        std::size_t insertStart = 0;
+        while (t < target.size()) {
+            std::size_t bestLen = 0;
+            std::size_t bestOff = 0;
+            if (t + BLOCK <= target.size()) {
+                auto it = index.find(blockHash(target.data() + t));
+                if (it != index.end()) {
+                    for (std::uint32_t off : it->second) {
+                        std::size_t len = 0;
+                        while (off + len < base.size() && t + len < target.size() &&
+                               base[off + len] == target[t + len]) {
+                            ++len;
+                        }
+                        if (len > bestLen) { bestLen = len; bestOff = off; }
+                    }
+                }
+            }
+
+            if (bestLen < BLOCK) {
+                ++t;
+                continue;
+            }
+
+            // Grow the match backwards into bytes that would otherwise be inserted.
+            while (t > insertStart && bestOff > 0 && base[bestOff - 1] == target[t - 1]) {
+                --t; --bestOff; ++bestLen;
+            }
+            emitInsert(out, target.data() + insertStart, t - insertStart);
+            emitCopy(out, bestOff, bestLen);
+            t += bestLen;
+            insertStart = t;
+            if (out.size() > maxSize) return {};
+        }
+        emitInsert(out, target.data() + insertStart, target.size() - insertStart);
+        if (out.size() > maxSize) return {};
+        return out;
+    }
+
+    std::vector<unsigned char> applyDelta(const std::vector<unsigned char>& base,
+                                          const unsigned char* delta, std::size_t size) {
+        const unsigned char* p = delta;
+        const unsigned char* end = delta + size;
+        std::uint64_t baseSize = getVarint(p, end);
+        std::uint64_t resultSize = getVarint(p, end);
+        if (baseSize != base.size()) {
+            throw error("Corrupt pack: delta base size mismatch");
+        }
+
+        std::vector<unsigned char> out;
+        out.reserve(resultSize);
+        while (p < end) {
+            unsigned char op = *p++;
+            if (op & 0x80) {
+                std::size_t offset = 0, len = 0;
+                for (int i = 0; i < 4; ++i) {
+                    if (op & (1 << i)) {
+                        if (p >= end) throw error("Corrupt pack: truncated delta");
+                        offset |= std::size_t(*p++) << (8 * i);
+                    }
+                }
+                for (int i = 0; i < 3; ++i) {
+                    if (op & (0x10 << i)) {
+                        if (p >= end) throw error("Corrupt pack: truncated delta");
+                        len |= std::size_t(*p++) << (8 * i);
+                    }
+                }
+                if (len == 0 || offset + len > base.size()) {
+                    throw error("Corrupt pack: delta copy out of range");
+                }
+                out.insert(out.end(), base.begin() + offset, base.begin() + offset + len);
+            } else if (op != 0) {
+                if (p + op > end) throw error("Corrupt pack: truncated delta");
+                out.insert(out.end(), p, p + op);
+                p += op;
+            } else {
+                throw error("Corrupt pack: invalid delta opcode");
+            }
+        }
+        if (out.size() != resultSize) {
+            throw error("Corrupt pack: delta result size mismatch");
+        }
+        return out;
+    }
+
+    // Pack reader
+
+    Pack::Pack(const fs::path& packFile)
+        : packPath_(packFile),
+          pack_(packFile),
+          idx_(fs::path(packFile).replace_extension(".idx")) {
+        if (pack_.size() < PACK_HEADER + RAW_ID ||
+            std::memcmp(pack_.data(), PACK_MAGIC, 4) != 0 ||
+            (getBE32(pack_.data() + 4) != PACK_VERSION && getBE32(pack_.data() + 4) != RAW_PACK_VERSION)) {
+            throw error("Corrupt pack: " + packFile.string());
+        }
+        if (idx_.size() < IDX_HEADER + FANOUT_SIZE + RAW_ID ||
+            std::memcmp(idx_.data(), IDX_MAGIC, 4) != 0 ||
+            getBE32(idx_.data() + 4) != IDX_VERSION) {
+            throw error("Corrupt pack index: " + packFile.string());
+        }
+
+        deflated_ = getBE32(pack_.data() + 4) == PACK_VERSION;
+        count_ = getBE32(pack_.data() + 8);
+        fanout_ = idx_.data() + IDX_HEADER;
+        if (getBE32(fanout_ + 255 * 4) != count_ ||
+            idx_.size() != IDX_HEADER + FANOUT_SIZE + std::size_t(count_) * (RAW_ID + 8 + 1) + RAW_ID) {
+            throw error("Corrupt pack index: " + packFile.string());
+        }
+        ids_ = fanout_ + FANOUT_SIZE;
+        offsets_ = ids_ + std::size_t(count_) * RAW_ID;
+        kinds_ = offsets_ + std::size_t(count_) * 8;
+    }
+
+    long Pack::find(const std::string& id) const {
+        if (!isObjectId(id)) return -1;
+        unsigned char raw[RAW_ID];
+        fromHex(id, raw);
+
+        std::uint32_t lo = raw[0] == 0 ? 0 : getBE32(fanout_ + (raw[0] - 1) * 4);
+        std::uint32_t hi = getBE32(fanout_ + raw[0] * 4);
+        while (lo < hi) {
+            std::uint32_t mid = lo + (hi - lo) / 2;
+            int cmp = std::memcmp(ids_ + std::size_t(mid) * RAW_ID, raw, RAW_ID);
+            if (cmp == 0) return static_cast<long>(mid);
+            if (cmp < 0) lo = mid + 1; else hi = mid;
+        }
+        return -1;
+    }
+
+    bool Pack::contains(ObjectKind kind, const std::string& id) const {
+        long pos = find(id);
+        return pos >= 0 && kinds_[pos] == static_cast<unsigned char>(kind);
+    }
+
+    bool Pack::read(const std::string& id, ObjectKind& kind, std::vector<unsigned char>& out, std::size_t limit) const {
+        long pos = find(id);
+        if (pos < 0) return false;
+        kind = static_cast<ObjectKind>(kinds_[pos]);
+        readAt(getBE64(offsets_ + std::size_t(pos) * 8), out, limit);
+        return true;
+    }
+
+    void Pack::readAt(std::uint64_t offset, std::vector<unsigned char>& out, std::size_t limit) const {
+        const unsigned char* end = pack_.data() + pack_.size() - RAW_ID;
+
+        // Walk down the delta chain to its full base, then replay the deltas.
+        std::vector<std::vector<unsigned char>> deltas;
+        while (true) {
+            if (offset < PACK_HEADER || offset >= pack_.size() - RAW_ID) {
+                throw error("Corrupt pack: bad offset in " + packPath_.string());
+            }
+            const unsigned char* p = pack_.data() + offset;
+            unsigned char type = *p++;
+            std::uint64_t size = getVarint(p, end);
+            std::uint64_t distance = 0;
+            if (type == TYPE_OFS_DELTA) {
+                distance = getVarint(p, end);
+            }
+            std::uint64_t stored = deflated_ ? getVarint(p, end) : size;
+            if (stored > static_cast<std::uint64_t>(end - p)) {
+                throw error("Corrupt pack: truncated entry in " + packPath_.string());
+            }
+
+            // A delta needs all of its base, and all of itself
+            std::uint64_t wanted = type == TYPE_OFS_DELTA || !deltas.empty() ? size : std::min<std::uint64_t>(size, limit);
+            std::vector<unsigned char> payload;
+            if (deflated_) {
+                // zlib cannot expand input by more than ~1032:1
+                if (size / 1032 > stored) {
+                    throw error("Corrupt pack: bad entry size in " + packPath_.string());
+                }
+                if (!inflatePrefix(p, stored, size, wanted, payload)) {
+                    throw error("Corrupt pack: damaged entry in " + packPath_.string());
+                }
+            } else {
+                payload.assign(p, p + wanted);
+            }
+
+            if (type == TYPE_OFS_DELTA) {
+                if (distance == 0 || distance > offset) {
+                    throw error("Corrupt pack: bad delta base in " + packPath_.string());
+                }
+                deltas.push_back(std::move(payload));
+                offset -= distance;
+                continue;
+            }
+            out = std::move(payload);
+            break;
+        }
+        for (auto it = deltas.rbegin(); it != deltas.rend(); ++it) {
+            out = applyDelta(out, it->data(), it->size());
+        }
+        if (out.size() > limit) out.resize(limit);
+    }
+
+    std::vector<std::string> Pack::ids(ObjectKind kind) const {
+        std::vector<std::string> result;
+        for (std::uint32_t i = 0; i < count_; ++i) {
+            if (kinds_[i] == static_cast<unsigned char>(kind)) {
+                result.push_back(toHex(ids_ + std::size_t(i) * RAW_ID, RAW_ID));
+            }
+        }
+        return result;
+    }
+
+    // Pack writer
+
+    PackStats writePack(const fs::path& dir, std::vector<PackInput>& objects, int level) {
+        PackStats stats;
+        if (objects.empty()) return stats;
+
+        // Group similar objects next to each other: same kind, same file
+        // name, largest first so most deltas are removals.
+        std::sort(objects.begin(), objects.end(), [](const PackInput& a, const PackInput& b) {
+            if (a.kind != b.kind) return a.kind < b.kind;
+            std::string an = baseName(a.nameHint), bn = baseName(b.nameHint);
+            if (an != bn) return an < bn;
+            if (a.data.size() != b.data.size()) return a.data.size() > b.data.size();
+            return a.id < b.id;
+        });
+
+        std::vector<unsigned char> pack(PACK_MAGIC, PACK_MAGIC + 4);
+        putBE32(pack, PACK_VERSION);
+        putBE32(pack, static_cast<std::uint32_t>(objects.size()));
+
+        std::vector<std::uint64_t> offsets(objects.size());
+        std::vector<int> depth(objects.size(), 0);
+        for (std::size_t i = 0; i < objects.size(); ++i) {
+            const PackInput& obj = objects[i];
+            stats.inputBytes += obj.data.size();
+
+            std::vector<unsigned char> bestDelta;
+            std::size_t bestBase = 0;
+            if (obj.data.size() >= MIN_DELTA_SIZE) {
+                std::size_t first = i > DELTA_WINDOW ? i - DELTA_WINDOW : 0;
+                for (std::size_t j = first; j < i; ++j) {
+                    if (objects[j].kind != obj.kind || depth[j] >= MAX_DELTA_DEPTH) continue;
+                    std::size_t limit = bestDelta.empty() ? obj.data.size() / 2 : bestDelta.size() - 1;
+                    auto delta = createDelta(objects[j].data, obj.data, limit);
+                    if (!delta.empty()) {
+                        bestDelta = std::move(delta);
+                        bestBase = j;
+                    }
+                }
+            }
+
+            offsets[i] = pack.size();
+            if (!bestDelta.empty()) {
+                pack.push_back(TYPE_OFS_DELTA);
+                putVarint(pack, bestDelta.size());
+                putVarint(pack, offsets[i] - offsets[bestBase]);
+                putPayload(pack, bestDelta, level);
+                depth[i] = depth[bestBase] + 1;
+                ++stats.deltas;
+            } else {
+                pack.push_back(static_cast<unsigned char>(obj.kind));
+                putVarint(pack, obj.data.size());
+                putPayload(pack, obj.data, level);
+            }
+        }
+        unsigned char checksum[RAW_ID];
+        Sha1 hash;
+        hash.update(pack.data(), pack.size());
+        hash.digest(checksum);
+        pack.insert(pack.end(), checksum, checksum + RAW_ID);
+
+        // Index entries sorted by raw id.
+        std::vector<std::size_t> order(objects.size());
+        for (std::size_t i = 0; i < order.size(); ++i) order[i] = i;
+        std::sort(order.begin(), order.end(), [&](std::size_t a, std::size_t b) {
+            return objects[a].id < objects[b].id;
+        });
+
+        std::vector<unsigned char> idx(IDX_MAGIC, IDX_MAGIC + 4);
+        putBE32(idx, IDX_VERSION);
+        std::vector<std::uint32_t> fanout(256, 0);
+        std::vector<unsigned char> rawIds(objects.size() * RAW_ID);
+        for (std::size_t i = 0; i < order.size(); ++i) {
+            fromHex(objects[order[i]].id, rawIds.data() + i * RAW_ID);
+            ++fanout[rawIds[i * RAW_ID]];
+        }
+        std::uint32_t running = 0;
+        for (std::uint32_t& f : fanout) {
+            running += f;
+            putBE32(idx, running);
+        }
+        idx.insert(idx.end(), rawIds.begin(), rawIds.end());
+        for (std::size_t i : order) putBE64(idx, offsets[i]);
+        for (std::size_t i : order) idx.push_back(static_cast<unsigned char>(objects[i].kind));
+        idx.insert(idx.end(), checksum, checksum + RAW_ID);
+
+        std::string ids;
+        for (std::size_t i : order) ids += objects[i].id;
+        stats.name = "pack-" + sha1(ids);
+        stats.objects = objects.size();
+        stats.packBytes = pack.size();
+
+        // Publish the .pack before the .idx: readers only look for indexes.
+        fs::create_directories(dir);
+        fs::path tmpPack = dir / ("tmp_" + stats.name + ".pack");
+        fs::path tmpIdx = dir / ("tmp_" + stats.name + ".idx");
+        writeContents(tmpPack, pack);
+        writeContents(tmpIdx, idx);
+        durableRename(tmpPack, dir / (stats.name + ".pack"), false);
+        durableRename(tmpIdx, dir / (stats.name + ".idx"), false);
+        return stats;
+    }
+
+} // namespace gitcpp
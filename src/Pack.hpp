@@ -0,0 +1,93 @@
+#pragma once
+#include "Utils.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace gitcpp {
+
+    /// Kind of a stored object. Blobs and trees share `blob_files/`,
+    /// commits live in `commits/`.
+    enum class ObjectKind : std::uint8_t { Blob = 1, Commit = 2 };
+
+    /// One object handed to writePack().
+    struct PackInput {
+        std::string id;                     // 40-hex object id
+        ObjectKind kind;
+        std::vector<unsigned char> data;
+        std::string nameHint;               // path the object was seen at, used to group delta candidates
+    };
+
+    /// Summary of a writePack() run.
+    struct PackStats {
+        std::string name;                   // pack-<sha>, empty if nothing was written
+        std::size_t objects = 0;
+        std::size_t deltas = 0;
+        std::uint64_t inputBytes = 0;
+        std::uint64_t packBytes = 0;
+    };
+
+    /// Read access to one `pack-<sha>.pack` / `pack-<sha>.idx` pair.
+    ///
+    /// Pack layout: "GCPK", version, object count, then entries of
+    /// (type byte, varint size[, varint base distance], varint deflated
+    /// size, zlib payload) and a 20-byte SHA-1 trailer. Delta entries
+    /// reference an earlier entry in the same pack by offset distance.
+    /// Version 1 packs have no deflated size and store payloads raw.
+    ///
+    /// Index layout: "GCIX", version, 256-entry fan-out table, sorted raw
+    /// ids, 64-bit pack offsets, one kind byte per object and the pack
+    /// checksum.
+    class Pack {
+    public:
+        /// Map `pack-<sha>.pack` and its sibling `.idx` (throws on errors).
+        explicit Pack(const std::filesystem::path& packFile);
+
+        bool contains(ObjectKind kind, const std::string& id) const;
+
+        /// Inflate the object (resolving delta chains) into `out`, up to
+        /// its first `limit` bytes. Returns false if `id` is not in this
+        /// pack.
+        bool read(const std::string& id, ObjectKind& kind, std::vector<unsigned char>& out,
+                  std::size_t limit = SIZE_MAX) const;
+
+        /// All ids of the given kind, sorted.
+        std::vector<std::string> ids(ObjectKind kind) const;
+
+        std::size_t objectCount() const { return count_; }
+        const std::filesystem::path& path() const { return packPath_; }
+
+    private:
+        long find(const std::string& id) const;     // index position or -1
+        void readAt(std::uint64_t offset, std::vector<unsigned char>& out, std::size_t limit) const;
+
+        std::filesystem::path packPath_;
+        MappedFile pack_;
+        MappedFile idx_;
+        bool deflated_ = false;
+        std::uint32_t count_ = 0;
+        const unsigned char* fanout_ = nullptr;
+        const unsigned char* ids_ = nullptr;
+        const unsigned char* offsets_ = nullptr;
+        const unsigned char* kinds_ = nullptr;
+    };
+
+    /// Build a copy/insert delta turning `base` into `target`. Returns an
+    /// empty vector if the delta would exceed `maxSize` bytes.
+    std::vector<unsigned char> createDelta(const std::vector<unsigned char>& base,
+                                           const std::vector<unsigned char>& target,
+                                           std::size_t maxSize);
+
+    /// Apply a delta produced by createDelta() (throws on malformed input).
+    std::vector<unsigned char> applyDelta(const std::vector<unsigned char>& base,
+                                          const unsigned char* delta, std::size_t size);
+
+    /// Write `objects` as a new pack + index into `dir`, storing objects as
+    /// deltas against similar objects where that saves space. Every entry
+    /// is deflated at zlib `level`.
+    PackStats writePack(const std::filesystem::path& dir, std::vector<PackInput>& objects, int level);
+
+} // namespace gitcpp
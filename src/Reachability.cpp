@@ -0,0 +1,112 @@
+#include "Reachability.hpp"
+#include "Utils.hpp"
+
+#include <utility>
+
+namespace gitcpp {
+
+    Reachable markReachable(const CommitGraph& graph, const ObjectStore& store, ThreadPool& pool,
+                            const std::vector<std::string>& tips, const std::vector<std::string>& trees,
+                            const std::vector<std::string>& blobs, const BitmapIndex* bitmaps,
+                            const Reachable* marked) {
+        Reachable reachable;
+        auto newCommit = [&](const std::string& id) {
+            return !(marked && marked->commits.count(id)) && reachable.commits.insert(id).second;
+        };
+        auto newObject = [&](const std::string& id) {
+            return !(marked && marked->objects.count(id)) && reachable.objects.insert(id).second;
+        };
+        Bitmap covered;     // what the bitmaps of reached commits hold
+        auto isCovered = [&](std::uint32_t pos) { return pos != BitmapIndex::NOT_FOUND && covered.test(pos); };
+
+        std::vector<std::string> frontier;
+        for (const std::string& tip : tips) {
+            if (!tip.empty() && newCommit(tip)) frontier.push_back(tip);
+        }
+
+        // History, one generation of parents at a time
+        std::vector<std::string> roots;
+        while (!frontier.empty()) {
+            std::vector<std::string> trees(frontier.size());
+            std::vector<std::vector<std::string>> parents(frontier.size());
+            std::vector<std::uint32_t> indexed(frontier.size(), BitmapIndex::NOT_FOUND);
+            pool.parallelFor(frontier.size(), [&](std::size_t i) {
+                if (bitmaps) indexed[i] = bitmaps->findCommit(frontier[i]);
+                std::uint32_t pos = graph.find(frontier[i]);
+                if (pos != CommitGraph::NOT_FOUND) {
+                    trees[i] = graph.tree(pos);
+                    for (std::uint32_t parent : graph.parents(pos)) parents[i].push_back(graph.id(parent));
+                    return;
+                }
+                auto commit = store.commit(frontier[i]);
+                if (!commit) {
+                    if (store.contains(ObjectKind::Commit, frontier[i])) {
+                        throw error("Cannot read commit " + frontier[i]);
+                    }
+                    return;
+                }
+                trees[i] = commit->tree;
+                parents[i] = commit->parents;
+            });
+
+            std::vector<std::string> next;
+            for (std::size_t i = 0; i < frontier.size(); ++i) {
+                // Covered by a bitmap already taken, or has a bitmap of its own
+                if (isCovered(indexed[i])) continue;
+                if (indexed[i] != BitmapIndex::NOT_FOUND && bitmaps->orBitmap(indexed[i], covered)) continue;
+                if (!trees[i].empty()) roots.push_back(std::move(trees[i]));
+                for (std::string& parent : parents[i]) {
+                    if (newCommit(parent)) next.push_back(std::move(parent));
+                }
+            }
+            frontier.swap(next);
+        }
+
+        // Trees, one directory level at a time
+        roots.insert(roots.end(), trees.begin(), trees.end());
+        for (std::string& root : roots) {
+            if (bitmaps && isCovered(bitmaps->findObject(root))) continue;
+            if (newObject(root)) frontier.push_back(std::move(root));
+        }
+        for (const std::string& blob : blobs) {
+            if (!blob.empty()) newObject(blob);
+        }
+        while (!frontier.empty()) {
+            std::vector<std::vector<TreeEntry>> children(frontier.size());
+            pool.parallelFor(frontier.size(), [&](std::size_t i) {
+                auto tree = store.tree(frontier[i]);
+                if (!tree) {
+                    if (store.contains(ObjectKind::Blob, frontier[i])) {
+                        throw error("Cannot read tree " + frontier[i]);
+                    }
+                    return;
+                }
+                for (const TreeEntry& entry : tree->entries) {
+                    if (bitmaps && isCovered(bitmaps->findObject(entry.id))) continue;
+                    children[i].push_back(entry);
+                }
+            });
+
+            std::vector<std::string> next;
+            for (auto& entries : children) {
+                for (TreeEntry& entry : entries) {
+                    if (newObject(entry.id) && entry.isTree) next.push_back(std::move(entry.id));
+                }
+            }
+            frontier.swap(next);
+        }
+
+        if (bitmaps) {
+            covered.forEach([&](std::size_t pos) {
+                std::string id = bitmaps->id(static_cast<std::uint32_t>(pos));
+                if (pos < bitmaps->commitCount()) {
+                    newCommit(id);
+                } else {
+                    newObject(id);
+                }
+            });
+        }
+        return reachable;
+    }
+
+} // namespace gitcpp
@@ -0,0 +1,41 @@
+#pragma once
+#include "BitmapIndex.hpp"
+#include "CommitGraph.hpp"
+#include "ObjectStore.hpp"
+#include "ThreadPool.hpp"
+
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+namespace gitcpp {
+
+    /// Ids reached by markReachable().
+    struct Reachable {
+        std::unordered_set<std::string> commits;
+        std::unordered_set<std::string> objects;    // trees and blobs
+    };
+
+    /// Everything reachable from the commits `tips`, the trees `trees` and
+    /// the blobs `blobs`: every ancestor commit, its tree and all subtrees
+    /// and blobs below it.
+    ///
+    /// History and trees are walked breadth first, one level at a time.
+    /// Each level is decoded in parallel on `pool` (parents and trees come
+    /// from the commit-graph where it has them) and its children are
+    /// deduplicated sequentially, so shared subtrees are opened once.
+    /// Throws if a reached commit or tree exists but cannot be decoded, so
+    /// a damaged object never hides what it refers to.
+    ///
+    /// With `bitmaps`, the walk stops at commits that have a reachability
+    /// bitmap and takes everything below them from the bitmap instead;
+    /// trees the bitmaps already cover are not opened.
+    ///
+    /// With `marked`, the ids it holds count as reached already: the walk
+    /// stops at them and the result leaves them out.
+    Reachable markReachable(const CommitGraph& graph, const ObjectStore& store, ThreadPool& pool,
+                            const std::vector<std::string>& tips, const std::vector<std::string>& trees,
+                            const std::vector<std::string>& blobs, const BitmapIndex* bitmaps = nullptr,
+                            const Reachable* marked = nullptr);
+
+} // namespace gitcpp
@@ -0,0 +1,230 @@
+#include "Rename.hpp"
+#include "Utils.hpp"
+
+#include <algorithm>
+#include <unordered_map>
+
+namespace gitcpp {
+
+    namespace {
+
+        // Longest chunk a sketch hashes before cutting, for data without
+        // newlines (binaries, minified text)
+        constexpr std::size_t MAX_CHUNK = 64;
+
+        constexpr std::uint32_t FNV_OFFSET = 2166136261u;
+        constexpr std::uint32_t FNV_PRIME = 16777619u;
+
+        unsigned long parseNumber(const std::string& key, const std::string& value, unsigned long max) {
+            try {
+                long number = std::stol(value);
+                if (number >= 0 && static_cast<unsigned long>(number) <= max) return static_cast<unsigned long>(number);
+            } catch (const std::exception&) {
+            }
+            throw error("Invalid " + key + " value: " + value);
+        }
+
+        using Files = std::vector<std::pair<std::string, std::string>>;     // (path, blob id)
+
+        // Pair the unpaired `targets` with `sources` by sketch similarity.
+        // With `used`, each source is paired at most once (renames);
+        // without, any number of times (copies).
+        void pairBySimilarity(const ObjectStore& store, const Files& sources, std::vector<char>* used,
+                              const Files& targets, std::vector<char>& paired, const RenameOptions& options,
+                              bool copy, std::vector<Rename>& renames) {
+            std::vector<std::size_t> from, to;
+            std::vector<Sketch> fromSketches, toSketches;
+            auto sketch = [&](const std::pair<std::string, std::string>& file, std::vector<std::size_t>& positions,
+                              std::vector<Sketch>& sketches, std::size_t position) {
+                if (!store.contains(ObjectKind::Blob, file.second)) return;
+                Sketch result(store.readAsString(ObjectKind::Blob, file.second));
+                if (result.size() == 0) return;     // empty files only pair by id
+                positions.push_back(position);
+                sketches.push_back(std::move(result));
+            };
+            for (std::size_t t = 0; t < targets.size(); ++t) {
+                if (!paired[t]) sketch(targets[t], to, toSketches, t);
+            }
+            if (to.empty()) return;
+            for (std::size_t s = 0; s < sources.size(); ++s) {
+                if (!used || !(*used)[s]) sketch(sources[s], from, fromSketches, s);
+            }
+            if (from.empty()) return;
+
+            // Which sources contain each chunk. Chunks found in more than
+            // `candidateLimit` sources say little about where a file came
+            // from and are not used to pick candidates.
+            std::unordered_map<std::uint32_t, std::vector<std::uint32_t>> postings;
+            for (std::size_t s = 0; s < from.size(); ++s) {
+                for (const auto& chunk : fromSketches[s].chunks()) {
+                    postings[chunk.first].push_back(static_cast<std::uint32_t>(s));
+                }
+            }
+
+            struct Match {
+                unsigned score;
+                std::size_t target;
+                std::size_t source;
+            };
+            std::vector<Match> matches;
+            std::vector<std::uint32_t> shared(from.size(), 0);
+            std::vector<std::uint32_t> candidates;
+            for (std::size_t t = 0; t < to.size(); ++t) {
+                const Sketch& target = toSketches[t];
+                candidates.clear();
+                for (const auto& chunk : target.chunks()) {
+                    auto it = postings.find(chunk.first);
+                    if (it == postings.end() || it->second.size() > options.candidateLimit) continue;
+                    for (std::uint32_t s : it->second) {
+                        if (shared[s]++ == 0) candidates.push_back(s);
+                    }
+                }
+                if (candidates.empty() && from.size() <= options.candidateLimit) {
+                    for (std::size_t s = 0; s < from.size(); ++s) candidates.push_back(static_cast<std::uint32_t>(s));
+                }
+                std::sort(candidates.begin(), candidates.end(), [&](std::uint32_t x, std::uint32_t y) {
+                    return shared[x] != shared[y] ? shared[x] > shared[y] : x < y;
+                });
+                for (std::uint32_t s : candidates) shared[s] = 0;
+                if (candidates.size() > options.candidateLimit) candidates.resize(options.candidateLimit);
+
+                for (std::uint32_t s : candidates) {
+                    const Sketch& source = fromSketches[s];
+                    // Shared bytes cannot exceed the smaller file
+                    std::uint64_t smaller = std::min(source.size(), target.size());
+                    std::uint64_t larger = std::max(source.size(), target.size());
+                    if (smaller * 100 < larger * options.threshold) continue;
+                    unsigned score = source.similarity(target);
+                    if (score >= options.threshold) matches.push_back(Match{score, to[t], from[s]});
+                }
+            }
+
+            // Best pairs first; ties go to the earlier paths
+            std::sort(matches.begin(), matches.end(), [](const Match& x, const Match& y) {
+                if (x.score != y.score) return x.score > y.score;
+                if (x.target != y.target) return x.target < y.target;
+                return x.source < y.source;
+            });
+            for (const Match& match : matches) {
+                if (paired[match.target] || (used && (*used)[match.source])) continue;
+                paired[match.target] = 1;
+                if (used) (*used)[match.source] = 1;
+                renames.push_back(Rename{sources[match.source].first, targets[match.target].first, match.score, copy});
+            }
+        }
+
+        // Pair unpaired `targets` with sources holding the same blob
+        void pairByIdentity(const Files& sources, std::vector<char>* used, const Files& targets,
+                            std::vector<char>& paired, bool copy, std::vector<Rename>& renames) {
+            std::unordered_map<std::string, std::vector<std::size_t>> byId;
+            for (std::size_t s = 0; s < sources.size(); ++s) {
+                byId[sources[s].second].push_back(s);
+            }
+            for (std::size_t t = 0; t < targets.size(); ++t) {
+                if (paired[t]) continue;
+                auto it = byId.find(targets[t].second);
+                if (it == byId.end()) continue;
+                for (std::size_t s : it->second) {
+                    if (used && (*used)[s]) continue;
+                    paired[t] = 1;
+                    if (used) (*used)[s] = 1;
+                    renames.push_back(Rename{sources[s].first, targets[t].first, 100, copy});
+                    break;
+                }
+            }
+        }
+
+    } // namespace
+
+    RenameOptions renameOptions(const Repository& repo) {
+        RenameOptions options;
+        std::string threshold = repo.getConfig("rename.threshold");
+        if (!threshold.empty()) {
+            options.threshold = static_cast<unsigned>(parseNumber("rename.threshold", threshold, 100));
+        }
+        std::string limit = repo.getConfig("rename.limit");
+        if (!limit.empty()) {
+            options.candidateLimit = parseNumber("rename.limit", limit, 1000000);
+        }
+        std::string copies = repo.getConfig("rename.copies");
+        if (!copies.empty()) {
+            if (copies != "true" && copies != "false") {
+                throw error("Invalid rename.copies value: " + copies);
+            }
+            options.copies = copies == "true";
+        }
+        return options;
+    }
+
+    Sketch::Sketch(std::string_view data) : size_(data.size()) {
+        std::uint32_t hash = FNV_OFFSET;
+        std::size_t start = 0;
+        for (std::size_t i = 0; i < data.size(); ++i) {
+            hash = (hash ^ static_cast<unsigned char>(data[i])) * FNV_PRIME;
+            if (data[i] == '\n' || i + 1 - start == MAX_CHUNK || i + 1 == data.size()) {
+                chunks_.emplace_back(hash, static_cast<std::uint32_t>(i + 1 - start));
+                hash = FNV_OFFSET;
+                start = i + 1;
+            }
+        }
+
+        // One entry per distinct chunk
+        std::sort(chunks_.begin(), chunks_.end());
+        std::size_t out = 0;
+        for (std::size_t i = 0; i < chunks_.size(); ++i) {
+            if (out > 0 && chunks_[out - 1].first == chunks_[i].first) {
+                chunks_[out - 1].second += chunks_[i].second;
+            } else {
+                chunks_[out++] = chunks_[i];
+            }
+        }
+        chunks_.resize(out);
+        chunks_.shrink_to_fit();
+    }
+
+    unsigned Sketch::similarity(const Sketch& other) const {
+        std::uint64_t larger = std::max(size_, other.size_);
+        if (larger == 0) return 100;
+        std::uint64_t common = 0;
+        auto a = chunks_.begin();
+        auto b = other.chunks_.begin();
+        while (a != chunks_.end() && b != other.chunks_.end()) {
+            if (a->first < b->first) {
+                ++a;
+            } else if (b->first < a->first) {
+                ++b;
+            } else {
+                common += std::min(a->second, b->second);
+                ++a;
+                ++b;
+            }
+        }
+        return static_cast<unsigned>(common * 100 / larger);
+    }
+
+    std::vector<Rename> detectRenames(const ObjectStore& store, const std::map<std::string, std::string>& deleted,
+                                      const std::map<std::string, std::string>& added, const RenameOptions& options,
+                                      const std::map<std::string, std::string>& copySources) {
+        std::vector<Rename> renames;
+        if (added.empty() || (deleted.empty() && (!options.copies || copySources.empty()))) return renames;
+
+        Files sources(deleted.begin(), deleted.end());
+        Files targets(added.begin(), added.end());
+        std::vector<char> used(sources.size(), 0);
+        std::vector<char> paired(targets.size(), 0);
+        pairByIdentity(sources, &used, targets, paired, false, renames);
+        pairBySimilarity(store, sources, &used, targets, paired, options, false, renames);
+
+        if (options.copies) {
+            Files originals(copySources.begin(), copySources.end());
+            pairByIdentity(originals, nullptr, targets, paired, true, renames);
+            pairBySimilarity(store, originals, nullptr, targets, paired, options, true, renames);
+        }
+
+        std::sort(renames.begin(), renames.end(), [](const Rename& x, const Rename& y) {
+            return x.newPath < y.newPath;
+        });
+        return renames;
+    }
+
+} // namespace gitcpp
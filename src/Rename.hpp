@@ -0,0 +1,70 @@
+#pragma once
+#include "ObjectStore.hpp"
+#include "Repository.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace gitcpp {
+
+    /// Tuning for detectRenames(), read by renameOptions() from
+    ///   `config rename.threshold <0-100>` - minimum similarity in percent (50)
+    ///   `config rename.limit <n>`         - candidates scored per added path (100)
+    ///   `config rename.copies <true|false>` - also report copies (false)
+    struct RenameOptions {
+        unsigned threshold = 50;
+        std::size_t candidateLimit = 100;
+        bool copies = false;
+    };
+
+    RenameOptions renameOptions(const Repository& repo);
+
+    /// Compact fingerprint of a blob's contents: the data is cut into
+    /// chunks that end at a newline or after 64 bytes, and the sketch keeps
+    /// the number of bytes per chunk hash. Two sketches estimate how much
+    /// content the blobs share without comparing the blobs themselves.
+    class Sketch {
+    public:
+        explicit Sketch(std::string_view data);
+
+        /// Shared bytes relative to the larger blob, in percent.
+        unsigned similarity(const Sketch& other) const;
+
+        std::uint64_t size() const { return size_; }
+
+        /// (chunk hash, bytes) pairs sorted by hash.
+        const std::vector<std::pair<std::uint32_t, std::uint32_t>>& chunks() const { return chunks_; }
+
+    private:
+        std::vector<std::pair<std::uint32_t, std::uint32_t>> chunks_;
+        std::uint64_t size_ = 0;
+    };
+
+    /// A deleted (or, for copies, unchanged) path whose contents reappear
+    /// under an added path.
+    struct Rename {
+        std::string oldPath;
+        std::string newPath;
+        unsigned similarity = 100;      // percent
+        bool copy = false;
+    };
+
+    /// Pair added paths with the deleted paths they came from (path -> blob
+    /// id on both sides). Equal blob ids are paired first. The rest are
+    /// compared by sketch: candidates are the deleted paths that share
+    /// distinctive chunks with an added path, at most `candidateLimit` of
+    /// them, and pairs are taken best score first, each path at most once.
+    ///
+    /// With `options.copies`, added paths left unpaired may also match a
+    /// file in `copySources`, any number of times. Results are sorted by new
+    /// path.
+    std::vector<Rename> detectRenames(const ObjectStore& store, const std::map<std::string, std::string>& deleted,
+                                      const std::map<std::string, std::string>& added, const RenameOptions& options,
+                                      const std::map<std::string, std::string>& copySources = {});
+
+} // namespace gitcpp
@@ -1,6 +1,9 @@
 #include "Repository.hpp"
+#include "ObjectCache.hpp"
 #include <fstream>
 #include <iostream>
+#include <cstdlib>
+#include <iterator>
 
 using namespace std;
 
@@ -20,7 +23,7 @@ namespace gitcpp {
     void Repository::write_empty_map(const fs::path& p) { write_text(p, "{}"); }
     void Repository::write_empty_set(const fs::path& p) { write_text(p, "[]"); }
 
-    Repository::Repository() {
+    void Repository::set_paths() {
         // Use current working directory at time of construction
         CWD = fs::current_path();
         GITCPP_DIR = CWD / ".gitcpp";
@@ -29,12 +32,56 @@ namespace gitcpp {
         COMMITS = GITCPP_DIR / "commits";
         HEADS = GITCPP_DIR / "heads";
         BRANCHES = GITCPP_DIR / "branches";
+        PACKS = GITCPP_DIR / "packs";
+        CONFIG = GITCPP_DIR / "config";
+        LAYOUT = GITCPP_DIR / "layout";
+        COMMIT_GRAPHS = GITCPP_DIR / "commit-graphs";
+        BITMAP = GITCPP_DIR / "bitmap";
+        MESSAGE_INDEX = GITCPP_DIR / "message-index";
+        FILE_MAP = STAGED_FILES / "file_map";
+        INDEX = STAGED_FILES / "index";
+        REMOVE_SET = STAGED_FILES / "remove_set";
+        BLOB_COUNT = BLOBS / "blob_count";
+        FILE_TO_BLOB_MAP = STAGED_FILES / "blob_map";
+        BRANCH_SET = BRANCHES / "branch_set";
+        FIRST_BRANCH_COM = BRANCHES / "first_branch_com";
+        CURRENT_BRANCH = BRANCHES / "current_branch";
+    }
+
+    Repository::Repository(OpenTag) {
+        set_paths();
+    }
+
+    Repository Repository::open() {
+        Repository repo{OpenTag{}};
+        if (!fs::exists(repo.GITCPP_DIR)) {
+            std::cout << "Not in an initialized gitcpp directory.\n";
+            std::exit(0);
+        }
+        return repo;
+    }
+
+    std::string Repository::getConfig(const std::string& key, const std::string& fallback) const {
+        fs::path file = CONFIG / key;
+        if (!fs::is_regular_file(file)) {
+            return fallback;
+        }
+        std::ifstream ifs(file);
+        std::string value((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+        return value;
+    }
+
+    Repository::Repository() {
+        set_paths();
         
         if (fs::exists(GITCPP_DIR)) {
             std::cout << "A gitcpp version-control system already exists in the current directory.\n";
             std::exit(0);
         }
 
+        // Objects cached for an earlier repository at this path are gone
+        ObjectCache::forget(GITCPP_DIR);
+
         // Create directories
         ensure_dir(GITCPP_DIR);
         ensure_dir(STAGED_FILES);
@@ -42,26 +89,19 @@ namespace gitcpp {
         ensure_dir(COMMITS);
         ensure_dir(HEADS);
         ensure_dir(BRANCHES);
+        ensure_dir(PACKS);
 
-        write_text(COMMITS / "main", "");          // ""
         write_text(BLOBS / "blob_count", "0");          // "0"
         write_text(BRANCHES / "first_branch_com", "false");// "false"
-        write_empty_map(STAGED_FILES / "file_map");            // HashMap -> "{}"
         write_empty_map(STAGED_FILES / "blob_map");    // HashMap -> "{}"
         write_empty_set(BRANCHES / "branch_set");          // HashSet -> "[]"
         write_empty_set(STAGED_FILES / "remove_set");          // HashSet -> "[]"
         write_text(BRANCHES / "current_branch", "main");   // "main"
+        write_text(LAYOUT, "fanout");                      // sharded object directories
     }
 
     Repository::Repository(bool force_init) {
-        // Use current working directory at time of construction
-        CWD = fs::current_path();
-        GITCPP_DIR = CWD / ".gitcpp";
-        STAGED_FILES = GITCPP_DIR / "staged_files";
-        BLOBS = GITCPP_DIR / "blob_files";
-        COMMITS = GITCPP_DIR / "commits";
-        HEADS = GITCPP_DIR / "heads";
-        BRANCHES = GITCPP_DIR / "branches";
+        set_paths();
         
         if (fs::exists(GITCPP_DIR) && !force_init) {
             std::cout << "A gitcpp version-control system already exists in the current directory.\n";
@@ -73,6 +113,9 @@ namespace gitcpp {
             fs::remove_all(GITCPP_DIR);
         }
 
+        // Objects cached for an earlier repository at this path are gone
+        ObjectCache::forget(GITCPP_DIR);
+
         // Create directories
         ensure_dir(GITCPP_DIR);
         ensure_dir(STAGED_FILES);
@@ -80,15 +123,15 @@ namespace gitcpp {
         ensure_dir(COMMITS);
         ensure_dir(HEADS);
         ensure_dir(BRANCHES);
+        ensure_dir(PACKS);
 
-        write_text(COMMITS / "main", "");          // ""
         write_text(BLOBS / "blob_count", "0");          // "0"
         write_text(BRANCHES / "first_branch_com", "false");// "false"
-        write_empty_map(STAGED_FILES / "file_map");            // HashMap -> "{}"
         write_empty_map(STAGED_FILES / "blob_map");    // HashMap -> "{}"
         write_empty_set(BRANCHES / "branch_set");          // HashSet -> "[]"
         write_empty_set(STAGED_FILES / "remove_set");          // HashSet -> "[]"
         write_text(BRANCHES / "current_branch", "main");   // "main"
+        write_text(LAYOUT, "fanout");                      // sharded object directories
     }
 
 } // namespace gitcpp
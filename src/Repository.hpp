@@ -15,16 +15,22 @@ namespace gitcpp {
         fs::path COMMITS;
         fs::path STAGED_FILES;
         fs::path BLOBS;
-        fs::path FILE_MAP;
+        fs::path FILE_MAP;      // legacy text staging map, converted to INDEX on first use
+        fs::path INDEX;
         fs::path REMOVE_SET;
         fs::path BLOB_COUNT;
         fs::path HEADS;
         fs::path FILE_TO_BLOB_MAP;
-        fs::path MAIN_COMMIT;
         fs::path BRANCHES;
         fs::path BRANCH_SET;
         fs::path FIRST_BRANCH_COM;
         fs::path CURRENT_BRANCH;
+        fs::path PACKS;
+        fs::path CONFIG;
+        fs::path LAYOUT;
+        fs::path COMMIT_GRAPHS;
+        fs::path BITMAP;
+        fs::path MESSAGE_INDEX;
 
         // Constructor = "gitcpp init"
         Repository();
@@ -32,7 +38,18 @@ namespace gitcpp {
         // Constructor with force flag for testing
         Repository(bool force_init);
 
+        // Open the repository in the current directory without initializing it.
+        // Exits with a message if there is none.
+        static Repository open();
+
+        // Value stored by `config <key> <value>`, or `fallback` if unset.
+        std::string getConfig(const std::string& key, const std::string& fallback = "") const;
+
     private:
+        struct OpenTag {};
+        explicit Repository(OpenTag);
+
+        void set_paths();
         static void ensure_dir(const fs::path& p);
         static void write_text(const fs::path& p, const std::string& s);
         static void write_empty_map(const fs::path& p);   // "{}"
@@ -0,0 +1,257 @@
+#include "Sha1.hpp"
+#include "Utils.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#include <immintrin.h>
+#define GITCPP_SHA1_X86 1
+#endif
+
+#if defined(__aarch64__) && (defined(__ARM_FEATURE_SHA2) || defined(__ARM_FEATURE_CRYPTO))
+#include <arm_neon.h>
+#if defined(__linux__)
+#include <asm/hwcap.h>
+#include <sys/auxv.h>
+#endif
+#define GITCPP_SHA1_ARM 1
+#endif
+
+namespace gitcpp {
+
+    namespace {
+
+        // Compress `blocks` consecutive 64-byte blocks into `state`
+        using BlockFunction = void (*)(std::uint32_t state[5], const unsigned char* data, std::size_t blocks);
+
+        inline std::uint32_t rotl(std::uint32_t x, int n) {
+            return (x << n) | (x >> (32 - n));
+        }
+
+        void compressGeneric(std::uint32_t state[5], const unsigned char* data, std::size_t blocks) {
+            for (; blocks > 0; --blocks, data += Sha1::BLOCK_SIZE) {
+                std::uint32_t w[80];
+                for (int i = 0; i < 16; ++i) w[i] = getBE32(data + 4 * i);
+                for (int i = 16; i < 80; ++i) w[i] = rotl(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+
+                std::uint32_t a = state[0], b = state[1], c = state[2], d = state[3], e = state[4];
+                for (int i = 0; i < 80; ++i) {
+                    std::uint32_t f, k;
+                    if (i < 20) {
+                        f = (b & c) | (~b & d);
+                        k = 0x5a827999;
+                    } else if (i < 40) {
+                        f = b ^ c ^ d;
+                        k = 0x6ed9eba1;
+                    } else if (i < 60) {
+                        f = (b & c) | (b & d) | (c & d);
+                        k = 0x8f1bbcdc;
+                    } else {
+                        f = b ^ c ^ d;
+                        k = 0xca62c1d6;
+                    }
+                    std::uint32_t t = rotl(a, 5) + f + e + k + w[i];
+                    e = d;
+                    d = c;
+                    c = rotl(b, 30);
+                    b = a;
+                    a = t;
+                }
+                state[0] += a;
+                state[1] += b;
+                state[2] += c;
+                state[3] += d;
+                state[4] += e;
+            }
+        }
+
+#ifdef GITCPP_SHA1_X86
+        // Four rounds with round function `f` (0-3); the instruction takes
+        // it as an immediate
+        __attribute__((target("sha,sse4.1")))
+        inline __m128i rounds4(__m128i abcd, __m128i e, int f) {
+            switch (f) {
+            case 0: return _mm_sha1rnds4_epu32(abcd, e, 0);
+            case 1: return _mm_sha1rnds4_epu32(abcd, e, 1);
+            case 2: return _mm_sha1rnds4_epu32(abcd, e, 2);
+            default: return _mm_sha1rnds4_epu32(abcd, e, 3);
+            }
+        }
+
+        __attribute__((target("sha,sse4.1,ssse3")))
+        void compressShaNi(std::uint32_t state[5], const unsigned char* data, std::size_t blocks) {
+            // Byte-reverse the block so w[0] lands in the top lane
+            const __m128i mask = _mm_set_epi64x(0x0001020304050607ULL, 0x08090a0b0c0d0e0fULL);
+            __m128i abcd = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(state)), 0x1b);
+            __m128i e0 = _mm_set_epi32(static_cast<int>(state[4]), 0, 0, 0);
+
+            for (; blocks > 0; --blocks, data += Sha1::BLOCK_SIZE) {
+                __m128i savedAbcd = abcd;
+                __m128i savedE = e0;
+                __m128i w[4];
+                __m128i previous = abcd;
+
+                // Each step covers four rounds; w holds the last four
+                // message-schedule words
+                for (int step = 0; step < 20; ++step) {
+                    __m128i& current = w[step % 4];
+                    if (step < 4) {
+                        current = _mm_shuffle_epi8(
+                            _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 16 * step)), mask);
+                    } else {
+                        current = _mm_sha1msg2_epu32(
+                            _mm_xor_si128(_mm_sha1msg1_epu32(current, w[(step + 1) % 4]), w[(step + 2) % 4]),
+                            w[(step + 3) % 4]);
+                    }
+                    __m128i e = step == 0 ? _mm_add_epi32(e0, current) : _mm_sha1nexte_epu32(previous, current);
+                    previous = abcd;
+                    abcd = rounds4(abcd, e, step / 5);
+                }
+
+                e0 = _mm_sha1nexte_epu32(previous, savedE);
+                abcd = _mm_add_epi32(abcd, savedAbcd);
+            }
+
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(state), _mm_shuffle_epi32(abcd, 0x1b));
+            state[4] = static_cast<std::uint32_t>(_mm_extract_epi32(e0, 3));
+        }
+
+        bool hasShaNi() {
+            unsigned eax, ebx, ecx, edx;
+            if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) return false;
+            bool ssse3 = ecx & (1u << 9);
+            bool sse41 = ecx & (1u << 19);
+            if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) return false;
+            bool sha = ebx & (1u << 29);
+            return ssse3 && sse41 && sha;
+        }
+#endif
+
+#ifdef GITCPP_SHA1_ARM
+        void compressArm(std::uint32_t state[5], const unsigned char* data, std::size_t blocks) {
+            static const std::uint32_t K[4] = {0x5a827999, 0x6ed9eba1, 0x8f1bbcdc, 0xca62c1d6};
+            uint32x4_t abcd = vld1q_u32(state);
+            std::uint32_t e0 = state[4];
+
+            for (; blocks > 0; --blocks, data += Sha1::BLOCK_SIZE) {
+                uint32x4_t savedAbcd = abcd;
+                std::uint32_t savedE = e0;
+                uint32x4_t w[4];
+
+                for (int step = 0; step < 20; ++step) {
+                    uint32x4_t& current = w[step % 4];
+                    if (step < 4) {
+                        current = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(data + 16 * step)));
+                    } else {
+                        current = vsha1su1q_u32(vsha1su0q_u32(current, w[(step + 1) % 4], w[(step + 2) % 4]),
+                                                w[(step + 3) % 4]);
+                    }
+                    uint32x4_t words = vaddq_u32(current, vdupq_n_u32(K[step / 5]));
+                    std::uint32_t e1 = vsha1h_u32(vgetq_lane_u32(abcd, 0));
+                    switch (step / 5) {
+                    case 0: abcd = vsha1cq_u32(abcd, e0, words); break;
+                    case 2: abcd = vsha1mq_u32(abcd, e0, words); break;
+                    default: abcd = vsha1pq_u32(abcd, e0, words); break;
+                    }
+                    e0 = e1;
+                }
+
+                e0 += savedE;
+                abcd = vaddq_u32(abcd, savedAbcd);
+            }
+
+            vst1q_u32(state, abcd);
+            state[4] = e0;
+        }
+
+        bool hasArmSha1() {
+#if defined(__linux__)
+            return getauxval(AT_HWCAP) & HWCAP_SHA1;
+#else
+            return true;    // the compiler targets the crypto extensions
+#endif
+        }
+#endif
+
+        struct Backend {
+            BlockFunction compress;
+            const char* name;
+        };
+
+        const Backend& selectBackend() {
+            static const Backend backend = [] {
+#ifdef GITCPP_SHA1_X86
+                if (hasShaNi()) return Backend{compressShaNi, "sha-ni"};
+#endif
+#ifdef GITCPP_SHA1_ARM
+                if (hasArmSha1()) return Backend{compressArm, "armv8"};
+#endif
+                return Backend{compressGeneric, "generic"};
+            }();
+            return backend;
+        }
+
+    } // namespace
+
+    Sha1::Sha1() : state_{0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0} {}
+
+    void Sha1::update(const void* data, std::size_t size) {
+        const auto* bytes = static_cast<const unsigned char*>(data);
+        BlockFunction compress = selectBackend().compress;
+        length_ += size;
+
+        if (buffered_ > 0) {
+            std::size_t take = std::min(size, BLOCK_SIZE - buffered_);
+            std::memcpy(buffer_ + buffered_, bytes, take);
+            buffered_ += take;
+            bytes += take;
+            size -= take;
+            if (buffered_ < BLOCK_SIZE) return;
+            compress(state_, buffer_, 1);
+            buffered_ = 0;
+        }
+
+        // Whole blocks straight from the caller's buffer
+        std::size_t blocks = size / BLOCK_SIZE;
+        if (blocks > 0) {
+            compress(state_, bytes, blocks);
+            bytes += blocks * BLOCK_SIZE;
+            size -= blocks * BLOCK_SIZE;
+        }
+
+        std::memcpy(buffer_, bytes, size);
+        buffered_ = size;
+    }
+
+    void Sha1::digest(unsigned char out[DIGEST_SIZE]) {
+        // Pad with 0x80, zeros and the bit length so the total is a
+        // multiple of the block size
+        std::uint64_t bits = length_ * 8;
+        unsigned char padding[BLOCK_SIZE + 8] = {0x80};
+        std::size_t padSize = (buffered_ < 56 ? 56 : 120) - buffered_;
+        update(padding, padSize);
+        unsigned char lengthBytes[8];
+        for (int i = 0; i < 8; ++i) lengthBytes[i] = static_cast<unsigned char>(bits >> (56 - 8 * i));
+        update(lengthBytes, sizeof(lengthBytes));
+
+        for (int i = 0; i < 5; ++i) {
+            out[4 * i] = static_cast<unsigned char>(state_[i] >> 24);
+            out[4 * i + 1] = static_cast<unsigned char>(state_[i] >> 16);
+            out[4 * i + 2] = static_cast<unsigned char>(state_[i] >> 8);
+            out[4 * i + 3] = static_cast<unsigned char>(state_[i]);
+        }
+    }
+
+    std::string Sha1::hexDigest() {
+        unsigned char out[DIGEST_SIZE];
+        digest(out);
+        return toHex(out, DIGEST_SIZE);
+    }
+
+    const char* Sha1::backend() {
+        return selectBackend().name;
+    }
+
+} // namespace gitcpp
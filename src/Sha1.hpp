@@ -0,0 +1,44 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace gitcpp {
+
+    /// Incremental SHA-1. Blocks are compressed with the CPU's SHA
+    /// instructions when it has them (x86 SHA-NI, ARMv8 crypto extensions)
+    /// and with portable code otherwise; the choice is made once per process.
+    ///
+    ///     Sha1 hash;
+    ///     hash.update(header);
+    ///     hash.update(data, size);
+    ///     std::string id = hash.hexDigest();
+    class Sha1 {
+    public:
+        static constexpr std::size_t DIGEST_SIZE = 20;
+        static constexpr std::size_t BLOCK_SIZE = 64;
+
+        Sha1();
+
+        void update(const void* data, std::size_t size);
+        void update(std::string_view data) { update(data.data(), data.size()); }
+
+        /// Finish the hash and write the raw digest. The object must not be
+        /// updated afterwards.
+        void digest(unsigned char out[DIGEST_SIZE]);
+
+        /// Finish the hash and return the digest as 40 lowercase hex digits.
+        std::string hexDigest();
+
+        /// Name of the block function in use: "sha-ni", "armv8" or "generic".
+        static const char* backend();
+
+    private:
+        std::uint32_t state_[5];
+        std::uint64_t length_ = 0;              // bytes hashed so far
+        unsigned char buffer_[BLOCK_SIZE];
+        std::size_t buffered_ = 0;
+    };
+
+} // namespace gitcpp
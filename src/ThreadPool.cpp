@@ -0,0 +1,132 @@
+#include "ThreadPool.hpp"
+#include "Utils.hpp"
+
+#include <algorithm>
+
+namespace gitcpp {
+
+    namespace {
+
+        unsigned requestedThreads = 0;
+        thread_local bool insideTask = false;
+
+        unsigned parseThreads(const std::string& value) {
+            if (value.empty()) return 0;
+            try {
+                int threads = std::stoi(value);
+                if (threads >= 0) return static_cast<unsigned>(threads);
+            } catch (const std::exception&) {
+            }
+            throw error("Invalid core.threads value: " + value);
+        }
+
+    } // namespace
+
+    ThreadPool::ThreadPool(unsigned threads) {
+        start(threads);
+    }
+
+    ThreadPool::~ThreadPool() {
+        stop();
+    }
+
+    void ThreadPool::start(unsigned threads) {
+        threads_ = std::max(1u, threads);
+        stopping_ = false;
+        for (unsigned i = 1; i < threads_; ++i) {
+            workers_.emplace_back(&ThreadPool::workerLoop, this);
+        }
+    }
+
+    void ThreadPool::stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        wake_.notify_all();
+        for (auto& worker : workers_) worker.join();
+        workers_.clear();
+    }
+
+    void ThreadPool::setRequestedThreads(unsigned threads) {
+        requestedThreads = threads;
+    }
+
+    ThreadPool& ThreadPool::shared(const Repository& repo) {
+        unsigned threads = requestedThreads;
+        if (threads == 0) threads = parseThreads(repo.getConfig("core.threads"));
+        if (threads == 0) threads = std::thread::hardware_concurrency();
+        threads = std::max(1u, threads);
+
+        static ThreadPool pool(threads);
+        if (pool.size() != threads) {
+            std::lock_guard<std::mutex> lock(pool.runMutex_);
+            pool.stop();
+            pool.start(threads);
+        }
+        return pool;
+    }
+
+    void ThreadPool::drain() {
+        insideTask = true;
+        for (std::size_t i = next_++; i < count_; i = next_++) {
+            try {
+                (*task_)(i);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (!failure_) failure_ = std::current_exception();
+                next_ = count_;
+            }
+        }
+        insideTask = false;
+    }
+
+    void ThreadPool::workerLoop() {
+        std::size_t seen = 0;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                wake_.wait(lock, [&] { return stopping_ || generation_ != seen; });
+                if (stopping_) return;
+                seen = generation_;
+            }
+            drain();
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                --busy_;
+            }
+            done_.notify_one();
+        }
+    }
+
+    void ThreadPool::parallelFor(std::size_t count, const std::function<void(std::size_t)>& task) {
+        if (count == 0) return;
+        if (insideTask || workers_.empty() || count == 1) {
+            for (std::size_t i = 0; i < count; ++i) task(i);
+            return;
+        }
+
+        std::lock_guard<std::mutex> run(runMutex_);
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            task_ = &task;
+            count_ = count;
+            next_ = 0;
+            failure_ = nullptr;
+            busy_ = static_cast<unsigned>(workers_.size());
+            ++generation_;
+        }
+        wake_.notify_all();
+        drain();
+
+        std::exception_ptr failure;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            done_.wait(lock, [&] { return busy_ == 0; });
+            task_ = nullptr;
+            failure = failure_;
+        }
+        if (failure) std::rethrow_exception(failure);
+    }
+
+} // namespace gitcpp
@@ -0,0 +1,68 @@
+#pragma once
+#include "Repository.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace gitcpp {
+
+    /// Fixed set of worker threads for data-parallel loops (hashing the
+    /// working tree, scanning object directories, ...).
+    ///
+    /// Work is handed out one index at a time, so callers that need a
+    /// deterministic result store it per index and merge sequentially
+    /// afterwards.
+    class ThreadPool {
+    public:
+        /// A pool of `threads` threads in total, the caller included.
+        explicit ThreadPool(unsigned threads);
+        ~ThreadPool();
+
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        unsigned size() const { return threads_; }
+
+        /// Call `task(i)` for every i in [0, count) on the workers and the
+        /// calling thread, returning once all calls have finished. The first
+        /// exception thrown by a task is rethrown here. Nested calls from
+        /// inside a task run serially.
+        void parallelFor(std::size_t count, const std::function<void(std::size_t)>& task);
+
+        /// The process-wide pool, sized by `-j`, else `config core.threads`,
+        /// else the number of cores.
+        static ThreadPool& shared(const Repository& repo);
+
+        /// Thread count requested on the command line with `-j` (0 = unset).
+        static void setRequestedThreads(unsigned threads);
+
+    private:
+        void start(unsigned threads);
+        void stop();
+        void workerLoop();
+        void drain();
+
+        unsigned threads_ = 1;
+        std::vector<std::thread> workers_;
+        std::mutex runMutex_;             // one parallelFor at a time
+
+        std::mutex mutex_;
+        std::condition_variable wake_;
+        std::condition_variable done_;
+        std::size_t generation_ = 0;
+        unsigned busy_ = 0;
+        bool stopping_ = false;
+
+        const std::function<void(std::size_t)>* task_ = nullptr;
+        std::size_t count_ = 0;
+        std::atomic<std::size_t> next_{0};
+        std::exception_ptr failure_;
+    };
+
+} // namespace gitcpp
@@ -0,0 +1,177 @@
+#include "Tree.hpp"
+#include "Utils.hpp"
+
+#include <algorithm>
+
+namespace gitcpp {
+
+    namespace {
+
+        // Entries are ordered as if directories had a trailing '/', which
+        // makes a walk over the trees visit paths in sorted order.
+        std::string sortKey(const TreeEntry& entry) {
+            return entry.isTree ? entry.name + "/" : entry.name;
+        }
+
+        // Decoded tree, or an empty one if it is missing
+        std::shared_ptr<const TreeInfo> loadTree(const ObjectStore& store, const std::string& treeId) {
+            static const auto empty = std::make_shared<const TreeInfo>();
+            if (treeId.empty()) return empty;
+            auto tree = store.tree(treeId);
+            return tree ? tree : empty;
+        }
+
+        void flatten(const ObjectStore& store, const std::string& treeId, const std::string& prefix,
+                     std::map<std::string, std::string>& files) {
+            for (const TreeEntry& entry : loadTree(store, treeId)->entries) {
+                if (entry.isTree) {
+                    flatten(store, entry.id, prefix + entry.name + "/", files);
+                } else {
+                    files.emplace_hint(files.end(), prefix + entry.name, entry.id);
+                }
+            }
+        }
+
+        using FileRange = std::map<std::string, std::string>::const_iterator;
+
+        // Write the directory holding [first, last), whose paths all start
+        // with `prefix`, and return its tree id.
+        std::string writeDirectory(const ObjectStore& store, FileRange first, FileRange last, std::size_t prefix) {
+            std::vector<TreeEntry> entries;
+            while (first != last) {
+                const std::string& path = first->first;
+                std::size_t slash = path.find('/', prefix);
+                if (slash == std::string::npos) {
+                    entries.push_back(TreeEntry{path.substr(prefix), first->second, false});
+                    ++first;
+                    continue;
+                }
+
+                // Every path below this subdirectory is contiguous in the map
+                std::string dir = path.substr(0, slash + 1);
+                FileRange end = first;
+                while (end != last && end->first.compare(0, dir.size(), dir) == 0) ++end;
+                entries.push_back(TreeEntry{path.substr(prefix, slash - prefix),
+                                            writeDirectory(store, first, end, slash + 1), true});
+                first = end;
+            }
+            std::sort(entries.begin(), entries.end(), [](const TreeEntry& a, const TreeEntry& b) {
+                return sortKey(a) < sortKey(b);
+            });
+
+            std::string contents = formatTree(entries);
+            std::string id = sha1(contents);
+            if (!store.contains(ObjectKind::Blob, id)) {
+                store.write(ObjectKind::Blob, id, contents);
+            }
+            return id;
+        }
+
+        using Visit = std::function<void(const std::string&, const std::string&, const std::string&)>;
+
+        void diffDirectories(const ObjectStore& store, const std::string& oldTree, const std::string& newTree,
+                             const std::string& prefix, const Visit& visit) {
+            if (oldTree == newTree) return;
+            auto oldTreeInfo = loadTree(store, oldTree);
+            auto newTreeInfo = loadTree(store, newTree);
+            const std::vector<TreeEntry>& oldEntries = oldTreeInfo->entries;
+            const std::vector<TreeEntry>& newEntries = newTreeInfo->entries;
+
+            auto report = [&](const TreeEntry* oldEntry, const TreeEntry* newEntry) {
+                const TreeEntry& any = oldEntry ? *oldEntry : *newEntry;
+                std::string path = prefix + any.name;
+                bool oldTreeSide = oldEntry && oldEntry->isTree;
+                bool newTreeSide = newEntry && newEntry->isTree;
+                if (oldTreeSide || newTreeSide) {
+                    diffDirectories(store, oldTreeSide ? oldEntry->id : "", newTreeSide ? newEntry->id : "",
+                                    path + "/", visit);
+                }
+                std::string oldId = oldEntry && !oldTreeSide ? oldEntry->id : "";
+                std::string newId = newEntry && !newTreeSide ? newEntry->id : "";
+                if (oldId != newId) visit(path, oldId, newId);
+            };
+
+            // Both lists are sorted by key; walk them together
+            std::size_t i = 0, j = 0;
+            while (i < oldEntries.size() || j < newEntries.size()) {
+                int cmp;
+                if (i == oldEntries.size()) cmp = 1;
+                else if (j == newEntries.size()) cmp = -1;
+                else cmp = sortKey(oldEntries[i]).compare(sortKey(newEntries[j]));
+
+                if (cmp < 0) {
+                    report(&oldEntries[i++], nullptr);
+                } else if (cmp > 0) {
+                    report(nullptr, &newEntries[j++]);
+                } else {
+                    if (oldEntries[i].id != newEntries[j].id) report(&oldEntries[i], &newEntries[j]);
+                    ++i;
+                    ++j;
+                }
+            }
+        }
+
+    } // namespace
+
+    std::string writeTree(const ObjectStore& store, const std::map<std::string, std::string>& files) {
+        return writeDirectory(store, files.begin(), files.end(), 0);
+    }
+
+    std::map<std::string, std::string> readTree(const ObjectStore& store, const std::string& treeId) {
+        std::map<std::string, std::string> files;
+        flatten(store, treeId, "", files);
+        return files;
+    }
+
+    std::optional<std::string> findInTree(const ObjectStore& store, const std::string& treeId,
+                                          const std::string& path) {
+        auto tree = loadTree(store, treeId);
+        if (tree->legacy) {
+            for (const TreeEntry& entry : tree->entries) {
+                if (entry.name == path) return entry.id;
+            }
+            return std::nullopt;
+        }
+
+        std::size_t slash = path.find('/');
+        std::string name = path.substr(0, slash);
+        for (const TreeEntry& entry : tree->entries) {
+            if (entry.name != name) continue;
+            if (slash == std::string::npos) {
+                if (!entry.isTree) return entry.id;
+            } else if (entry.isTree) {
+                return findInTree(store, entry.id, path.substr(slash + 1));
+            }
+        }
+        return std::nullopt;
+    }
+
+    void diffTrees(const ObjectStore& store, const std::string& oldTree, const std::string& newTree,
+                   const std::function<void(const std::string&, const std::string&, const std::string&)>& visit) {
+        if (oldTree == newTree) return;
+        if (!loadTree(store, oldTree)->legacy && !loadTree(store, newTree)->legacy) {
+            diffDirectories(store, oldTree, newTree, "", visit);
+            return;
+        }
+
+        // Flat trees have no subtrees to skip; compare the file lists
+        std::map<std::string, std::string> oldFiles = readTree(store, oldTree);
+        std::map<std::string, std::string> newFiles = readTree(store, newTree);
+        auto o = oldFiles.begin();
+        auto n = newFiles.begin();
+        while (o != oldFiles.end() || n != newFiles.end()) {
+            if (n == newFiles.end() || (o != oldFiles.end() && o->first < n->first)) {
+                visit(o->first, o->second, "");
+                ++o;
+            } else if (o == oldFiles.end() || n->first < o->first) {
+                visit(n->first, "", n->second);
+                ++n;
+            } else {
+                if (o->second != n->second) visit(o->first, o->second, n->second);
+                ++o;
+                ++n;
+            }
+        }
+    }
+
+} // namespace gitcpp
@@ -0,0 +1,34 @@
+#pragma once
+#include "ObjectStore.hpp"
+#include "Objects.hpp"
+
+#include <functional>
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace gitcpp {
+
+    /// Helpers over per-directory tree objects (see Objects.hpp for the
+    /// format). Every helper also reads flat trees from older versions.
+
+    /// Store `files` (path -> blob id) as per-directory tree objects,
+    /// skipping trees that already exist. Returns the root tree id.
+    std::string writeTree(const ObjectStore& store, const std::map<std::string, std::string>& files);
+
+    /// Every file below a tree (path -> blob id); empty if the tree is
+    /// missing.
+    std::map<std::string, std::string> readTree(const ObjectStore& store, const std::string& treeId);
+
+    /// Blob id of `path` in a tree, reading only the directories on its way.
+    std::optional<std::string> findInTree(const ObjectStore& store, const std::string& treeId,
+                                          const std::string& path);
+
+    /// Report each path whose blob differs between two trees as
+    /// (path, old id, new id), with "" for a missing side, in path order.
+    /// Subtrees with equal ids are skipped without being read.
+    void diffTrees(const ObjectStore& store, const std::string& oldTree, const std::string& newTree,
+                   const std::function<void(const std::string&, const std::string&, const std::string&)>& visit);
+
+} // namespace gitcpp
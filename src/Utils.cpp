@@ -1,38 +1,182 @@
 #include "Utils.hpp"
 #include <iostream>
 #include <fstream>
-#include <sstream>
-#include <iomanip>
 #include <algorithm>
-#include <CommonCrypto/CommonDigest.h>
+#include <atomic>
+#include <cstring>
+#include <mutex>
+#include <set>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#endif
 
 namespace gitcpp {
 
+    // Read size for hashing files; a multiple of the SHA-1 block size
+    static constexpr std::size_t HASH_CHUNK = 1 << 20;
+    // Buffer size when copyContents() cannot copy in the kernel
+    static constexpr std::size_t COPY_CHUNK = 1 << 20;
+
     // sha1
 
     std::string sha1(const std::vector<unsigned char>& v) {
-        unsigned char out[CC_SHA1_DIGEST_LENGTH];
-        CC_SHA1(v.data(), static_cast<CC_LONG>(v.size()), out);
+        Sha1 hash;
+        hash.update(v.data(), v.size());
+        return hash.hexDigest();
+    }
+
+    std::string sha1(const std::string& s) {
+        Sha1 hash;
+        hash.update(s);
+        return hash.hexDigest();
+    }
 
-        std::ostringstream oss;
-        oss << std::hex << std::setfill('0');
-        for (size_t i = 0; i < sizeof(out); ++i) {
-            oss << std::setw(2) << static_cast<unsigned>(out[i]);
+    std::string sha1File(const std::filesystem::path& file) {
+        std::ifstream in(file, std::ios::binary);
+        if (!in) {
+            throw error("Could not open file: " + file.string());
         }
-        return oss.str();
+        Sha1 hash;
+        std::vector<char> chunk(HASH_CHUNK);
+        while (in) {
+            in.read(chunk.data(), static_cast<std::streamsize>(chunk.size()));
+            hash.update(chunk.data(), static_cast<std::size_t>(in.gcount()));
+        }
+        if (in.bad()) {
+            throw error("Could not read file: " + file.string());
+        }
+        return hash.hexDigest();
     }
 
-    std::string sha1(const std::string& s) {
-        const auto* p = reinterpret_cast<const unsigned char*>(s.data());
-        unsigned char out[CC_SHA1_DIGEST_LENGTH];
-        CC_SHA1(p, static_cast<CC_LONG>(s.size()), out);
+    // hex
+
+    std::string toHex(const unsigned char* raw, std::size_t n) {
+        static const char digits[] = "0123456789abcdef";
+        std::string out(n * 2, '0');
+        for (std::size_t i = 0; i < n; ++i) {
+            out[2 * i] = digits[raw[i] >> 4];
+            out[2 * i + 1] = digits[raw[i] & 0x0f];
+        }
+        return out;
+    }
+
+    static int hexValue(char c) {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+        return -1;
+    }
+
+    void fromHex(const std::string& hex, unsigned char* out) {
+        if (hex.size() % 2 != 0) {
+            throw error("Malformed hex string: " + hex);
+        }
+        for (std::size_t i = 0; i < hex.size() / 2; ++i) {
+            int hi = hexValue(hex[2 * i]);
+            int lo = hexValue(hex[2 * i + 1]);
+            if (hi < 0 || lo < 0) {
+                throw error("Malformed hex string: " + hex);
+            }
+            out[i] = static_cast<unsigned char>((hi << 4) | lo);
+        }
+    }
+
+    bool isObjectId(std::string_view s) {
+        if (s.size() != static_cast<std::size_t>(UID_LENGTH)) return false;
+        return std::all_of(s.begin(), s.end(), [](char c) {
+            return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f');
+        });
+    }
+
+    // big-endian
+
+    void putBE32(std::vector<unsigned char>& out, std::uint32_t v) {
+        for (int shift = 24; shift >= 0; shift -= 8) {
+            out.push_back(static_cast<unsigned char>(v >> shift));
+        }
+    }
+
+    void putBE64(std::vector<unsigned char>& out, std::uint64_t v) {
+        for (int shift = 56; shift >= 0; shift -= 8) {
+            out.push_back(static_cast<unsigned char>(v >> shift));
+        }
+    }
+
+    std::uint32_t getBE32(const unsigned char* p) {
+        return (std::uint32_t(p[0]) << 24) | (std::uint32_t(p[1]) << 16) |
+               (std::uint32_t(p[2]) << 8) | std::uint32_t(p[3]);
+    }
+
+    std::uint64_t getBE64(const unsigned char* p) {
+        return (std::uint64_t(getBE32(p)) << 32) | getBE32(p + 4);
+    }
+
+    void putTrailer(std::vector<unsigned char>& out) {
+        unsigned char checksum[Sha1::DIGEST_SIZE];
+        Sha1 hash;
+        hash.update(out.data(), out.size());
+        hash.digest(checksum);
+        out.insert(out.end(), checksum, checksum + Sha1::DIGEST_SIZE);
+    }
+
+    bool trailerMatches(const unsigned char* data, std::size_t size) {
+        if (size < Sha1::DIGEST_SIZE) return false;
+        unsigned char checksum[Sha1::DIGEST_SIZE];
+        Sha1 hash;
+        hash.update(data, size - Sha1::DIGEST_SIZE);
+        hash.digest(checksum);
+        return std::memcmp(checksum, data + size - Sha1::DIGEST_SIZE, Sha1::DIGEST_SIZE) == 0;
+    }
+
+    // MappedFile
+
+    MappedFile::MappedFile(const std::filesystem::path& file) {
+        int fd = ::open(file.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw error("Could not open file: " + file.string());
+        }
+        auto size = std::filesystem::file_size(file);
+        if (size > 0) {
+            void* p = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p == MAP_FAILED) {
+                ::close(fd);
+                throw error("Could not map file: " + file.string());
+            }
+            data_ = static_cast<const unsigned char*>(p);
+            size_ = size;
+        }
+        ::close(fd);
+    }
+
+    MappedFile::~MappedFile() { reset(); }
+
+    MappedFile::MappedFile(MappedFile&& other) noexcept
+        : data_(other.data_), size_(other.size_) {
+        other.data_ = nullptr;
+        other.size_ = 0;
+    }
+
+    MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+        if (this != &other) {
+            reset();
+            data_ = other.data_;
+            size_ = other.size_;
+            other.data_ = nullptr;
+            other.size_ = 0;
+        }
+        return *this;
+    }
 
-        std::ostringstream oss;
-        oss << std::hex << std::setfill('0');
-        for (size_t i = 0; i < sizeof(out); ++i) {
-            oss << std::setw(2) << static_cast<unsigned>(out[i]);
+    void MappedFile::reset() {
+        if (data_) {
+            ::munmap(const_cast<unsigned char*>(data_), size_);
         }
-        return oss.str();
+        data_ = nullptr;
+        size_ = 0;
     }
 
     // --- File I/O ---
@@ -68,17 +212,175 @@ namespace gitcpp {
         return std::string(bytes.begin(), bytes.end());
     }
 
-    void writeContents_impl_(const std::filesystem::path& file,
-        const std::vector<std::vector<unsigned char>>& chunks) {
-        std::ofstream ofs(file, std::ios::binary | std::ios::trunc);
-        if (!ofs) {
+    // --- Durability ---
+
+    namespace {
+
+        std::atomic<FsyncMode> currentFsyncMode{FsyncMode::Off};
+        std::mutex pendingMutex;
+        std::vector<std::filesystem::path> pendingWrites;
+
+        std::filesystem::path parentDir(const std::filesystem::path& file) {
+            return file.parent_path().empty() ? std::filesystem::path(".") : file.parent_path();
+        }
+
+        void fsyncPath(const std::filesystem::path& path) {
+            int fd = ::open(path.c_str(), O_RDONLY);
+            if (fd < 0) {
+                throw error("Could not open for syncing: " + path.string());
+            }
+            int ret = ::fsync(fd);
+            ::close(fd);
+            if (ret != 0) {
+                throw error("Could not sync: " + path.string());
+            }
+        }
+
+    } // namespace
+
+    void setFsyncMode(FsyncMode mode) { currentFsyncMode = mode; }
+    FsyncMode fsyncMode() { return currentFsyncMode; }
+
+    void durableRename(const std::filesystem::path& tmp, const std::filesystem::path& file, bool deferred) {
+        FsyncMode mode = currentFsyncMode;
+        if (mode == FsyncMode::Batch && deferred) {
+            // Renamed now so the object is visible, flushed with the batch.
+            // Until then nothing refers to it.
+            std::filesystem::rename(tmp, file);
+            std::lock_guard<std::mutex> lock(pendingMutex);
+            pendingWrites.push_back(file);
+            return;
+        }
+        if (mode != FsyncMode::Off) {
+            flushPendingWrites();
+            fsyncPath(tmp);
+        }
+        std::filesystem::rename(tmp, file);
+        if (mode != FsyncMode::Off) {
+            fsyncPath(parentDir(file));
+        }
+    }
+
+    void flushPendingWrites() {
+        std::vector<std::filesystem::path> files;
+        {
+            std::lock_guard<std::mutex> lock(pendingMutex);
+            files.swap(pendingWrites);
+        }
+        if (files.empty()) return;
+#ifdef __linux__
+        // One syncfs() flushes every file and directory on the filesystem
+        int fd = ::open(files.front().c_str(), O_RDONLY);
+        if (fd >= 0) {
+            int ret = ::syncfs(fd);
+            ::close(fd);
+            if (ret == 0) return;
+        }
+#endif
+        std::set<std::filesystem::path> dirs;
+        for (const auto& file : files) {
+            fsyncPath(file);
+            dirs.insert(parentDir(file));
+        }
+        for (const auto& dir : dirs) fsyncPath(dir);
+    }
+
+    namespace {
+
+        // Unique sibling of `file` to write before renaming over it
+        std::filesystem::path temporaryFor(const std::filesystem::path& file) {
+            static std::atomic<unsigned> counter{0};
+            return std::filesystem::path(file).concat(
+                ".tmp" + std::to_string(::getpid()) + "_" + std::to_string(counter++));
+        }
+
+        // Replacing a file keeps its permissions (e.g. executable scripts)
+        void keepPermissions(const std::filesystem::path& file, const std::filesystem::path& tmp) {
+            std::error_code ec;
+            auto status = std::filesystem::status(file, ec);
+            if (!ec && std::filesystem::is_regular_file(status)) {
+                std::filesystem::permissions(tmp, status.permissions(), ec);
+            }
+        }
+
+        // Copy the rest of `in` to `out` from their current offsets
+        bool copyDescriptor(int in, int out) {
+#ifdef __linux__
+            if (::ioctl(out, FICLONE, in) == 0) return true;
+            // Stops at the end of the input, or hands the rest to the buffered
+            // copy when the kernel or filesystem cannot do it (EXDEV, ENOSYS, ...)
+            for (;;) {
+                ssize_t n = ::copy_file_range(in, nullptr, out, nullptr, std::size_t(1) << 30, 0);
+                if (n == 0) return true;
+                if (n < 0) break;
+            }
+#endif
+            std::vector<char> buffer(COPY_CHUNK);
+            for (;;) {
+                ssize_t n = ::read(in, buffer.data(), buffer.size());
+                if (n == 0) return true;
+                if (n < 0) return false;
+                for (ssize_t done = 0; done < n;) {
+                    ssize_t written = ::write(out, buffer.data() + done, static_cast<std::size_t>(n - done));
+                    if (written < 0) return false;
+                    done += written;
+                }
+            }
+        }
+
+    } // namespace
+
+    void copyContents(const std::filesystem::path& source, const std::filesystem::path& file) {
+        int in = ::open(source.c_str(), O_RDONLY | O_CLOEXEC);
+        if (in < 0) {
+            throw error("Could not open file: " + source.string());
+        }
+        std::filesystem::path tmp = temporaryFor(file);
+        int out = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+        if (out < 0) {
+            ::close(in);
             throw error("Could not open for writing: " + file.string());
         }
-        for (const auto& chunk : chunks) {
-            ofs.write(reinterpret_cast<const char*>(chunk.data()), chunk.size());
+        bool copied = copyDescriptor(in, out);
+        ::close(in);
+        if (::close(out) != 0) copied = false;
+        try {
+            if (!copied) {
+                throw error("Error while writing to: " + file.string());
+            }
+            keepPermissions(file, tmp);
+            std::filesystem::rename(tmp, file);
+        } catch (...) {
+            std::error_code ignored;
+            std::filesystem::remove(tmp, ignored);
+            throw;
+        }
+    }
+
+    void detail::writeContents_impl_(const std::filesystem::path& file, const ByteRanges& chunks, WriteSync sync) {
+        std::filesystem::path tmp = temporaryFor(file);
+        try {
+            std::ofstream ofs(tmp, std::ios::binary | std::ios::trunc);
+            if (!ofs) {
+                throw error("Could not open for writing: " + file.string());
+            }
+            for (const auto& [data, size] : chunks) {
+                ofs.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+            }
+            ofs.close();
             if (!ofs) {
                 throw error("Error while writing to: " + file.string());
             }
+            keepPermissions(file, tmp);
+            if (sync == WriteSync::None) {
+                std::filesystem::rename(tmp, file);
+            } else {
+                durableRename(tmp, file, sync == WriteSync::Deferred);
+            }
+        } catch (...) {
+            std::error_code ignored;
+            std::filesystem::remove(tmp, ignored);
+            throw;
         }
     }
 
@@ -1,26 +1,77 @@
 #pragma once
 #include "GitcppException.hpp"
+#include "Sha1.hpp"
 
 #include <string>
+#include <string_view>
 #include <vector>
 #include <filesystem>
 #include <initializer_list>
 #include <type_traits>
+#include <utility>
+#include <cstddef>
+#include <cstdint>
 
 namespace gitcpp {
 
     /// Length of a full SHA-1 hex UID.
     inline constexpr int UID_LENGTH = 40;
 
-    /// SHA-1 helpers (macOS: CommonCrypto).
+    /// SHA-1 hex digest of a whole buffer (see Sha1.hpp).
     std::string sha1(const std::vector<unsigned char>& bytes);
     std::string sha1(const std::string& s);
 
+    /// SHA-1 hex digest of a file's contents, read in fixed-size chunks so
+    /// memory use does not depend on the file size.
+    std::string sha1File(const std::filesystem::path& file);
+
     /// Variadic SHA-1 of concatenation of byte arrays and/or strings.
     /// Accepts any mix of: std::vector<unsigned char>, std::string, const char*
     template <typename... Args>
     std::string sha1_concat(const Args&... parts);
 
+    /// Hex <-> raw conversion for 20-byte object ids.
+    std::string toHex(const unsigned char* raw, std::size_t n);
+    void fromHex(const std::string& hex, unsigned char* out);   // throws on malformed input
+
+    /// True if `s` looks like a full object id (40 lowercase hex digits).
+    bool isObjectId(std::string_view s);
+
+    /// Big-endian integer helpers used by the binary on-disk formats.
+    void putBE32(std::vector<unsigned char>& out, std::uint32_t v);
+    void putBE64(std::vector<unsigned char>& out, std::uint64_t v);
+    std::uint32_t getBE32(const unsigned char* p);
+    std::uint64_t getBE64(const unsigned char* p);
+
+    /// SHA-1 trailers of the binary on-disk formats: append the raw digest
+    /// of everything in `out`, and check that the last 20 bytes of `data`
+    /// are the digest of the rest.
+    void putTrailer(std::vector<unsigned char>& out);
+    bool trailerMatches(const unsigned char* data, std::size_t size);
+
+    /// Read-only mapping of a whole file (POSIX mmap). Empty files map to
+    /// an empty span.
+    class MappedFile {
+    public:
+        MappedFile() = default;
+        explicit MappedFile(const std::filesystem::path& file);   // throws on errors
+        ~MappedFile();
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+        MappedFile(MappedFile&& other) noexcept;
+        MappedFile& operator=(MappedFile&& other) noexcept;
+
+        const unsigned char* data() const { return data_; }
+        std::size_t size() const { return size_; }
+
+    private:
+        void reset();
+
+        const unsigned char* data_ = nullptr;
+        std::size_t size_ = 0;
+    };
+
     /// Delete file if it exists and is not a directory, but only if
     /// a sibling `.gitcpp` directory exists (same policy as restrictedDelete).
     bool restrictedDelete(const std::filesystem::path& file);
@@ -31,11 +82,41 @@ namespace gitcpp {
     /// Read entire file as UTF-8 string.
     std::string readContentsAsString(const std::filesystem::path& file);
 
-    /// Write concatenated contents to file (create/overwrite).
+    /// Write concatenated contents to file (create/overwrite). The data goes
+    /// to a temporary file that is renamed over `file`, so readers and
+    /// crashes never see a partly written file.
     /// Accepts any mix of std::vector<unsigned char>, std::string, const char*.
     template <typename... Args>
     void writeContents(const std::filesystem::path& file, const Args&... parts);
 
+    /// Replace `file` with a copy of `source`, through a temporary file like
+    /// writeContents(). On Linux the copy is a reflink (FICLONE) where the
+    /// filesystem supports it, else copy_file_range(); elsewhere, and when
+    /// both fail, the bytes are copied through a buffer.
+    void copyContents(const std::filesystem::path& source, const std::filesystem::path& file);
+
+    /// When repository writes are flushed to disk (`config core.fsync`):
+    ///   off    - never explicitly (the default)
+    ///   batch  - objects are flushed together, once, right before the next
+    ///            ref or index update, which is flushed itself
+    ///   always - every object, ref and index write is flushed on its own
+    enum class FsyncMode { Off, Batch, Always };
+    void setFsyncMode(FsyncMode mode);
+    FsyncMode fsyncMode();
+
+    /// Rename a fully written `tmp` over `file`, flushing it as the fsync
+    /// mode requires. `deferred` writes (objects) are flushed by the next
+    /// flushPendingWrites() in batch mode; the others flush the pending
+    /// writes first, so nothing can point at data that is not on disk.
+    void durableRename(const std::filesystem::path& tmp, const std::filesystem::path& file, bool deferred);
+
+    /// Like writeContents(), for repository data (objects, refs, index).
+    template <typename... Args>
+    void writeDurable(const std::filesystem::path& file, bool deferred, const Args&... parts);
+
+    /// Flush every deferred write with a single barrier.
+    void flushPendingWrites();
+
     /// Return sorted list of plain filenames inside a directory (or empty if not dir).
     std::vector<std::string> plainFilenamesIn(const std::filesystem::path& dir);
 
@@ -64,17 +145,14 @@ namespace gitcpp {
     namespace detail {
 
         // type traits: treat const char* as string data
-        inline void sha1_update_bytes(std::vector<unsigned char>& sink, const std::vector<unsigned char>& v) {
-            sink.insert(sink.end(), v.begin(), v.end());
+        inline void sha1_update_bytes(Sha1& hash, const std::vector<unsigned char>& v) {
+            hash.update(v.data(), v.size());
         }
-        inline void sha1_update_bytes(std::vector<unsigned char>& sink, const std::string& s) {
-            sink.insert(sink.end(), reinterpret_cast<const unsigned char*>(s.data()),
-                        reinterpret_cast<const unsigned char*>(s.data()) + s.size());
+        inline void sha1_update_bytes(Sha1& hash, const std::string& s) {
+            hash.update(s);
         }
-        inline void sha1_update_bytes(std::vector<unsigned char>& sink, const char* cstr) {
-            if (!cstr) return;
-            const auto* p = reinterpret_cast<const unsigned char*>(cstr);
-            while (*p) { sink.push_back(*p); ++p; }
+        inline void sha1_update_bytes(Sha1& hash, const char* cstr) {
+            if (cstr) hash.update(std::string_view(cstr));
         }
 
         template <typename T>
@@ -89,10 +167,9 @@ namespace gitcpp {
 
     template <typename... Args>
     std::string sha1_concat(const Args&... parts) {
-        std::vector<unsigned char> all;
-        all.reserve(1024);
-        (detail::sha1_update_bytes(all, parts), ...);
-        return sha1(all);
+        Sha1 hash;
+        (detail::sha1_update_bytes(hash, parts), ...);
+        return hash.hexDigest();
     }
 
     template <typename T>
@@ -114,34 +191,51 @@ namespace gitcpp {
         writeContents(file, bytes);
     }
 
+    namespace detail {
+
+        using ByteRanges = std::vector<std::pair<const void*, std::size_t>>;
+
+        // Byte ranges of the parts; the parts themselves are not copied
+        template <typename... Args>
+        ByteRanges byteRanges(const Args&... parts) {
+            ByteRanges chunks;
+            chunks.reserve(sizeof...(Args));
+
+            auto push_chunk = [&](const auto& piece) {
+                using P = std::decay_t<decltype(piece)>;
+                if constexpr (std::is_same_v<P, std::vector<unsigned char>>) {
+                    chunks.emplace_back(piece.data(), piece.size());
+                } else if constexpr (std::is_same_v<P, std::string>) {
+                    chunks.emplace_back(piece.data(), piece.size());
+                } else if constexpr (std::is_same_v<P, const char*>) {
+                    const char* s = piece ? piece : "";
+                    chunks.emplace_back(s, std::char_traits<char>::length(s));
+                } else {
+                    static_assert(!sizeof(P), "writeContents() only accepts std::vector<unsigned char>, std::string, or const char*");
+                }
+            };
+
+            (push_chunk(parts), ...);
+            return chunks;
+        }
+
+        // How a write is flushed: not at all, with the next batch, or now
+        enum class WriteSync { None, Deferred, Immediate };
+
+        // The non-template sink (defined in Utils.cpp)
+        void writeContents_impl_(const std::filesystem::path& file, const ByteRanges& chunks, WriteSync sync);
+
+    } // namespace detail
+
     template <typename... Args>
     void writeContents(const std::filesystem::path& file, const Args&... parts) {
-        // Implemented in Utils.cpp via helper that takes a vector of byte chunks.
-        std::vector<std::vector<unsigned char>> chunks;
-        chunks.reserve(sizeof...(Args));
-
-        auto push_chunk = [&](const auto& piece) {
-            using P = std::decay_t<decltype(piece)>;
-            if constexpr (std::is_same_v<P, std::vector<unsigned char>>) {
-                chunks.emplace_back(piece);
-            } else if constexpr (std::is_same_v<P, std::string>) {
-                chunks.emplace_back(reinterpret_cast<const unsigned char*>(piece.data()),
-                                    reinterpret_cast<const unsigned char*>(piece.data()) + piece.size());
-            } else if constexpr (std::is_same_v<P, const char*>) {
-                const char* s = piece ? piece : "";
-                chunks.emplace_back(reinterpret_cast<const unsigned char*>(s),
-                                    reinterpret_cast<const unsigned char*>(s) + std::char_traits<char>::length(s));
-            } else {
-                static_assert(!sizeof(P), "writeContents() only accepts std::vector<unsigned char>, std::string, or const char*");
-            }
-        };
-
-        (push_chunk(parts), ...);
-
-        // call the non-template sink (defined in Utils.cpp)
-        extern void writeContents_impl_(const std::filesystem::path& file,
-                                        const std::vector<std::vector<unsigned char>>& chunks);
-        writeContents_impl_(file, chunks);
+        detail::writeContents_impl_(file, detail::byteRanges(parts...), detail::WriteSync::None);
+    }
+
+    template <typename... Args>
+    void writeDurable(const std::filesystem::path& file, bool deferred, const Args&... parts) {
+        detail::writeContents_impl_(file, detail::byteRanges(parts...),
+                                    deferred ? detail::WriteSync::Deferred : detail::WriteSync::Immediate);
     }
 
 } // namespace gitcpp
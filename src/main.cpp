@@ -12,6 +12,7 @@ using gitcpp::commands::log;
 using gitcpp::commands::globalLog;
 using gitcpp::commands::find;
 using gitcpp::commands::status;
+using gitcpp::commands::diff;
 using gitcpp::commands::restore;
 using gitcpp::commands::branch;
 using gitcpp::commands::switchBranch;
@@ -19,6 +20,10 @@ using gitcpp::commands::rmBranch;
 using gitcpp::commands::reset;
 using gitcpp::commands::merge;
 using gitcpp::commands::config;
+using gitcpp::commands::repack;
+using gitcpp::commands::commitGraphWrite;
+using gitcpp::commands::bitmapWrite;
+using gitcpp::commands::gc;
 
 static void exitError(const std::string& msg) {
     std::cout << msg << "\n";
@@ -30,19 +35,23 @@ int main(int argc, char** argv) {
         exitError("Please enter a command.");
     }
 
-    std::string firstArg = argv[1];
+    std::vector<std::string> argList(argv + 1, argv + argc);
+    if (!gitcpp::commands::parseGlobalOptions(argList)) {
+        exitError("Invalid thread count.");
+    }
+    if (argList.empty()) {
+        exitError("Please enter a command.");
+    }
 
-    
-    std::vector<std::string> args;
-    args.reserve(argc - 2);
-    for (int i = 2; i < argc; ++i) args.emplace_back(argv[i]);
+    std::string firstArg = argList[0];
+    std::vector<std::string> args(argList.begin() + 1, argList.end());
 
     if (firstArg == "init") {
         init();
 
     } else if (firstArg == "add") {
         if (args.size() < 1) exitError("Missing file operand.");
-        add(args[0]);
+        add(args);
 
     } else if (firstArg == "commit") {
         if (args.size() < 1) exitError("Please enter a commit message.");
@@ -61,18 +70,22 @@ int main(int argc, char** argv) {
 
     } else if (firstArg == "find") {
         if (args.size() < 1) exitError("Missing message operand.");
-        find(args[0]);
+        if (args[0] == "--contains" || args[0] == "--word") {
+            if (args.size() < 2) exitError("Missing message operand.");
+            find(args[1], args[0]);
+        } else {
+            find(args[0]);
+        }
 
     } else if (firstArg == "status") {
         status();
 
+    } else if (firstArg == "diff") {
+        if (args.size() > 2) exitError("Usage: diff [--staged | <commit> <commit>]");
+        diff(args);
+
     } else if (firstArg == "restore") {
-        {
-            std::vector<std::string> full;
-            full.reserve(argc - 1);
-            for (int i = 1; i < argc; ++i) full.emplace_back(argv[i]);
-            restore(full);
-        }
+        restore(argList);
 
     } else if (firstArg == "branch") {
         if (args.size() < 1) exitError("Missing branch name.");
@@ -98,6 +111,24 @@ int main(int argc, char** argv) {
         if (args.size() < 2) exitError("Missing config key and value.");
         config(args[0], args[1]);
 
+    } else if (firstArg == "repack") {
+        if (args.size() > 1 || (args.size() == 1 && args[0] != "-a")) exitError("Usage: repack [-a]");
+        repack(args.size() == 1);
+
+    } else if (firstArg == "commit-graph") {
+        if (args.size() != 1 || args[0] != "write") exitError("Usage: commit-graph write");
+        commitGraphWrite();
+
+    } else if (firstArg == "bitmap") {
+        if (args.size() != 1 || args[0] != "write") exitError("Usage: bitmap write");
+        bitmapWrite();
+
+    } else if (firstArg == "gc") {
+        if (args.size() > 1 || (args.size() == 1 && args[0].rfind("--prune=", 0) != 0)) {
+            exitError("Usage: gc [--prune=<seconds>|--prune=now]");
+        }
+        gc(args.empty() ? "" : args[0].substr(8));
+
     } else {
         exitError("No command with that name exists.");
     }
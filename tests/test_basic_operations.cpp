@@ -2,7 +2,11 @@
 #include <filesystem>
 #include <fstream>
 #include "Commands.hpp"
+#include "Index.hpp"
+#include "ObjectStore.hpp"
 #include "Repository.hpp"
+#include "ThreadPool.hpp"
+#include "Tree.hpp"
 #include "Utils.hpp"
 
 namespace fs = std::filesystem;
@@ -48,8 +52,10 @@ TEST_F(BasicOperationsTest, AddAndCommitFile) {
     
     // Check that commit was created
     EXPECT_TRUE(fs::exists(".gitcpp/commits"));
-    auto commits = gitcpp::plainFilenamesIn(".gitcpp/commits");
+    gitcpp::ObjectStore store(gitcpp::Repository::open());
+    auto commits = store.list(gitcpp::ObjectKind::Commit);
     EXPECT_EQ(commits.size(), 1);
+    EXPECT_TRUE(fs::exists(fs::path(".gitcpp/commits") / commits[0].substr(0, 2) / commits[0].substr(2)));
 }
 
 TEST_F(BasicOperationsTest, ConfigStoresValues) {
@@ -66,4 +72,334 @@ TEST_F(BasicOperationsTest, ConfigStoresValues) {
     
     EXPECT_EQ(name, "Test User");
     EXPECT_EQ(email, "test@example.com");
-}
\ No newline at end of file
+}
+
+TEST_F(BasicOperationsTest, IndexStoresSortedBinaryEntries) {
+    gitcpp::Repository repo(true);  // Force init for testing
+
+    gitcpp::Index index(repo.INDEX);
+    for (const char* path : {"b.txt", "dir/a.txt", "a.txt"}) {
+        gitcpp::IndexEntry entry;
+        entry.path = path;
+        entry.id = gitcpp::sha1(std::string(path));
+        entry.size = 42;
+        index.set(entry);
+    }
+    index.write();
+
+    gitcpp::Index reopened(repo.INDEX);
+    auto entries = reopened.entries();
+    ASSERT_EQ(entries.size(), 3);
+    EXPECT_EQ(entries[0].path, "a.txt");
+    EXPECT_EQ(entries[2].path, "dir/a.txt");
+    ASSERT_TRUE(reopened.get("b.txt").has_value());
+    EXPECT_EQ(reopened.get("b.txt")->id, gitcpp::sha1(std::string("b.txt")));
+    EXPECT_EQ(reopened.get("b.txt")->size, 42);
+    EXPECT_FALSE(reopened.contains("c.txt"));
+
+    reopened.erase("a.txt");
+    reopened.write();
+    EXPECT_EQ(gitcpp::Index(repo.INDEX).entries().size(), 2);
+}
+
+TEST_F(BasicOperationsTest, SmallIndexChangesGoToTheDelta) {
+    gitcpp::Repository repo(true);  // Force init for testing
+
+    gitcpp::Index index(repo.INDEX);
+    for (int i = 0; i < 100; ++i) {
+        gitcpp::IndexEntry entry;
+        entry.path = "file" + std::to_string(i) + ".txt";
+        entry.id = gitcpp::sha1(entry.path);
+        index.set(entry);
+    }
+    index.write();
+    fs::path delta = fs::path(repo.INDEX).concat(".delta");
+    EXPECT_FALSE(fs::exists(delta));
+    auto base = gitcpp::readContents(repo.INDEX);
+
+    // A few changes leave the index file alone
+    gitcpp::IndexEntry changed;
+    changed.path = "file7.txt";
+    changed.id = gitcpp::sha1(std::string("changed"));
+    index.set(changed);
+    index.erase("file8.txt");
+    index.write();
+    EXPECT_TRUE(fs::exists(delta));
+    EXPECT_EQ(gitcpp::readContents(repo.INDEX), base);
+    gitcpp::Index reopened(repo.INDEX);
+    EXPECT_EQ(reopened.entries().size(), 99);
+    EXPECT_EQ(reopened.get("file7.txt")->id, changed.id);
+    EXPECT_FALSE(reopened.contains("file8.txt"));
+
+    // Many changes are merged into a new index file
+    for (int i = 0; i < 20; ++i) reopened.erase("file" + std::to_string(50 + i) + ".txt");
+    reopened.write();
+    EXPECT_FALSE(fs::exists(delta));
+    EXPECT_EQ(gitcpp::Index(repo.INDEX).entries().size(), 79);
+    EXPECT_EQ(gitcpp::Index(repo.INDEX).get("file7.txt")->id, changed.id);
+
+    // A damaged index is rejected
+    auto bytes = gitcpp::readContents(repo.INDEX);
+    bytes[bytes.size() / 2] ^= 1;
+    gitcpp::writeContents(repo.INDEX, bytes);
+    EXPECT_THROW(gitcpp::Index{repo.INDEX}, GitcppException);
+}
+
+TEST_F(BasicOperationsTest, CommitKeepsUnchangedFiles) {
+    gitcpp::Repository repo(true);  // Force init for testing
+
+    std::ofstream("first.txt") << "first";
+    gitcpp::commands::add("first.txt");
+    gitcpp::commands::commit("First");
+    std::ofstream("second.txt") << "second";
+    gitcpp::commands::add("second.txt");
+    gitcpp::commands::commit("Second");
+
+    fs::remove("first.txt");
+    gitcpp::commands::restore({"restore", "first.txt"});
+    EXPECT_EQ(gitcpp::readContentsAsString("first.txt"), "first");
+}
+
+TEST_F(BasicOperationsTest, LegacyFileMapIsConverted) {
+    gitcpp::Repository repo(true);  // Force init for testing
+
+    std::ofstream("legacy.txt") << "legacy";
+    gitcpp::writeContents(repo.FILE_MAP, "legacy.txt:" + gitcpp::sha1(std::string("legacy")) + "\n");
+    gitcpp::ObjectStore(repo).write(gitcpp::ObjectKind::Blob, gitcpp::sha1(std::string("legacy")), std::string("legacy"));
+    gitcpp::commands::commit("From legacy map");
+
+    EXPECT_FALSE(fs::exists(repo.FILE_MAP));
+    EXPECT_TRUE(gitcpp::Index(repo.INDEX).contains("legacy.txt"));
+    EXPECT_EQ(gitcpp::ObjectStore(repo).list(gitcpp::ObjectKind::Commit).size(), 1);
+}
+
+TEST_F(BasicOperationsTest, StatusTrustsStatDataUnlessRacy) {
+    gitcpp::Repository repo(true);  // Force init for testing
+
+    std::ofstream("cached.txt") << "cached";
+    gitcpp::commands::add("cached.txt");
+    gitcpp::commands::commit("Cached");
+
+    auto status = []() {
+        testing::internal::CaptureStdout();
+        gitcpp::commands::status();
+        return testing::internal::GetCapturedStdout();
+    };
+
+    // A same-size edit changes the stat data and is caught
+    std::ofstream("cached.txt") << "CACHED";
+    EXPECT_NE(status().find("cached.txt (modified)"), std::string::npos);
+    std::ofstream("cached.txt") << "cached";
+    EXPECT_EQ(status().find("cached.txt (modified)"), std::string::npos);
+
+    // Matching stat data is trusted without reading the file...
+    gitcpp::IndexEntry entry = *gitcpp::Index(repo.INDEX).get("cached.txt");
+    ASSERT_TRUE(gitcpp::statEntry("cached.txt", entry));
+    entry.id = gitcpp::sha1(std::string("something else"));
+    gitcpp::Index index(repo.INDEX);
+    index.set(entry);
+    index.write();
+    EXPECT_EQ(status().find("cached.txt (modified)"), std::string::npos);
+
+    // ...unless the file is no older than the index itself
+    fs::last_write_time("cached.txt", fs::file_time_type::clock::now() + std::chrono::hours(1));
+    ASSERT_TRUE(gitcpp::statEntry("cached.txt", entry));
+    gitcpp::Index racy(repo.INDEX);
+    racy.set(entry);
+    racy.write();
+    EXPECT_NE(status().find("cached.txt (modified)"), std::string::npos);
+}
+
+TEST_F(BasicOperationsTest, ThreadPoolRunsEveryIndexOnce) {
+    gitcpp::ThreadPool pool(4);
+    std::vector<int> hits(1000, 0);
+    pool.parallelFor(hits.size(), [&](std::size_t i) { hits[i]++; });
+    EXPECT_EQ(std::count(hits.begin(), hits.end(), 1), 1000);
+
+    EXPECT_THROW(pool.parallelFor(10, [](std::size_t i) {
+        if (i == 7) throw gitcpp::error("task failed");
+    }), GitcppException);
+}
+
+TEST_F(BasicOperationsTest, ThreadOptionOnlyPrecedesTheCommand) {
+    gitcpp::Repository repo(true);  // Force init for testing
+    std::ofstream("a.txt") << "a";
+    gitcpp::commands::add("a.txt");
+
+    std::vector<std::string> args = {"-j", "2", "-j3", "commit", "-j fix threading"};
+    ASSERT_TRUE(gitcpp::commands::parseGlobalOptions(args));
+    EXPECT_EQ(args, (std::vector<std::string>{"commit", "-j fix threading"}));
+    EXPECT_EQ(gitcpp::ThreadPool::shared(repo).size(), 3);
+    gitcpp::ThreadPool::setRequestedThreads(0);
+
+    gitcpp::commands::commit(args[1]);
+    testing::internal::CaptureStdout();
+    gitcpp::commands::log();
+    std::string out = testing::internal::GetCapturedStdout();
+    EXPECT_NE(out.find("-j fix threading"), std::string::npos) << out;
+
+    std::vector<std::string> bad = {"-jx", "status"};
+    EXPECT_FALSE(gitcpp::commands::parseGlobalOptions(bad));
+}
+
+TEST_F(BasicOperationsTest, ParallelStatusKeepsOrder) {
+    gitcpp::Repository repo(true);  // Force init for testing
+    gitcpp::commands::config("core.threads", "4");
+
+    for (int i = 0; i < 50; ++i) {
+        std::string name = "file" + std::to_string(i) + ".txt";
+        std::ofstream(name) << "version 1 of " << name;
+        gitcpp::commands::add(name);
+    }
+    gitcpp::commands::commit("Many files");
+    EXPECT_EQ(gitcpp::ThreadPool::shared(repo).size(), 4);
+
+    std::string expected;
+    for (int i : {1, 10, 12, 25, 3, 49}) {
+        std::string name = "file" + std::to_string(i) + ".txt";
+        std::ofstream(name) << "version 2 of " << name;
+    }
+    for (const char* name : {"file1.txt", "file10.txt", "file12.txt", "file25.txt", "file3.txt", "file49.txt"}) {
+        expected += std::string(name) + " (modified)\n";
+    }
+
+    testing::internal::CaptureStdout();
+    gitcpp::commands::status();
+    std::string out = testing::internal::GetCapturedStdout();
+    EXPECT_NE(out.find("=== Modifications Not Staged For Commit ===\n" + expected), std::string::npos) << out;
+}
+
+TEST_F(BasicOperationsTest, TreesAreHierarchicalAndShared) {
+    gitcpp::Repository repo(true);  // Force init for testing
+    gitcpp::ObjectStore store(repo);
+
+    std::map<std::string, std::string> files = {
+        {"b.txt", gitcpp::sha1(std::string("b1"))},
+        {"dir/a.txt", gitcpp::sha1(std::string("a"))},
+        {"dir/sub/c.txt", gitcpp::sha1(std::string("c"))},
+        {"dir.txt", gitcpp::sha1(std::string("d"))},
+    };
+    std::string first = gitcpp::writeTree(store, files);
+    EXPECT_EQ(gitcpp::readTree(store, first), files);
+    EXPECT_EQ(gitcpp::findInTree(store, first, "dir/sub/c.txt"), files["dir/sub/c.txt"]);
+    EXPECT_FALSE(gitcpp::findInTree(store, first, "dir/sub").has_value());
+
+    files["b.txt"] = gitcpp::sha1(std::string("b2"));
+    std::string second = gitcpp::writeTree(store, files);
+    auto subtree = [&](const std::string& tree) {
+        for (const auto& entry : store.tree(tree)->entries) {
+            if (entry.isTree && entry.name == "dir") return entry.id;
+        }
+        return std::string();
+    };
+    EXPECT_NE(first, second);
+    EXPECT_EQ(subtree(first), subtree(second));
+
+    files.erase("dir/a.txt");
+    files["dir/sub/e.txt"] = gitcpp::sha1(std::string("e"));
+    std::string third = gitcpp::writeTree(store, files);
+    std::vector<std::string> changed;
+    gitcpp::diffTrees(store, first, third, [&](const std::string& path, const std::string&, const std::string&) {
+        changed.push_back(path);
+    });
+    EXPECT_EQ(changed, (std::vector<std::string>{"b.txt", "dir/a.txt", "dir/sub/e.txt"}));
+
+    // Flat trees from older repositories are still understood
+    std::string legacy = "b.txt:" + files["b.txt"] + "\ndir/sub/c.txt:" + files["dir/sub/c.txt"] + "\n";
+    std::string legacy_id = gitcpp::sha1(legacy);
+    store.write(gitcpp::ObjectKind::Blob, legacy_id, legacy);
+    EXPECT_EQ(gitcpp::findInTree(store, legacy_id, "dir/sub/c.txt"), files["dir/sub/c.txt"]);
+    changed.clear();
+    gitcpp::diffTrees(store, legacy_id, third, [&](const std::string& path, const std::string&, const std::string&) {
+        changed.push_back(path);
+    });
+    EXPECT_EQ(changed, (std::vector<std::string>{"dir.txt", "dir/sub/e.txt"}));
+}
+
+TEST_F(BasicOperationsTest, LargeFilesAreStreamedIntoTheStore) {
+    gitcpp::Repository repo(true);  // Force init for testing
+
+    // Past the streaming threshold and not a multiple of the chunk size
+    std::string content;
+    for (int i = 0; content.size() < (9u << 20) + 123; ++i) {
+        content += "line " + std::to_string(i) + "\n";
+    }
+    std::ofstream("big.bin", std::ios::binary) << content;
+    std::string expected = gitcpp::sha1(content);
+    EXPECT_EQ(gitcpp::sha1File("big.bin"), expected);
+
+    gitcpp::commands::add("big.bin");
+    auto entry = gitcpp::Index(repo.INDEX).get("big.bin");
+    ASSERT_TRUE(entry.has_value());
+    EXPECT_EQ(entry->id, expected);
+    gitcpp::ObjectStore store(repo);
+    EXPECT_EQ(store.readAsString(gitcpp::ObjectKind::Blob, expected), content);
+    EXPECT_LT(fs::file_size(repo.BLOBS / expected.substr(0, 2) / expected.substr(2)), content.size());
+
+    // Uncompressed objects are copied through as well
+    gitcpp::commands::config("core.compression", "0");
+    std::ofstream("big.bin", std::ios::app | std::ios::binary) << "more";
+    gitcpp::commands::add("big.bin");
+    std::string grown = gitcpp::sha1(content + "more");
+    EXPECT_EQ(gitcpp::Index(repo.INDEX).get("big.bin")->id, grown);
+    EXPECT_EQ(gitcpp::ObjectStore(repo).readAsString(gitcpp::ObjectKind::Blob, grown), content + "more");
+}
+
+TEST(Sha1Test, MatchesKnownDigests) {
+    EXPECT_EQ(gitcpp::sha1(std::string()), "da39a3ee5e6b4b0d3255bfef95601890afd80709");
+    EXPECT_EQ(gitcpp::sha1(std::string("abc")), "a9993e364706816aba3e25717850c26c9cd0d89d");
+    EXPECT_EQ(gitcpp::sha1(std::string("abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq")),
+              "84983e441c3bd26ebaae4aa1f95129e5e54670f1");
+    EXPECT_EQ(gitcpp::sha1(std::string(1000000, 'a')), "34aa973cd4c4daa4f61eeb2bdbad27316534016f");
+}
+
+TEST(Sha1Test, IncrementalUpdatesMatchOneShot) {
+    std::string data;
+    for (int i = 0; i < 1000; ++i) data += static_cast<char>(i * 31 + 7);
+    std::string expected = gitcpp::sha1(data);
+
+    // Chunk sizes that straddle the 64-byte block boundary in every way
+    for (std::size_t chunk : {1, 3, 63, 64, 65, 200}) {
+        gitcpp::Sha1 hash;
+        for (std::size_t pos = 0; pos < data.size(); pos += chunk) {
+            hash.update(std::string_view(data).substr(pos, chunk));
+        }
+        EXPECT_EQ(hash.hexDigest(), expected) << "chunk " << chunk;
+    }
+    EXPECT_EQ(gitcpp::sha1_concat(data.substr(0, 10), "", data.substr(10)), expected);
+}
+
+TEST_F(BasicOperationsTest, AddWalksDirectoriesAndSkipsIgnoredFiles) {
+    gitcpp::Repository repo(true);  // Force init for testing
+    fs::create_directories("src/nested");
+    fs::create_directories("build");
+    std::ofstream("top.txt") << "top";
+    std::ofstream("src/a.cpp") << "a";
+    std::ofstream("src/nested/b.cpp") << "b";
+    std::ofstream("src/.hidden") << "h";
+    std::ofstream("src/a.log") << "log";
+    std::ofstream("build/out.o") << "o";
+    std::ofstream(".gitcppignore") << "*.log\nbuild\n";
+
+    gitcpp::commands::add(std::vector<std::string>{"src"});
+    std::vector<std::string> paths;
+    for (const auto& entry : gitcpp::Index(repo.INDEX).entries()) paths.push_back(entry.path);
+    EXPECT_EQ(paths, (std::vector<std::string>{"src/a.cpp", "src/nested/b.cpp"}));
+
+    gitcpp::commands::add(std::vector<std::string>{".", "./top.txt"});
+    paths.clear();
+    for (const auto& entry : gitcpp::Index(repo.INDEX).entries()) paths.push_back(entry.path);
+    EXPECT_EQ(paths, (std::vector<std::string>{"src/a.cpp", "src/nested/b.cpp", "top.txt"}));
+    EXPECT_EQ(gitcpp::Index(repo.INDEX).get("src/nested/b.cpp")->id, gitcpp::sha1(std::string("b")));
+
+    // status reads the same patterns, including later edits
+    testing::internal::CaptureStdout();
+    gitcpp::commands::status();
+    std::string out = testing::internal::GetCapturedStdout();
+    EXPECT_EQ(out.find("a.log"), std::string::npos) << out;
+    std::ofstream(".gitcppignore") << "build\n";
+    testing::internal::CaptureStdout();
+    gitcpp::commands::status();
+    out = testing::internal::GetCapturedStdout();
+    EXPECT_NE(out.find("=== Untracked Files ===\nsrc/a.log\n"), std::string::npos) << out;
+}
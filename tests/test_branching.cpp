@@ -1,6 +1,9 @@
 #include <gtest/gtest.h>
+#include <chrono>
 #include <filesystem>
 #include <fstream>
+#include <string>
+#include <vector>
 #include "Commands.hpp"
 #include "Repository.hpp"
 #include "Utils.hpp"
@@ -53,4 +56,65 @@ TEST_F(BranchingTest, DeleteBranch) {
     
     gitcpp::commands::rmBranch("temp_branch");
     EXPECT_FALSE(fs::exists(".gitcpp/heads/temp_branch"));
-}
\ No newline at end of file
+}
+
+TEST_F(BranchingTest, SwitchOnlyTouchesChangedFiles) {
+    fs::create_directories("dir");
+    std::ofstream("dir/gone.txt") << "gone";
+    std::ofstream("changed.txt") << "main version";
+    gitcpp::commands::add(std::vector<std::string>{"dir/gone.txt", "changed.txt"});
+    gitcpp::commands::commit("Main files");
+    gitcpp::commands::branch("feature");
+    gitcpp::commands::switchBranch("feature", "");
+
+    std::ofstream("changed.txt") << "feature version";
+    gitcpp::commands::remove("dir/gone.txt");
+    gitcpp::commands::add("changed.txt");
+    gitcpp::commands::commit("Feature files");
+
+    // Age the unchanged file so a rewrite would be visible
+    auto old_time = fs::last_write_time("initial.txt") - std::chrono::hours(1);
+    fs::last_write_time("initial.txt", old_time);
+
+    gitcpp::commands::switchBranch("main", "");
+    EXPECT_EQ(fs::last_write_time("initial.txt"), old_time);
+    EXPECT_EQ(gitcpp::readContentsAsString("changed.txt"), "main version");
+    EXPECT_EQ(gitcpp::readContentsAsString("dir/gone.txt"), "gone");
+
+    gitcpp::commands::switchBranch("feature", "");
+    EXPECT_EQ(fs::last_write_time("initial.txt"), old_time);
+    EXPECT_EQ(gitcpp::readContentsAsString("changed.txt"), "feature version");
+    EXPECT_FALSE(fs::exists("dir"));
+}
+
+TEST_F(BranchingTest, SwitchChecksOutNestedTreesInParallel) {
+    gitcpp::commands::config("core.threads", "4");
+    gitcpp::commands::branch("feature");
+    gitcpp::commands::switchBranch("feature", "");
+
+    std::vector<std::string> paths;
+    for (int i = 0; i < 40; ++i) {
+        fs::path path = fs::path("src") / ("mod" + std::to_string(i % 5)) / ("sub" + std::to_string(i % 3)) /
+                        ("file" + std::to_string(i) + ".txt");
+        fs::create_directories(path.parent_path());
+        std::ofstream(path) << "contents of " << path.string();
+        paths.push_back(path.string());
+    }
+    gitcpp::commands::add(std::vector<std::string>{"src"});
+    gitcpp::commands::commit("Nested files");
+
+    gitcpp::commands::switchBranch("main", "");
+    EXPECT_FALSE(fs::exists("src"));
+
+    gitcpp::commands::switchBranch("feature", "");
+    for (const std::string& path : paths) {
+        EXPECT_EQ(gitcpp::readContentsAsString(path), "contents of " + path);
+    }
+
+    // A reset rewrites every file of the target commit
+    fs::remove_all("src");
+    gitcpp::commands::reset(gitcpp::readContentsAsString(".gitcpp/heads/feature"));
+    for (const std::string& path : paths) {
+        EXPECT_EQ(gitcpp::readContentsAsString(path), "contents of " + path);
+    }
+}
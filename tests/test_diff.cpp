@@ -0,0 +1,238 @@
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+#include "Commands.hpp"
+#include "Diff.hpp"
+#include "ObjectStore.hpp"
+#include "Rename.hpp"
+#include "Repository.hpp"
+#include "Utils.hpp"
+
+namespace fs = std::filesystem;
+
+class DiffTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        test_dir = fs::temp_directory_path() / "gitcpp_diff_test";
+        fs::remove_all(test_dir);
+        fs::create_directories(test_dir);
+        fs::current_path(test_dir);
+    }
+
+    void TearDown() override {
+        fs::current_path(fs::temp_directory_path());
+        fs::remove_all(test_dir);
+    }
+
+    // Apply `regions` to `oldLines`, checking that unchanged lines agree
+    static std::string applyRegions(const std::vector<std::string_view>& oldLines,
+                                    const std::vector<std::string_view>& newLines,
+                                    const std::vector<gitcpp::DiffRegion>& regions) {
+        std::string out;
+        std::size_t i = 0, j = 0;
+        for (const gitcpp::DiffRegion& region : regions) {
+            EXPECT_EQ(region.oldStart - i, region.newStart - j);
+            for (; i < region.oldStart; ++i, ++j) {
+                EXPECT_EQ(oldLines[i], newLines[j]);
+                out += oldLines[i];
+            }
+            for (std::size_t k = 0; k < region.newCount; ++k) out += newLines[region.newStart + k];
+            i += region.oldCount;
+            j += region.newCount;
+        }
+        for (; i < oldLines.size(); ++i) out += oldLines[i];
+        return out;
+    }
+
+    fs::path test_dir;
+};
+
+TEST_F(DiffTest, RegionsTurnOldIntoNew) {
+    std::mt19937 random(42);
+    for (int round = 0; round < 200; ++round) {
+        // Few distinct lines, so repeated lines force the Myers fallback
+        std::string oldText, newText;
+        int oldSize = random() % 60, newSize = random() % 60;
+        int alphabet = 2 + random() % 10;
+        for (int i = 0; i < oldSize; ++i) oldText += "line " + std::to_string(random() % alphabet) + "\n";
+        for (int i = 0; i < newSize; ++i) newText += "line " + std::to_string(random() % alphabet) + "\n";
+
+        auto oldLines = gitcpp::splitLines(oldText);
+        auto newLines = gitcpp::splitLines(newText);
+        auto regions = gitcpp::diffLines(oldLines, newLines);
+        EXPECT_EQ(applyRegions(oldLines, newLines, regions), newText);
+        for (std::size_t r = 1; r < regions.size(); ++r) {
+            EXPECT_GT(regions[r].oldStart, regions[r - 1].oldStart + regions[r - 1].oldCount);
+        }
+    }
+
+    // Different enough to hit the Myers cost limit; still a valid script
+    std::string oldText, newText;
+    for (int i = 0; i < 3000; ++i) {
+        oldText += random() % 2 ? "x\n" : "y\n";
+        newText += random() % 2 ? "x\n" : "y\n";
+    }
+    auto oldLines = gitcpp::splitLines(oldText);
+    auto newLines = gitcpp::splitLines(newText);
+    EXPECT_EQ(applyRegions(oldLines, newLines, gitcpp::diffLines(oldLines, newLines)), newText);
+}
+
+TEST_F(DiffTest, HistogramKeepsUniqueLinesAligned) {
+    std::string oldText = "a\n}\nb\n}\nc\n";
+    std::string newText = "a\n}\nnew\n}\nb\n}\nc\n";
+    auto regions = gitcpp::diffLines(gitcpp::splitLines(oldText), gitcpp::splitLines(newText));
+    ASSERT_EQ(regions.size(), 1u);
+    EXPECT_EQ(regions[0].oldCount, 0u);
+    EXPECT_EQ(regions[0].newCount, 2u);
+}
+
+TEST_F(DiffTest, UnifiedDiffFormat) {
+    std::string oldText, newText;
+    for (int i = 1; i <= 20; ++i) {
+        oldText += std::to_string(i) + "\n";
+        newText += (i == 3 ? std::string("three") : std::to_string(i)) + "\n";
+    }
+    newText += "21";
+    EXPECT_EQ(gitcpp::unifiedDiff(oldText, newText, "a/f", "b/f"),
+              "--- a/f\n+++ b/f\n"
+              "@@ -1,6 +1,6 @@\n 1\n 2\n-3\n+three\n 4\n 5\n 6\n"
+              "@@ -18,3 +18,4 @@\n 18\n 19\n 20\n+21\n\\ No newline at end of file\n");
+    EXPECT_EQ(gitcpp::unifiedDiff(oldText, oldText, "a/f", "b/f"), "");
+    EXPECT_EQ(gitcpp::unifiedDiff("", "x\n", "/dev/null", "b/f"), "--- /dev/null\n+++ b/f\n@@ -0,0 +1 @@\n+x\n");
+}
+
+TEST_F(DiffTest, DiffCommandModes) {
+    gitcpp::Repository repo(true);  // Force init for testing
+    std::ofstream("a.txt") << "one\ntwo\n";
+    std::ofstream("b.txt") << "same\n";
+    gitcpp::commands::add(std::vector<std::string>{"a.txt", "b.txt"});
+    gitcpp::commands::commit("First");
+    std::string first = gitcpp::readContentsAsString(".gitcpp/heads/main");
+
+    std::ofstream("a.txt") << "one\n2\n";
+    testing::internal::CaptureStdout();
+    gitcpp::commands::diff({});
+    EXPECT_EQ(testing::internal::GetCapturedStdout(),
+              "diff --git a/a.txt b/a.txt\n--- a/a.txt\n+++ b/a.txt\n@@ -1,2 +1,2 @@\n one\n-two\n+2\n");
+
+    gitcpp::commands::add("a.txt");
+    std::ofstream("c.txt") << "new\n";
+    gitcpp::commands::add("c.txt");
+    testing::internal::CaptureStdout();
+    gitcpp::commands::diff({});
+    EXPECT_EQ(testing::internal::GetCapturedStdout(), "");
+    testing::internal::CaptureStdout();
+    gitcpp::commands::diff({"--staged"});
+    std::string staged = testing::internal::GetCapturedStdout();
+    EXPECT_NE(staged.find("-two\n+2\n"), std::string::npos) << staged;
+    EXPECT_NE(staged.find("new file\n--- /dev/null\n+++ b/c.txt\n@@ -0,0 +1 @@\n+new\n"), std::string::npos) << staged;
+    EXPECT_EQ(staged.find("b.txt"), std::string::npos) << staged;
+
+    gitcpp::commands::commit("Second");
+    testing::internal::CaptureStdout();
+    gitcpp::commands::diff({first, "main"});
+    EXPECT_EQ(testing::internal::GetCapturedStdout(), staged);
+}
+
+TEST_F(DiffTest, Merge3TakesEachSidesChanges) {
+    std::string base = "a\nb\nc\nd\ne\n";
+    auto clean = gitcpp::merge3(base, "A\nb\nc\nd\ne\n", "a\nb\nc\nd\nE\nf\n", "ours", "theirs");
+    EXPECT_EQ(clean.conflicts, 0u);
+    EXPECT_EQ(clean.text, "A\nb\nc\nd\nE\nf\n");
+
+    // The same change on both sides is taken once
+    auto same = gitcpp::merge3(base, "a\nB\nc\nd\ne\n", "a\nB\nc\nd\nE\n", "ours", "theirs");
+    EXPECT_EQ(same.conflicts, 0u);
+    EXPECT_EQ(same.text, "a\nB\nc\nd\nE\n");
+
+    // Common lines are moved out of the conflict
+    auto conflict = gitcpp::merge3(base, "a\nx\nB\nc\nd\ne\n", "a\ny\nB\nc\nd\ne\n", "ours", "theirs");
+    EXPECT_EQ(conflict.conflicts, 1u);
+    EXPECT_EQ(conflict.text, "a\n<<<<<<< ours\nx\n=======\ny\n>>>>>>> theirs\nB\nc\nd\ne\n");
+
+    // Files added on both sides merge against an empty base
+    auto added = gitcpp::merge3("", "same\nmine", "same\ntheirs", "ours", "theirs");
+    EXPECT_EQ(added.conflicts, 1u);
+    EXPECT_EQ(added.text, "same\n<<<<<<< ours\nmine\n=======\ntheirs\n>>>>>>> theirs\n");
+}
+
+TEST_F(DiffTest, RenamesPairBySimilarity) {
+    std::string body;
+    for (int i = 0; i < 20; ++i) body += "shared line " + std::to_string(i) + "\n";
+    gitcpp::Sketch sketch(body);
+    EXPECT_EQ(sketch.similarity(gitcpp::Sketch(body)), 100u);
+    EXPECT_EQ(sketch.similarity(gitcpp::Sketch("unrelated\n")), 0u);
+    unsigned half = sketch.similarity(gitcpp::Sketch(body.substr(0, body.size() / 2)));
+    EXPECT_GE(half, 45u);
+    EXPECT_LE(half, 55u);
+
+    gitcpp::Repository repo(true);  // Force init for testing
+    gitcpp::ObjectStore store(repo);
+    auto blob = [&](const std::string& contents) {
+        std::string id = gitcpp::sha1(contents);
+        store.write(gitcpp::ObjectKind::Blob, id, contents);
+        return id;
+    };
+    std::string edited = body + "one more line\n";
+    std::map<std::string, std::string> deleted = {
+        {"moved.txt", blob("moved as is\n")}, {"edited.txt", blob(body)}, {"gone.txt", blob("gone\n")}};
+    std::map<std::string, std::string> added = {
+        {"a/moved.txt", blob("moved as is\n")}, {"b/edited.txt", blob(edited)}, {"fresh.txt", blob("fresh\n")}};
+
+    auto renames = gitcpp::detectRenames(store, deleted, added, gitcpp::RenameOptions());
+    ASSERT_EQ(renames.size(), 2u);
+    EXPECT_EQ(renames[0].oldPath, "moved.txt");
+    EXPECT_EQ(renames[0].newPath, "a/moved.txt");
+    EXPECT_EQ(renames[0].similarity, 100u);
+    EXPECT_EQ(renames[1].oldPath, "edited.txt");
+    EXPECT_EQ(renames[1].newPath, "b/edited.txt");
+    EXPECT_LT(renames[1].similarity, 100u);
+    EXPECT_GE(renames[1].similarity, 90u);
+
+    // Below the threshold the edited file is no longer a rename
+    gitcpp::RenameOptions strict;
+    strict.threshold = 99;
+    EXPECT_EQ(gitcpp::detectRenames(store, deleted, added, strict).size(), 1u);
+
+    // Copies may come from files that still exist
+    gitcpp::RenameOptions copies;
+    copies.copies = true;
+    std::map<std::string, std::string> kept = {{"gone.txt", deleted["gone.txt"]}, {"kept.txt", blob(body)}};
+    auto copied = gitcpp::detectRenames(store, {}, {{"copy.txt", blob(edited)}}, copies, kept);
+    ASSERT_EQ(copied.size(), 1u);
+    EXPECT_EQ(copied[0].oldPath, "kept.txt");
+    EXPECT_TRUE(copied[0].copy);
+
+    // The diff command shows the rename instead of a delete and an add
+    std::ofstream("edited.txt") << body;
+    gitcpp::commands::add("edited.txt");
+    gitcpp::commands::commit("Add");
+    gitcpp::commands::remove("edited.txt");
+    std::ofstream("renamed.txt") << edited;
+    gitcpp::commands::add("renamed.txt");
+    testing::internal::CaptureStdout();
+    gitcpp::commands::diff({"--staged"});
+    std::string out = testing::internal::GetCapturedStdout();
+    EXPECT_EQ(out.rfind("diff --git a/edited.txt b/renamed.txt\nsimilarity index ", 0), 0u) << out;
+    EXPECT_NE(out.find("rename from edited.txt\nrename to renamed.txt\n--- a/edited.txt\n+++ b/renamed.txt\n"),
+              std::string::npos) << out;
+    EXPECT_NE(out.find("+one more line\n"), std::string::npos) << out;
+    EXPECT_EQ(out.find("deleted file"), std::string::npos) << out;
+    testing::internal::CaptureStdout();
+    gitcpp::commands::status();
+    out = testing::internal::GetCapturedStdout();
+    EXPECT_NE(out.find("=== Staged Files ===\nedited.txt -> renamed.txt\n"), std::string::npos) << out;
+
+    // Copies keep their source, and status says so
+    gitcpp::commands::commit("Rename");
+    gitcpp::commands::config("rename.copies", "true");
+    std::ofstream("copy.txt") << edited;
+    gitcpp::commands::add("copy.txt");
+    testing::internal::CaptureStdout();
+    gitcpp::commands::status();
+    out = testing::internal::GetCapturedStdout();
+    EXPECT_NE(out.find("=== Staged Files ===\nrenamed.txt => copy.txt (copy)\n"), std::string::npos) << out;
+}
@@ -0,0 +1,394 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include "Bitmap.hpp"
+#include "BitmapIndex.hpp"
+#include "Commands.hpp"
+#include "Commit.hpp"
+#include "CommitGraph.hpp"
+#include "LayerChain.hpp"
+#include "MergeBase.hpp"
+#include "MessageIndex.hpp"
+#include "ObjectCache.hpp"
+#include "ObjectStore.hpp"
+#include "Reachability.hpp"
+#include "ThreadPool.hpp"
+#include "Repository.hpp"
+#include "Utils.hpp"
+
+namespace fs = std::filesystem;
+
+class HistoryTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        test_dir = fs::temp_directory_path() / "gitcpp_history_test";
+        fs::remove_all(test_dir);
+        fs::create_directories(test_dir);
+        fs::current_path(test_dir);
+
+        gitcpp::Repository repo(true);  // Force init for testing
+    }
+
+    void TearDown() override {
+        fs::current_path(fs::temp_directory_path());
+        fs::remove_all(test_dir);
+    }
+
+    // Commit a new version of `file` and return the new head
+    std::string commitFile(const std::string& file, const std::string& content) {
+        std::ofstream(file) << content;
+        gitcpp::commands::add(file);
+        gitcpp::commands::commit("Update " + file + " to " + content);
+        gitcpp::Repository repo = gitcpp::Repository::open();
+        return gitcpp::readContentsAsString(repo.HEADS / gitcpp::readContentsAsString(repo.CURRENT_BRANCH));
+    }
+
+    fs::path test_dir;
+};
+
+TEST_F(HistoryTest, CommitsAreAddedToTheGraph) {
+    std::vector<std::string> commits;
+    for (int i = 0; i < 20; ++i) {
+        commits.push_back(commitFile("file.txt", "version " + std::to_string(i)));
+    }
+
+    gitcpp::Repository repo = gitcpp::Repository::open();
+    gitcpp::CommitGraph graph(repo);
+    ASSERT_EQ(graph.size(), 20);
+    EXPECT_LE(graph.layerCount(), 5);
+    for (std::size_t i = 0; i < commits.size(); ++i) {
+        std::uint32_t pos = graph.find(commits[i]);
+        ASSERT_NE(pos, gitcpp::CommitGraph::NOT_FOUND);
+        EXPECT_EQ(graph.generation(pos), i + 1);
+        EXPECT_GT(graph.timestamp(pos), 0);
+        auto parents = graph.parents(pos);
+        if (i == 0) {
+            EXPECT_TRUE(parents.empty());
+        } else {
+            ASSERT_EQ(parents.size(), 1);
+            EXPECT_EQ(graph.id(parents[0]), commits[i - 1]);
+        }
+    }
+    EXPECT_EQ(graph.find(gitcpp::sha1(std::string("not a commit"))), gitcpp::CommitGraph::NOT_FOUND);
+}
+
+TEST_F(HistoryTest, GraphRecordsMergesAndCanBeRebuilt) {
+    std::string base = commitFile("a.txt", "a");
+    gitcpp::commands::branch("feature");
+    std::string ours = commitFile("b.txt", "b");
+    gitcpp::commands::switchBranch("feature", "");
+    std::string theirs = commitFile("c.txt", "c");
+    gitcpp::commands::switchBranch("main", "");
+    gitcpp::commands::merge("feature");
+
+    gitcpp::Repository repo = gitcpp::Repository::open();
+    std::string merge = gitcpp::readContentsAsString(repo.HEADS / "main");
+
+    // A lost graph is rebuilt from scratch by the next commit
+    fs::remove_all(repo.COMMIT_GRAPHS);
+    std::string next = commitFile("d.txt", "d");
+    gitcpp::CommitGraph graph(repo);
+    EXPECT_EQ(graph.size(), 5);
+
+    std::uint32_t pos = graph.find(merge);
+    ASSERT_NE(pos, gitcpp::CommitGraph::NOT_FOUND);
+    EXPECT_EQ(graph.generation(pos), 3);
+    std::vector<std::string> parents;
+    for (std::uint32_t parent : graph.parents(pos)) parents.push_back(graph.id(parent));
+    EXPECT_EQ(parents, (std::vector<std::string>{ours, theirs}));
+    EXPECT_EQ(graph.tree(pos).size(), 40);
+
+    gitcpp::commands::commitGraphWrite();
+    gitcpp::CommitGraph rebuilt(repo);
+    EXPECT_EQ(rebuilt.layerCount(), 1);
+    EXPECT_EQ(rebuilt.size(), 5);
+    EXPECT_EQ(rebuilt.generation(rebuilt.find(next)), 4);
+    EXPECT_EQ(rebuilt.generation(rebuilt.find(base)), 1);
+
+    // A damaged layer is rejected
+    for (const auto& entry : fs::directory_iterator(repo.COMMIT_GRAPHS)) {
+        if (entry.path().extension() != ".graph") continue;
+        auto bytes = gitcpp::readContents(entry.path());
+        bytes[bytes.size() / 2] ^= 1;
+        gitcpp::writeContents(entry.path(), bytes);
+    }
+    EXPECT_THROW(gitcpp::CommitGraph{repo}, GitcppException);
+}
+
+TEST_F(HistoryTest, MergeBaseIsTheNearestCommonAncestor) {
+    commitFile("a.txt", "root");
+    std::string fork = commitFile("a.txt", "fork");
+    gitcpp::commands::branch("feature");
+    std::string ours;
+    for (int i = 0; i < 5; ++i) ours = commitFile("a.txt", "main " + std::to_string(i));
+    gitcpp::commands::switchBranch("feature", "");
+    std::string theirs;
+    for (int i = 0; i < 3; ++i) theirs = commitFile("b.txt", "feature " + std::to_string(i));
+
+    gitcpp::Repository repo = gitcpp::Repository::open();
+    gitcpp::ObjectStore store(repo);
+    gitcpp::CommitGraph graph(repo);
+    EXPECT_EQ(gitcpp::mergeBases(graph, store, ours, theirs), std::vector<std::string>{fork});
+    EXPECT_EQ(gitcpp::mergeBases(graph, store, theirs, fork), std::vector<std::string>{fork});
+    EXPECT_EQ(gitcpp::mergeBases(graph, store, ours, ours), std::vector<std::string>{ours});
+}
+
+TEST_F(HistoryTest, CrissCrossHistoryHasTwoMergeBases) {
+    gitcpp::Repository repo = gitcpp::Repository::open();
+    gitcpp::ObjectStore store(repo);
+    std::string tree = gitcpp::sha1(std::string("tree"));
+    auto make = [&](const std::vector<std::string>& parents, const std::string& message) {
+        Commit commit(tree, parents, message);
+        store.write(gitcpp::ObjectKind::Commit, commit.getCommitHash(), commit.getCommitContents());
+        return commit.getCommitHash();
+    };
+    std::string root = make({}, "root");
+    std::string a1 = make({root}, "a1");
+    std::string b1 = make({root}, "b1");
+    std::string a2 = make({a1, b1}, "a2");
+    std::string b2 = make({b1, a1}, "b2");
+    std::string a3 = make({a2}, "a3");
+
+    std::vector<std::string> expected = {a1, b1};
+    std::sort(expected.begin(), expected.end());
+    auto sorted = [](std::vector<std::string> ids) {
+        std::sort(ids.begin(), ids.end());
+        return ids;
+    };
+
+    // From commit objects alone, then from the commit-graph
+    EXPECT_EQ(sorted(gitcpp::mergeBases(gitcpp::CommitGraph(repo), store, a3, b2)), expected);
+    gitcpp::CommitGraph::update(repo, store, {a3, b2});
+    gitcpp::CommitGraph graph(repo);
+    ASSERT_EQ(graph.size(), 6);
+    EXPECT_EQ(sorted(gitcpp::mergeBases(graph, store, a3, b2)), expected);
+    EXPECT_EQ(gitcpp::mergeBases(graph, store, a3, b1), std::vector<std::string>{b1});
+}
+
+TEST_F(HistoryTest, DecodedObjectsAreSharedBetweenStores) {
+    commitFile("a.txt", "one");
+    std::string head = commitFile("a.txt", "two");
+
+    gitcpp::Repository repo = gitcpp::Repository::open();
+    gitcpp::ObjectStore first(repo);
+    gitcpp::ObjectStore second(repo);
+    auto commit = first.commit(head);
+    ASSERT_NE(commit, nullptr);
+    EXPECT_EQ(commit, second.commit(head));
+    EXPECT_EQ(commit->parents.size(), 1u);
+    EXPECT_EQ(commit->view.message, "Update a.txt to two\n");
+    EXPECT_EQ(first.tree(commit->tree), second.tree(commit->tree));
+    EXPECT_EQ(first.commit(std::string(40, '0')), nullptr);
+}
+
+TEST(LruCacheTest, EvictsLeastRecentlyUsed) {
+    gitcpp::LruCache<int> cache(3);
+    cache.put("a", std::make_shared<int>(1), 1);
+    cache.put("b", std::make_shared<int>(2), 1);
+    cache.put("c", std::make_shared<int>(3), 1);
+    ASSERT_NE(cache.get("a"), nullptr);
+    cache.put("d", std::make_shared<int>(4), 1);
+    EXPECT_EQ(cache.size(), 3u);
+    EXPECT_EQ(cache.get("b"), nullptr);
+    EXPECT_EQ(*cache.get("a"), 1);
+
+    cache.setCapacity(1);
+    EXPECT_EQ(cache.size(), 1u);
+    EXPECT_NE(cache.get("a"), nullptr);
+}
+
+TEST(LayerChainTest, NewLayersFoldSmallLayersBelowThem) {
+    EXPECT_EQ(gitcpp::LayerChain::foldCount({}, 5), 0u);
+    EXPECT_EQ(gitcpp::LayerChain::foldCount({100, 10}, 5), 1u);          // 10 <= 2 * 5, 100 > 2 * 15
+    EXPECT_EQ(gitcpp::LayerChain::foldCount({30, 10}, 5), 2u);           // 30 <= 2 * 15
+    EXPECT_EQ(gitcpp::LayerChain::foldCount({100, 11}, 5), 0u);
+}
+
+TEST(CommitParserTest, ViewsPointIntoTheBuffer) {
+    std::string tree(40, 'a');
+    Commit merge(tree, {std::string(40, 'b'), std::string(40, 'c')}, "Merge\n\nDetails");
+    const std::string& contents = merge.getCommitContents();
+
+    gitcpp::CommitView view;
+    ASSERT_TRUE(gitcpp::parseCommit(std::string_view(contents), view));
+    EXPECT_EQ(view.tree, tree);
+    ASSERT_EQ(view.parents.size(), 2u);
+    EXPECT_EQ(view.parents[1], std::string(40, 'c'));
+    EXPECT_EQ(view.message, "Merge\n\nDetails\n");
+    EXPECT_EQ(view.timestamp, merge.getTimestamp());
+    EXPECT_GE(view.tree.data(), contents.data());
+    EXPECT_LT(view.message.data(), contents.data() + contents.size());
+    EXPECT_EQ(view.headers.substr(0, 5), "tree ");
+
+    EXPECT_FALSE(gitcpp::parseCommit(std::string_view("commit 4\0junk", 13), view));
+}
+
+TEST_F(HistoryTest, BitmapsRoundTripThroughEwah) {
+    std::mt19937 random(7);
+    gitcpp::Bitmap bits;
+    for (std::size_t pos = 100; pos < 5000; ++pos) bits.set(pos);        // a long run of ones
+    for (int i = 0; i < 300; ++i) bits.set(5000 + random() % 20000);       // sparse literals
+    bits.set(200000);                                                       // after a long run of zeros
+
+    std::vector<std::uint64_t> ewah = bits.encode();
+    EXPECT_LT(ewah.size(), 400u);
+    gitcpp::Bitmap decoded;
+    decoded.orEncoded(ewah);
+    EXPECT_EQ(decoded.count(), bits.count());
+    for (std::size_t pos = 0; pos < 210000; ++pos) {
+        ASSERT_EQ(decoded.test(pos), bits.test(pos)) << pos;
+        ASSERT_EQ(gitcpp::Bitmap::testEncoded(ewah, pos), bits.test(pos)) << pos;
+    }
+}
+
+TEST_F(HistoryTest, BitmapsAnswerAncestryAndReachability) {
+    std::vector<std::string> mainline;
+    for (int i = 0; i < 150; ++i) mainline.push_back(commitFile("a.txt", "main " + std::to_string(i)));
+    gitcpp::Repository repo = gitcpp::Repository::open();
+    gitcpp::ObjectStore store(repo);
+    gitcpp::commands::reset(mainline[100]);
+    gitcpp::commands::branch("feature");
+    gitcpp::commands::reset(mainline[149]);
+    gitcpp::commands::switchBranch("feature", "");
+    std::vector<std::string> side;
+    fs::create_directories("dir");
+    for (int i = 0; i < 3; ++i) side.push_back(commitFile("dir/b.txt", "feature " + std::to_string(i)));
+    gitcpp::commands::switchBranch("main", "");
+
+    testing::internal::CaptureStdout();
+    gitcpp::commands::bitmapWrite();
+    std::string out = testing::internal::GetCapturedStdout();
+    EXPECT_NE(out.find("over 153 commits"), std::string::npos) << out;
+    gitcpp::BitmapIndex bitmaps(repo);
+    EXPECT_GE(bitmaps.bitmapCount(), 4u);   // both heads and spaced commits
+    EXPECT_EQ(bitmaps.commitCount(), 153u);
+
+    // Ancestry agrees with the merge-base walk, before and after commits
+    // the bitmaps do not know
+    gitcpp::CommitGraph graph(repo);
+    auto check = [&](const gitcpp::BitmapIndex& index, const gitcpp::CommitGraph& g,
+                     const std::vector<std::string>& commits) {
+        for (const std::string& a : commits) {
+            for (const std::string& b : commits) {
+                bool expected = gitcpp::mergeBases(g, store, a, b) == std::vector<std::string>{a};
+                EXPECT_EQ(index.isAncestor(g, store, a, b), expected) << a << " " << b;
+            }
+        }
+    };
+    std::vector<std::string> sample = {mainline[0], mainline[63], mainline[100], mainline[101], mainline[149],
+                                       side[0], side[2]};
+    check(bitmaps, graph, sample);
+
+    std::string newer = commitFile("a.txt", "after the bitmaps");
+    sample.push_back(newer);
+    gitcpp::CommitGraph newerGraph(repo);
+    check(bitmaps, newerGraph, sample);
+
+    // Marking through the bitmaps finds exactly what the full walk finds
+    auto& pool = gitcpp::ThreadPool::shared(repo);
+    gitcpp::Reachable walked = gitcpp::markReachable(newerGraph, store, pool, {newer, side[2]}, {}, {});
+    gitcpp::Reachable marked = gitcpp::markReachable(newerGraph, store, pool, {newer, side[2]}, {}, {}, &bitmaps);
+    EXPECT_EQ(marked.commits, walked.commits);
+    EXPECT_EQ(marked.objects, walked.objects);
+    EXPECT_EQ(walked.commits.size(), 154u);
+
+    // A fast-forward is recognised from the bitmaps
+    gitcpp::commands::switchBranch("feature", "");
+    gitcpp::commands::reset(mainline[149]);
+    testing::internal::CaptureStdout();
+    gitcpp::commands::merge("main");
+    out = testing::internal::GetCapturedStdout();
+    EXPECT_NE(out.find("Fast-forward merge completed."), std::string::npos) << out;
+    EXPECT_EQ(gitcpp::readContentsAsString("a.txt"), "after the bitmaps");
+
+    // A damaged bitmap file is rejected
+    auto bytes = gitcpp::readContents(repo.BITMAP);
+    bytes[bytes.size() / 2] ^= 1;
+    gitcpp::writeContents(repo.BITMAP, bytes);
+    EXPECT_THROW(gitcpp::BitmapIndex{repo}, GitcppException);
+}
+
+TEST_F(HistoryTest, MessageIndexAnswersExactSubstringAndWordQueries) {
+    std::vector<std::string> commits;
+    for (int i = 0; i < 9; ++i) {
+        commits.push_back(commitFile("file.txt", "v" + std::to_string(i)));
+    }
+    gitcpp::commands::branch("feature");
+    std::string ours = commitFile("a.txt", "Fix-Parser");
+    gitcpp::commands::switchBranch("feature", "");
+    std::string theirs = commitFile("b.txt", "fix-parser");
+    gitcpp::commands::switchBranch("main", "");
+    gitcpp::commands::merge("feature");
+
+    gitcpp::Repository repo = gitcpp::Repository::open();
+    std::string merge = gitcpp::readContentsAsString(repo.HEADS / "main");
+    gitcpp::MessageIndex index(repo);
+    ASSERT_TRUE(index.exists());
+    EXPECT_EQ(index.size(), 12);
+    EXPECT_TRUE(index.contains(merge));
+
+    EXPECT_EQ(index.exact("Update file.txt to v3"), std::vector<std::string>{commits[3]});
+    EXPECT_EQ(index.exact("Merge branch 'feature'"), std::vector<std::string>{merge});
+    EXPECT_TRUE(index.exact("Update file.txt to v").empty());
+
+    auto sorted = [](std::vector<std::string> ids) {
+        std::sort(ids.begin(), ids.end());
+        return ids;
+    };
+    EXPECT_EQ(index.containing("to Fix-P"), std::vector<std::string>{ours});
+    EXPECT_EQ(index.containing("e file.txt to v"), sorted(commits));
+    EXPECT_EQ(index.containing("ch 'fe"), std::vector<std::string>{merge});
+    EXPECT_TRUE(index.containing("to fix-parser now").empty());
+
+    EXPECT_EQ(index.withWords("PARSER fix"), sorted({ours, theirs}));
+    EXPECT_EQ(index.withWords("a.txt"), std::vector<std::string>{ours});
+    EXPECT_TRUE(index.withWords("parser missing").empty());
+    EXPECT_TRUE(index.withWords("  ").empty());
+
+    // A lost index is rebuilt as one layer
+    fs::remove_all(repo.MESSAGE_INDEX);
+    gitcpp::ObjectStore store(repo);
+    EXPECT_EQ(gitcpp::MessageIndex::write(repo, store), 12);
+    gitcpp::MessageIndex rebuilt(repo);
+    EXPECT_EQ(rebuilt.size(), 12);
+    EXPECT_EQ(rebuilt.exact("Update b.txt to fix-parser"), std::vector<std::string>{theirs});
+
+    // A damaged layer is rejected
+    for (const auto& entry : fs::directory_iterator(repo.MESSAGE_INDEX)) {
+        if (entry.path().extension() != ".midx") continue;
+        auto bytes = gitcpp::readContents(entry.path());
+        bytes[bytes.size() / 2] ^= 1;
+        gitcpp::writeContents(entry.path(), bytes);
+    }
+    EXPECT_THROW(gitcpp::MessageIndex{repo}, GitcppException);
+}
+
+TEST_F(HistoryTest, GlobalLogIsTheSameOnAnyNumberOfThreads) {
+    std::vector<std::string> commits;
+    for (int i = 0; i < 30; ++i) {
+        commits.push_back(commitFile("file.txt", "line one " + std::to_string(i)));
+    }
+    std::sort(commits.begin(), commits.end());
+
+    auto globalLog = [](unsigned threads) {
+        gitcpp::ThreadPool::setRequestedThreads(threads);
+        testing::internal::CaptureStdout();
+        gitcpp::commands::globalLog();
+        return testing::internal::GetCapturedStdout();
+    };
+    std::string serial = globalLog(1);
+    std::string parallel = globalLog(4);
+    gitcpp::ThreadPool::setRequestedThreads(0);
+    EXPECT_EQ(parallel, serial);
+
+    // One entry per commit, in id order
+    std::size_t at = 0;
+    for (const std::string& id : commits) {
+        std::size_t next = serial.find("===\ncommit " + id + "\n", at);
+        ASSERT_NE(next, std::string::npos) << id;
+        at = next + 1;
+    }
+    EXPECT_NE(serial.find("\n    Update file.txt to line one 7\n\n"), std::string::npos);
+}
@@ -1,6 +1,7 @@
 #include <gtest/gtest.h>
 #include <filesystem>
 #include <fstream>
+#include <string>
 #include "Commands.hpp"
 #include "Repository.hpp"
 #include "Utils.hpp"
@@ -82,4 +83,87 @@ TEST_F(MergingTest, ConflictDetection) {
     EXPECT_TRUE(content.find("<<<<<<< HEAD") != std::string::npos);
     EXPECT_TRUE(content.find("=======") != std::string::npos);
     EXPECT_TRUE(content.find(">>>>>>> shared.txt") != std::string::npos);
-}
\ No newline at end of file
+}
+
+TEST_F(MergingTest, DisjointEditsMergeCleanly) {
+    std::ofstream("config.txt") << "name = app\nport = 80\nhost = local\nmode = dev\nlevel = info\n";
+    gitcpp::commands::add("config.txt");
+    gitcpp::commands::commit("Add config");
+    gitcpp::commands::branch("feature");
+
+    std::ofstream("config.txt") << "name = app\nport = 8080\nhost = local\nmode = dev\nlevel = info\n";
+    gitcpp::commands::add("config.txt");
+    gitcpp::commands::commit("Change port");
+
+    gitcpp::commands::switchBranch("feature", "");
+    std::ofstream("config.txt") << "name = app\nport = 80\nhost = local\nmode = dev\nlevel = debug\n";
+    gitcpp::commands::add("config.txt");
+    std::ofstream("extra.txt") << "extra";
+    gitcpp::commands::add("extra.txt");
+    gitcpp::commands::commit("Change level");
+
+    gitcpp::commands::switchBranch("main", "");
+    testing::internal::CaptureStdout();
+    gitcpp::commands::merge("feature");
+    std::string out = testing::internal::GetCapturedStdout();
+    EXPECT_NE(out.find("Auto-merging config.txt"), std::string::npos) << out;
+    EXPECT_NE(out.find("Merge completed successfully."), std::string::npos) << out;
+
+    // The merged result is committed and checked out
+    EXPECT_EQ(gitcpp::readContentsAsString("config.txt"),
+              "name = app\nport = 8080\nhost = local\nmode = dev\nlevel = debug\n");
+    EXPECT_EQ(gitcpp::readContentsAsString("extra.txt"), "extra");
+    testing::internal::CaptureStdout();
+    gitcpp::commands::status();
+    out = testing::internal::GetCapturedStdout();
+    EXPECT_NE(out.find("=== Modifications Not Staged For Commit ===\n\n"), std::string::npos) << out;
+}
+
+TEST_F(MergingTest, ConflictMarkersCoverOnlyDifferingLines) {
+    gitcpp::commands::branch("feature");
+    std::ofstream("shared.txt") << "Line 1: Original\nLine 2: MAIN\nLine 3: Original\nLine 4: MAIN";
+    gitcpp::commands::add("shared.txt");
+    gitcpp::commands::commit("Main change");
+
+    gitcpp::commands::switchBranch("feature", "");
+    std::ofstream("shared.txt") << "Line 1: FEATURE\nLine 2: FEATURE\nLine 3: Original\nLine 4: MAIN";
+    gitcpp::commands::add("shared.txt");
+    gitcpp::commands::commit("Feature change");
+
+    gitcpp::commands::switchBranch("main", "");
+    testing::internal::CaptureStdout();
+    gitcpp::commands::merge("feature");
+    testing::internal::GetCapturedStdout();
+    EXPECT_EQ(gitcpp::readContentsAsString("shared.txt"),
+              "<<<<<<< HEAD\nLine 1: Original\nLine 2: MAIN\n=======\nLine 1: FEATURE\nLine 2: FEATURE\n"
+              ">>>>>>> shared.txt\nLine 3: Original\nLine 4: MAIN");
+}
+
+TEST_F(MergingTest, EditFollowsRenameOnOtherBranch) {
+    std::string body;
+    for (int i = 1; i <= 10; ++i) body += "line " + std::to_string(i) + "\n";
+    std::ofstream("old.txt") << body;
+    gitcpp::commands::add("old.txt");
+    gitcpp::commands::commit("Add file");
+    gitcpp::commands::branch("feature");
+
+    // main renames the file and edits its top; feature edits its bottom
+    gitcpp::commands::remove("old.txt");
+    std::ofstream("new.txt") << "LINE 1\n" << body.substr(body.find('\n') + 1);
+    gitcpp::commands::add("new.txt");
+    gitcpp::commands::commit("Rename file");
+
+    gitcpp::commands::switchBranch("feature", "");
+    std::ofstream("old.txt") << body << "line 11\n";
+    gitcpp::commands::add("old.txt");
+    gitcpp::commands::commit("Extend file");
+
+    gitcpp::commands::switchBranch("main", "");
+    testing::internal::CaptureStdout();
+    gitcpp::commands::merge("feature");
+    std::string out = testing::internal::GetCapturedStdout();
+    EXPECT_NE(out.find("Auto-merging new.txt"), std::string::npos) << out;
+    EXPECT_NE(out.find("Merge completed successfully."), std::string::npos) << out;
+    EXPECT_FALSE(fs::exists("old.txt"));
+    EXPECT_EQ(gitcpp::readContentsAsString("new.txt"), "LINE 1\n" + body.substr(body.find('\n') + 1) + "line 11\n");
+}
@@ -0,0 +1,395 @@
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <chrono>
+#include <fstream>
+#include "Commands.hpp"
+#include "ObjectStore.hpp"
+#include "Pack.hpp"
+#include "Repository.hpp"
+#include "Utils.hpp"
+
+namespace fs = std::filesystem;
+
+class PackfileTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        test_dir = fs::temp_directory_path() / "gitcpp_pack_test";
+        fs::remove_all(test_dir);
+        fs::create_directories(test_dir);
+        fs::current_path(test_dir);
+
+        // Several revisions of one large, mostly unchanged file
+        gitcpp::Repository repo(true);  // Force init for testing
+        for (int rev = 0; rev < 5; ++rev) {
+            std::ofstream file("big.txt");
+            for (int i = 0; i < 200; ++i) {
+                file << "line " << i << (i == rev * 10 ? " changed" : "") << "\n";
+            }
+            file.close();
+            gitcpp::commands::add("big.txt");
+            gitcpp::commands::commit("Revision " + std::to_string(rev));
+        }
+    }
+
+    void TearDown() override {
+        fs::current_path(fs::temp_directory_path());
+        fs::remove_all(test_dir);
+    }
+
+    fs::path test_dir;
+};
+
+TEST_F(PackfileTest, DeltaRoundTrip) {
+    std::string base_text(5000, 'a');
+    std::string target_text = base_text.substr(0, 2000) + "inserted" + base_text.substr(2500);
+    std::vector<unsigned char> base(base_text.begin(), base_text.end());
+    std::vector<unsigned char> target(target_text.begin(), target_text.end());
+
+    auto delta = gitcpp::createDelta(base, target, target.size());
+    ASSERT_FALSE(delta.empty());
+    EXPECT_LT(delta.size(), target.size() / 10);
+    EXPECT_EQ(gitcpp::applyDelta(base, delta.data(), delta.size()), target);
+}
+
+TEST_F(PackfileTest, RepackMovesLooseObjectsIntoPack) {
+    gitcpp::Repository repo = gitcpp::Repository::open();
+    gitcpp::ObjectStore before(repo);
+    auto commits = before.list(gitcpp::ObjectKind::Commit);
+    auto blobs = before.list(gitcpp::ObjectKind::Blob);
+    ASSERT_EQ(commits.size(), 5);
+
+    gitcpp::commands::repack(false);
+
+    for (const auto& entry : fs::recursive_directory_iterator(".gitcpp/commits")) {
+        EXPECT_FALSE(entry.is_regular_file()) << entry.path();
+    }
+    gitcpp::ObjectStore after(repo);
+    EXPECT_EQ(after.list(gitcpp::ObjectKind::Commit), commits);
+    EXPECT_EQ(after.list(gitcpp::ObjectKind::Blob), blobs);
+    for (const auto& id : blobs) {
+        EXPECT_EQ(gitcpp::sha1(after.read(gitcpp::ObjectKind::Blob, id)), id);
+        EXPECT_FALSE(after.contains(gitcpp::ObjectKind::Commit, id));
+    }
+}
+
+TEST_F(PackfileTest, RepackDoesNotGrowCompressedStore) {
+    // Compressible files with nothing to delta against each other
+    for (int f = 0; f < 20; ++f) {
+        std::ofstream file("file" + std::to_string(f) + ".txt");
+        for (int i = 0; i < 2000; ++i) file << "file " << f << " line " << (i * 7919 + f) % 10007 << "\n";
+    }
+    for (int f = 0; f < 20; ++f) gitcpp::commands::add("file" + std::to_string(f) + ".txt");
+    gitcpp::commands::commit("Add files");
+
+    gitcpp::Repository repo = gitcpp::Repository::open();
+    std::uintmax_t loose = 0;
+    for (const fs::path& dir : {repo.COMMITS, repo.BLOBS}) {
+        for (const auto& entry : fs::recursive_directory_iterator(dir)) {
+            if (entry.is_regular_file()) loose += entry.file_size();
+        }
+    }
+
+    // The pack holds the same objects in no more space; the .idx is extra
+    gitcpp::commands::repack(false);
+    std::uintmax_t packed = 0;
+    for (const auto& entry : fs::directory_iterator(repo.PACKS)) {
+        if (entry.path().extension() == ".pack") packed += entry.file_size();
+    }
+    EXPECT_LE(packed, loose);
+
+    gitcpp::ObjectStore store(repo);
+    EXPECT_EQ(store.readAsString(gitcpp::ObjectKind::Blob, gitcpp::sha1(gitcpp::readContents("file7.txt"))),
+              gitcpp::readContentsAsString("file7.txt"));
+}
+
+TEST_F(PackfileTest, CommandsReadThroughPacks) {
+    gitcpp::commands::branch("feature");
+    gitcpp::commands::repack(false);
+
+    std::ofstream file("big.txt");
+    file << "scratch";
+    file.close();
+    gitcpp::commands::restore({"restore", "big.txt"});
+
+    std::string content = gitcpp::readContentsAsString("big.txt");
+    EXPECT_NE(content.find("line 40 changed"), std::string::npos);
+
+    gitcpp::commands::switchBranch("feature", "");
+    EXPECT_TRUE(fs::exists("big.txt"));
+}
+
+TEST_F(PackfileTest, LooseObjectsAreCompressed) {
+    gitcpp::Repository repo = gitcpp::Repository::open();
+    gitcpp::ObjectStore store(repo);
+    std::string blob_hash = gitcpp::sha1(gitcpp::readContents("big.txt"));
+
+    fs::path loose = repo.BLOBS / blob_hash.substr(0, 2) / blob_hash.substr(2);
+    auto on_disk = gitcpp::readContents(loose);
+    EXPECT_EQ(std::string(on_disk.begin(), on_disk.begin() + 4), "GCZ1");
+    EXPECT_LT(on_disk.size(), fs::file_size("big.txt"));
+    EXPECT_EQ(store.read(gitcpp::ObjectKind::Blob, blob_hash), gitcpp::readContents("big.txt"));
+
+    // Raw objects from older repositories are still readable
+    std::string legacy_hash = gitcpp::sha1(std::string("legacy"));
+    fs::create_directories(repo.BLOBS / legacy_hash.substr(0, 2));
+    gitcpp::writeContents(repo.BLOBS / legacy_hash.substr(0, 2) / legacy_hash.substr(2), "legacy");
+    EXPECT_EQ(store.readAsString(gitcpp::ObjectKind::Blob, legacy_hash), "legacy");
+
+    // Level 0 stores objects uncompressed
+    gitcpp::commands::config("core.compression", "0");
+    gitcpp::ObjectStore raw_store(repo);
+    std::string plain_hash = gitcpp::sha1(std::string("plain"));
+    raw_store.write(gitcpp::ObjectKind::Blob, plain_hash, std::string("plain"));
+    EXPECT_EQ(gitcpp::readContentsAsString(repo.BLOBS / plain_hash.substr(0, 2) / plain_hash.substr(2)), "plain");
+
+    // ...unless they would look compressed
+    std::string lookalike("GCZ1\0\0\0\0\0\0\0\x05hello", 17);
+    std::string lookalike_hash = gitcpp::sha1(lookalike);
+    raw_store.write(gitcpp::ObjectKind::Blob, lookalike_hash, lookalike);
+    EXPECT_EQ(raw_store.readAsString(gitcpp::ObjectKind::Blob, lookalike_hash), lookalike);
+
+    // A damaged compressed object is rejected, not returned raw
+    on_disk[on_disk.size() / 2] ^= 0xff;
+    on_disk[on_disk.size() / 2 + 1] ^= 0xff;
+    on_disk[on_disk.size() / 2 + 2] ^= 0xff;
+    gitcpp::writeContents(loose, on_disk);
+    EXPECT_THROW(store.read(gitcpp::ObjectKind::Blob, blob_hash), GitcppException);
+}
+
+TEST_F(PackfileTest, FlatRepositoryIsMigratedToFanout) {
+    gitcpp::Repository repo = gitcpp::Repository::open();
+    std::vector<std::string> commits = gitcpp::ObjectStore(repo).list(gitcpp::ObjectKind::Commit);
+
+    // Flatten the store and drop the layout marker, as in an old repository
+    for (const fs::path& dir : {repo.BLOBS, repo.COMMITS}) {
+        std::vector<fs::path> nested;
+        for (const auto& entry : fs::recursive_directory_iterator(dir)) {
+            if (entry.is_regular_file() && entry.path().parent_path() != dir) nested.push_back(entry.path());
+        }
+        for (const auto& file : nested) {
+            fs::rename(file, dir / (file.parent_path().filename().string() + file.filename().string()));
+        }
+    }
+    fs::remove(repo.LAYOUT);
+
+    gitcpp::ObjectStore store(repo);
+    EXPECT_EQ(store.list(gitcpp::ObjectKind::Commit), commits);
+    EXPECT_TRUE(fs::exists(repo.COMMITS / commits[0].substr(0, 2) / commits[0].substr(2)));
+    EXPECT_FALSE(fs::exists(repo.COMMITS / commits[0]));
+    EXPECT_EQ(gitcpp::readContentsAsString(repo.LAYOUT), "fanout");
+}
+
+TEST_F(PackfileTest, ExistingObjectsAreNotRewritten) {
+    gitcpp::Repository repo = gitcpp::Repository::open();
+    gitcpp::commands::config("core.fsync", "batch");
+    gitcpp::ObjectStore store(repo);
+    EXPECT_EQ(gitcpp::fsyncMode(), gitcpp::FsyncMode::Batch);
+
+    std::string id = gitcpp::sha1(std::string("once"));
+    fs::path loose = repo.BLOBS / id.substr(0, 2) / id.substr(2);
+    store.write(gitcpp::ObjectKind::Blob, id, std::string("once"));
+    auto written = fs::last_write_time(loose);
+    fs::last_write_time(loose, written - std::chrono::hours(1));
+    store.write(gitcpp::ObjectKind::Blob, id, std::string("once"));
+    EXPECT_GE(fs::last_write_time(loose), written);     // touched for gc, not rewritten
+    EXPECT_EQ(store.readAsString(gitcpp::ObjectKind::Blob, id), "once");
+
+    // An empty file left by a crash is replaced
+    gitcpp::writeContents(loose, "");
+    store.write(gitcpp::ObjectKind::Blob, id, std::string("once"));
+    EXPECT_EQ(store.readAsString(gitcpp::ObjectKind::Blob, id), "once");
+
+    // Committing flushes the batch and leaves no temporary files behind
+    std::ofstream("new.txt") << "new";
+    gitcpp::commands::add("new.txt");
+    gitcpp::commands::commit("Add new.txt");
+    for (const auto& entry : fs::recursive_directory_iterator(repo.GITCPP_DIR)) {
+        EXPECT_EQ(entry.path().filename().string().find(".tmp"), std::string::npos) << entry.path();
+    }
+
+    gitcpp::commands::config("core.fsync", "off");
+    gitcpp::ObjectStore{repo};
+    EXPECT_EQ(gitcpp::fsyncMode(), gitcpp::FsyncMode::Off);
+}
+
+TEST_F(PackfileTest, CheckoutCopiesEveryObjectFormat) {
+    gitcpp::Repository repo = gitcpp::Repository::open();
+    gitcpp::commands::config("core.compression", "0");
+    gitcpp::ObjectStore store(repo);
+
+    std::string raw(3 << 20, 'r');
+    std::string rawId = gitcpp::sha1(raw);
+    store.write(gitcpp::ObjectKind::Blob, rawId, raw);
+    std::string compressedId = gitcpp::sha1(gitcpp::readContents("big.txt"));  // committed compressed
+
+    // Replaced files keep their permissions
+    std::ofstream("out.bin") << "old";
+    fs::permissions("out.bin", fs::perms::owner_exec, fs::perm_options::add);
+    store.checkout(rawId, "out.bin");
+    EXPECT_EQ(gitcpp::readContentsAsString("out.bin"), raw);
+    EXPECT_NE(fs::status("out.bin").permissions() & fs::perms::owner_exec, fs::perms::none);
+
+    store.checkout(compressedId, "out.txt");
+    EXPECT_EQ(gitcpp::readContentsAsString("out.txt"), gitcpp::readContentsAsString("big.txt"));
+    EXPECT_THROW(store.checkout(gitcpp::sha1(std::string("missing")), "out.txt"), GitcppException);
+}
+
+TEST_F(PackfileTest, GcPrunesUnreachableObjects) {
+    gitcpp::Repository repo = gitcpp::Repository::open();
+
+    // A branch that is deleted, and a staged blob that is replaced
+    gitcpp::commands::branch("doomed");
+    gitcpp::commands::switchBranch("doomed", "");
+    std::ofstream("doomed.txt") << "only on the doomed branch\n";
+    gitcpp::commands::add("doomed.txt");
+    gitcpp::commands::commit("Doomed");
+    std::string doomed = gitcpp::readContentsAsString(repo.HEADS / "doomed");
+    gitcpp::commands::switchBranch("main", "");
+    gitcpp::commands::rmBranch("doomed");
+
+    // Part of the history is packed, the rest stays loose
+    gitcpp::commands::repack(false);
+    std::ofstream("big.txt") << "abandoned\n";
+    gitcpp::commands::add("big.txt");
+    std::ofstream("big.txt") << "staged\n";
+    gitcpp::commands::add("big.txt");
+    std::string abandoned = gitcpp::sha1(std::string("abandoned\n"));
+    std::string staged = gitcpp::sha1(std::string("staged\n"));
+
+    // Within the grace period nothing is deleted
+    testing::internal::CaptureStdout();
+    gitcpp::commands::gc("");
+    std::string out = testing::internal::GetCapturedStdout();
+    EXPECT_NE(out.find("Pruned 0 unreachable objects, reclaimed 0 bytes."), std::string::npos) << out;
+    EXPECT_NE(out.find("Kept 4 unreachable objects"), std::string::npos) << out;
+    EXPECT_TRUE(gitcpp::ObjectStore(repo).contains(gitcpp::ObjectKind::Commit, doomed));
+
+    testing::internal::CaptureStdout();
+    gitcpp::commands::gc("now");
+    out = testing::internal::GetCapturedStdout();
+    EXPECT_NE(out.find("Reachable: 5 commits, 11 trees and blobs."), std::string::npos) << out;
+    EXPECT_NE(out.find("Pruned 4 unreachable objects"), std::string::npos) << out;
+    EXPECT_EQ(out.find("Kept"), std::string::npos) << out;
+
+    // The doomed commit, its tree and blob, and the abandoned blob are
+    // gone; history and the staged blob are intact
+    gitcpp::ObjectStore store(repo);
+    EXPECT_FALSE(store.contains(gitcpp::ObjectKind::Commit, doomed));
+    EXPECT_FALSE(store.contains(gitcpp::ObjectKind::Blob, gitcpp::sha1(std::string("only on the doomed branch\n"))));
+    EXPECT_FALSE(store.contains(gitcpp::ObjectKind::Blob, abandoned));
+    EXPECT_TRUE(store.contains(gitcpp::ObjectKind::Blob, staged));
+    EXPECT_EQ(store.list(gitcpp::ObjectKind::Commit).size(), 5u);
+    testing::internal::CaptureStdout();
+    gitcpp::commands::log();
+    out = testing::internal::GetCapturedStdout();
+    EXPECT_NE(out.find("Revision 0"), std::string::npos) << out;
+
+    testing::internal::CaptureStdout();
+    gitcpp::commands::gc("now");
+    out = testing::internal::GetCapturedStdout();
+    EXPECT_NE(out.find("Pruned 0 unreachable objects, reclaimed 0 bytes."), std::string::npos) << out;
+}
+
+TEST_F(PackfileTest, GcKeepsWhatRecentObjectsUse) {
+    gitcpp::Repository repo = gitcpp::Repository::open();
+    std::ofstream("a.txt") << "a\n";
+    gitcpp::commands::add("a.txt");
+    gitcpp::commands::commit("Add a");
+    std::string first = gitcpp::readContentsAsString(repo.HEADS / "main");
+    std::ofstream("b.txt") << "b\n";
+    gitcpp::commands::add("b.txt");
+    gitcpp::commands::commit("Add b");
+
+    // Everything so far is packed and past the grace period
+    gitcpp::commands::repack(false);
+    auto old = fs::file_time_type::clock::now() - std::chrono::hours(24 * 30);
+    for (const fs::path& dir : {repo.COMMITS, repo.BLOBS, repo.PACKS}) {
+        for (const auto& entry : fs::recursive_directory_iterator(dir)) {
+            if (entry.is_regular_file()) fs::last_write_time(entry.path(), old);
+        }
+    }
+
+    // Writing an old packed object again makes it recent through a new
+    // loose copy; the rest of its pack stays old
+    std::string aId = gitcpp::sha1(std::string("a\n"));
+    gitcpp::ObjectStore(repo).write(gitcpp::ObjectKind::Blob, aId, std::string("a\n"));
+    EXPECT_TRUE(fs::exists(repo.BLOBS / aId.substr(0, 2) / aId.substr(2)));
+    auto cutoff = fs::file_time_type::clock::now() - std::chrono::hours(1);
+    EXPECT_EQ(gitcpp::ObjectStore(repo).recent(gitcpp::ObjectKind::Blob, cutoff), std::vector<std::string>{aId});
+
+    // A recent commit left behind by a reset keeps the old tree and blob
+    // it still refers to
+    std::ofstream("a.txt") << "a, edited\n";
+    gitcpp::commands::add("a.txt");
+    gitcpp::commands::commit("Edit a");
+    std::string latest = gitcpp::readContentsAsString(repo.HEADS / "main");
+    gitcpp::commands::reset(first);
+    testing::internal::CaptureStdout();
+    gitcpp::commands::gc("");
+    std::string out = testing::internal::GetCapturedStdout();
+    EXPECT_NE(out.find("Pruned 0 unreachable objects"), std::string::npos) << out;
+    EXPECT_NE(out.find("Kept 6 unreachable objects"), std::string::npos) << out;
+
+    gitcpp::commands::reset(latest);
+    EXPECT_EQ(gitcpp::readContentsAsString("b.txt"), "b\n");
+    EXPECT_EQ(gitcpp::readContentsAsString("a.txt"), "a, edited\n");
+}
+
+TEST_F(PackfileTest, GcRemovesStaleTemporaries) {
+    gitcpp::Repository repo = gitcpp::Repository::open();
+
+    // What an add interrupted by a crash leaves behind, and one in progress
+    fs::path stale = repo.BLOBS / "tmp_12345_0";
+    fs::path active = repo.BLOBS / "tmp_12345_1";
+    gitcpp::writeContents(stale, std::string(4096, 's'));
+    gitcpp::writeContents(active, std::string(4096, 'a'));
+    fs::last_write_time(stale, fs::file_time_type::clock::now() - std::chrono::hours(24 * 30));
+
+    testing::internal::CaptureStdout();
+    gitcpp::commands::gc("");
+    std::string out = testing::internal::GetCapturedStdout();
+    EXPECT_NE(out.find("reclaimed 4096 bytes"), std::string::npos) << out;
+    EXPECT_FALSE(fs::exists(stale));
+    EXPECT_TRUE(fs::exists(active));
+}
+
+TEST_F(PackfileTest, ReadPrefixStopsEarly) {
+    gitcpp::Repository repo = gitcpp::Repository::open();
+    std::string big = gitcpp::readContentsAsString("big.txt");
+    std::string id = gitcpp::sha1(big);
+    auto prefix = [&](std::size_t size) {
+        auto bytes = gitcpp::ObjectStore(repo).readPrefix(gitcpp::ObjectKind::Blob, id, size);
+        return std::string(bytes.begin(), bytes.end());
+    };
+
+    EXPECT_EQ(prefix(10), big.substr(0, 10));
+    EXPECT_EQ(prefix(big.size() + 10), big);
+    gitcpp::commands::repack(false);
+    EXPECT_EQ(prefix(10), big.substr(0, 10));
+    EXPECT_EQ(prefix(big.size() + 10), big);
+
+    gitcpp::commands::config("core.compression", "0");
+    std::string raw_id = gitcpp::sha1(std::string("raw object"));
+    gitcpp::ObjectStore(repo).write(gitcpp::ObjectKind::Blob, raw_id, std::string("raw object"));
+    auto bytes = gitcpp::ObjectStore(repo).readPrefix(gitcpp::ObjectKind::Blob, raw_id, 3);
+    EXPECT_EQ(std::string(bytes.begin(), bytes.end()), "raw");
+}
+
+TEST_F(PackfileTest, GcKeepsWhatRecentFlatTreesUse) {
+    gitcpp::Repository repo = gitcpp::Repository::open();
+    gitcpp::ObjectStore store(repo);
+
+    // An old blob that only a recent tree in the old flat format refers to
+    std::string blob = gitcpp::sha1(std::string("flat\n"));
+    store.write(gitcpp::ObjectKind::Blob, blob, std::string("flat\n"));
+    fs::path loose = repo.BLOBS / blob.substr(0, 2) / blob.substr(2);
+    fs::last_write_time(loose, fs::file_time_type::clock::now() - std::chrono::hours(24 * 30));
+    std::string flat = "dir/flat.txt:" + blob + "\n";
+    store.write(gitcpp::ObjectKind::Blob, gitcpp::sha1(flat), flat);
+
+    testing::internal::CaptureStdout();
+    gitcpp::commands::gc("");
+    std::string out = testing::internal::GetCapturedStdout();
+    EXPECT_NE(out.find("Pruned 0 unreachable objects"), std::string::npos) << out;
+    EXPECT_TRUE(fs::exists(loose));
+}